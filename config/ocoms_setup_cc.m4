@@ -266,6 +266,38 @@ AC_DEFUN([OCOMS_SETUP_CC],[
     AC_DEFINE_UNQUOTED([OCOMS_C_HAVE_BUILTIN_PREFETCH], [$have_cc_builtin_prefetch],
           [Whether C compiler supports __builtin_prefetch])
 
+    # see if the C compiler supports __builtin_ctzll
+    AC_CACHE_CHECK([if $CC supports __builtin_ctzll],
+        [ocoms_cv_cc_supports___builtin_ctzll],
+        [AC_TRY_LINK([],
+          [unsigned long long word = 8;
+           return __builtin_ctzll(word) - 3;],
+          [ocoms_cv_cc_supports___builtin_ctzll="yes"],
+          [ocoms_cv_cc_supports___builtin_ctzll="no"])])
+    if test "$ocoms_cv_cc_supports___builtin_ctzll" = "yes" ; then
+        have_cc_builtin_ctz=1
+    else
+        have_cc_builtin_ctz=0
+    fi
+    AC_DEFINE_UNQUOTED([OCOMS_C_HAVE_BUILTIN_CTZ], [$have_cc_builtin_ctz],
+          [Whether C compiler supports __builtin_ctz and __builtin_ctzll])
+
+    # see if the C compiler supports __builtin_popcountll
+    AC_CACHE_CHECK([if $CC supports __builtin_popcountll],
+        [ocoms_cv_cc_supports___builtin_popcountll],
+        [AC_TRY_LINK([],
+          [unsigned long long word = 7;
+           return __builtin_popcountll(word) - 3;],
+          [ocoms_cv_cc_supports___builtin_popcountll="yes"],
+          [ocoms_cv_cc_supports___builtin_popcountll="no"])])
+    if test "$ocoms_cv_cc_supports___builtin_popcountll" = "yes" ; then
+        have_cc_builtin_popcount=1
+    else
+        have_cc_builtin_popcount=0
+    fi
+    AC_DEFINE_UNQUOTED([OCOMS_C_HAVE_BUILTIN_POPCOUNT], [$have_cc_builtin_popcount],
+          [Whether C compiler supports __builtin_popcount and __builtin_popcountll])
+
     # Preload the optflags for the case where the user didn't specify
     # any.  If we're using GNU compilers, use -O3 (since it GNU
     # doesn't require all compilation units to be compiled with the
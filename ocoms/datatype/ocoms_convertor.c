@@ -49,6 +49,8 @@
 extern int ocoms_convertor_create_stack_with_pos_general( ocoms_convertor_t* convertor,
                                                          int starting_point, const int* sizes );
 
+bool ocoms_convertor_checksum_crc32c = false;
+
 static void ocoms_convertor_construct( ocoms_convertor_t* convertor )
 {
     convertor->pStack         = convertor->static_stack;
@@ -56,6 +58,7 @@ static void ocoms_convertor_construct( ocoms_convertor_t* convertor )
     convertor->partial_length = 0;
     convertor->remoteArch     = ocoms_local_arch;
     convertor->flags          = OCOMS_DATATYPE_FLAG_NO_GAPS | CONVERTOR_COMPLETED;
+    if( ocoms_convertor_checksum_crc32c ) convertor->flags |= CONVERTOR_CHECKSUM_CRC32C;
 #if OCOMS_CUDA_SUPPORT
     convertor->cbmemcpy       = &ocoms_cuda_memcpy;
 #endif
@@ -194,6 +197,7 @@ ocoms_convertor_t* ocoms_convertor_create( int32_t remote_arch, int32_t mode )
     convertor->remoteArch = remote_arch;
     convertor->stack_pos  = 0;
     convertor->flags      = master->flags;
+    if( ocoms_convertor_checksum_crc32c ) convertor->flags |= CONVERTOR_CHECKSUM_CRC32C;
     convertor->master     = master;
 
     return convertor;
@@ -274,6 +278,10 @@ complete_contiguous_data_pack:
         return 1;
     }
 
+    if( OCOMS_UNLIKELY(ocoms_convertor_parallel_threads > 1) &&
+        ((pConv->local_size - pConv->bConverted) >= ocoms_convertor_parallel_min) ) {
+        return ocoms_convertor_advance_parallel( pConv, iov, out_size, max_data );
+    }
     return pConv->fAdvance( pConv, iov, out_size, max_data );
 }
 
@@ -326,6 +334,10 @@ complete_contiguous_data_unpack:
         return 1;
     }
 
+    if( OCOMS_UNLIKELY(ocoms_convertor_parallel_threads > 1) &&
+        ((pConv->local_size - pConv->bConverted) >= ocoms_convertor_parallel_min) ) {
+        return ocoms_convertor_advance_parallel( pConv, iov, out_size, max_data );
+    }
     return pConv->fAdvance( pConv, iov, out_size, max_data );
 }
 
@@ -392,6 +404,7 @@ int ocoms_convertor_create_stack_at_begining( ocoms_convertor_t* convertor,
     convertor->stack_pos      = 1;
     convertor->partial_length = 0;
     convertor->bConverted     = 0;
+    convertor->flags         &= ~CONVERTOR_STACK_STALE;
     /**
      * Fill the first position on the stack. This one correspond to the
      * last fake OCOMS_DATATYPE_END_LOOP that we add to the data representation and
@@ -412,23 +425,20 @@ int ocoms_convertor_create_stack_at_begining( ocoms_convertor_t* convertor,
 }
 
 
-int32_t ocoms_convertor_set_position_nocheck( ocoms_convertor_t* convertor,
-                                             size_t* position )
+/*
+ * Moves the stack of the convertor forward, from bConverted to position.
+ */
+static int32_t ocoms_convertor_advance_stack( ocoms_convertor_t* convertor,
+                                              size_t* position )
 {
     int32_t rc;
 
-    /**
-     * If we plan to rollback the convertor then first we have to set it
-     * at the beginning.
-     */
-    if( (0 == (*position)) || ((*position) < convertor->bConverted) ) {
-        rc = ocoms_convertor_create_stack_at_begining( convertor, ocoms_datatype_local_sizes );
-        if( 0 == (*position) ) return rc;
-    }
     if( OCOMS_LIKELY(convertor->flags & OCOMS_DATATYPE_FLAG_CONTIGUOUS) ) {
         rc = ocoms_convertor_create_stack_with_pos_contig( convertor, (*position),
                                                           ocoms_datatype_local_sizes );
     } else {
+        /* restart from the closest checkpoint of the datatype, if any */
+        ocoms_convertor_position_index_seek( convertor, *position );
         rc = ocoms_convertor_generic_simple_position( convertor, position );
         /**
          * If we have a non-contigous send convertor don't allow it move in the middle
@@ -446,6 +456,42 @@ int32_t ocoms_convertor_set_position_nocheck( ocoms_convertor_t* convertor,
     return rc;
 }
 
+int32_t ocoms_convertor_set_position_nocheck( ocoms_convertor_t* convertor,
+                                             size_t* position )
+{
+    int32_t rc;
+
+    /**
+     * If we plan to rollback the convertor then first we have to set it
+     * at the beginning.
+     */
+    if( (0 == (*position)) || ((*position) < convertor->bConverted) ) {
+        rc = ocoms_convertor_create_stack_at_begining( convertor, ocoms_datatype_local_sizes );
+        if( 0 == (*position) ) return rc;
+    }
+    if( (ocoms_pack_plan == convertor->fAdvance) || (ocoms_unpack_plan == convertor->fAdvance) ||
+        (ocoms_pack_vector == convertor->fAdvance) || (ocoms_unpack_vector == convertor->fAdvance) ) {
+        /**
+         * The plan functions restart from bConverted, at any byte. The stack
+         * is only positioned when someone else needs it, as ocoms_convertor_raw.
+         */
+        convertor->bConverted = *position;
+        convertor->flags |= CONVERTOR_STACK_STALE;
+        return OCOMS_SUCCESS;
+    }
+    return ocoms_convertor_advance_stack( convertor, position );
+}
+
+int32_t ocoms_convertor_position_stack( ocoms_convertor_t* convertor )
+{
+    size_t position = convertor->bConverted;
+    int32_t rc;
+
+    rc = ocoms_convertor_create_stack_at_begining( convertor, ocoms_datatype_local_sizes );
+    if( 0 == position ) return rc;
+    return ocoms_convertor_advance_stack( convertor, &position );
+}
+
 
 /**
  * Compute the remote size.
@@ -547,6 +593,21 @@ int32_t ocoms_convertor_set_position_nocheck( ocoms_convertor_t* convertor,
     }
 
 
+/*
+ * The compiled plan of a datatype only handles plain memory copies, the
+ * conversions and the CUDA buffers go through the generic functions.
+ * The debug builds keep the generic functions too, for the bounds checks
+ * of OCOMS_DATATYPE_SAFEGUARD_POINTER on every copy.
+ */
+#if OCOMS_ENABLE_DEBUG
+#define OCOMS_CONVERTOR_CAN_USE_PLAN( convertor ) 0
+#else
+#define OCOMS_CONVERTOR_CAN_USE_PLAN( convertor )                         \
+    ((NULL != (convertor)->pDesc->plan) &&                                \
+     ((convertor)->flags & CONVERTOR_HOMOGENEOUS) &&                      \
+     !((convertor)->flags & CONVERTOR_CUDA))
+#endif  /* OCOMS_ENABLE_DEBUG */
+
 int32_t ocoms_convertor_prepare_for_recv( ocoms_convertor_t* convertor,
                                          const struct ocoms_datatype_t* datatype,
                                          int32_t count,
@@ -580,6 +641,11 @@ int32_t ocoms_convertor_prepare_for_recv( ocoms_convertor_t* convertor,
 #endif
         if( convertor->pDesc->flags & OCOMS_DATATYPE_FLAG_CONTIGUOUS ) {
             convertor->fAdvance = ocoms_unpack_homogeneous_contig;
+        } else if( OCOMS_CONVERTOR_CAN_USE_PLAN(convertor) ) {
+            if( OCOMS_DATATYPE_PLAN_IS_VECTOR(convertor->pDesc->plan) )
+                convertor->fAdvance = ocoms_unpack_vector;
+            else
+                convertor->fAdvance = ocoms_unpack_plan;
         } else {
             convertor->fAdvance = ocoms_generic_simple_unpack;
         }
@@ -617,6 +683,11 @@ int32_t ocoms_convertor_prepare_for_send( ocoms_convertor_t* convertor,
                 convertor->fAdvance = ocoms_pack_homogeneous_contig;
             else
                 convertor->fAdvance = ocoms_pack_homogeneous_contig_with_gaps;
+        } else if( OCOMS_CONVERTOR_CAN_USE_PLAN(convertor) ) {
+            if( OCOMS_DATATYPE_PLAN_IS_VECTOR(convertor->pDesc->plan) )
+                convertor->fAdvance = ocoms_pack_vector;
+            else
+                convertor->fAdvance = ocoms_pack_plan;
         } else {
             convertor->fAdvance = ocoms_generic_simple_pack;
         }
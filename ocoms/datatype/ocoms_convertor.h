@@ -59,11 +59,13 @@ BEGIN_C_DECLS
 #define CONVERTOR_WITH_CHECKSUM    0x00200000
 #define CONVERTOR_CUDA             0x00400000
 #define CONVERTOR_CUDA_ASYNC       0x00800000
-#define CONVERTOR_TYPE_MASK        0x00FF0000
+#define CONVERTOR_CHECKSUM_CRC32C  0x10000000  /**< checksum with CRC32C instead of the word sum */
+#define CONVERTOR_TYPE_MASK        0x10FF0000
 #define CONVERTOR_STATE_START      0x01000000
 #define CONVERTOR_STATE_COMPLETE   0x02000000
 #define CONVERTOR_STATE_ALLOC      0x04000000
 #define CONVERTOR_COMPLETED        0x08000000
+#define CONVERTOR_STACK_STALE      0x20000000  /**< bConverted was moved by the plan functions, not the stack */
 
 union dt_elem_desc;
 typedef struct ocoms_convertor_t ocoms_convertor_t;
@@ -283,6 +285,52 @@ ocoms_convertor_raw( ocoms_convertor_t* convertor,  /* [IN/OUT] */
                     uint32_t* iov_count,          /* [IN/OUT] */
                     size_t* length );             /* [OUT]    */
 
+/*
+ * Iterator over the memory layout of a homogeneous convertor, as the
+ * longest runs of contiguous bytes, even across the loops of the
+ * datatype.  It fills iovec arrays ready for writev or process_vm_readv,
+ * to move large non contiguous data without packing it, and can be moved
+ * to any byte of the data.  The convertor belongs to the iterator until
+ * the end of the iteration.
+ */
+#define OCOMS_CONVERTOR_IOV_ITER_BATCH 32
+
+typedef struct ocoms_convertor_iov_iter_t {
+    ocoms_convertor_t* convertor;  /**< the convertor walked by ocoms_convertor_raw */
+    size_t             position;   /**< bytes returned so far */
+    size_t             skip;       /**< bytes to drop from the next raw run */
+    struct iovec       run;        /**< run kept until it cannot grow anymore */
+    uint32_t           head;       /**< first unused raw run of the batch */
+    uint32_t           tail;       /**< number of raw runs in the batch */
+    bool               done;       /**< the convertor has no more raw runs */
+    struct iovec       batch[OCOMS_CONVERTOR_IOV_ITER_BATCH];
+} ocoms_convertor_iov_iter_t;
+
+/*
+ * Starts an iteration at the current position of the convertor.
+ */
+OCOMS_DECLSPEC int32_t
+ocoms_convertor_iov_iter_init( ocoms_convertor_iov_iter_t* iter,  /* [OUT]    */
+                               ocoms_convertor_t* convertor );    /* [IN/OUT] */
+
+/*
+ * Restarts the iteration at any byte position of the data.
+ */
+OCOMS_DECLSPEC int32_t
+ocoms_convertor_iov_iter_seek( ocoms_convertor_iov_iter_t* iter,  /* [IN/OUT] */
+                               size_t position );                 /* [IN]     */
+
+/*
+ * Fills at most *iov_count entries describing at most *length bytes, and
+ * updates both with what was returned.  Returns 1 once all the data has
+ * been returned, 0 otherwise, or an error code.
+ */
+OCOMS_DECLSPEC int32_t
+ocoms_convertor_iov_iter_next( ocoms_convertor_iov_iter_t* iter,  /* [IN/OUT] */
+                               struct iovec* iov,                 /* [OUT]    */
+                               uint32_t* iov_count,               /* [IN/OUT] */
+                               size_t* length );                  /* [IN/OUT] */
+
 /*
  * Upper level does not need to call the _nocheck function directly.
  */
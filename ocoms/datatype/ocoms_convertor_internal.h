@@ -52,6 +52,43 @@ ocoms_convertor_master_t* ocoms_convertor_find_or_create_master( uint32_t remote
  */
 void ocoms_convertor_destroy_masters( void );
 
+/*
+ * Parallel pack and unpack: the requests of at least
+ * ocoms_convertor_parallel_min bytes are split between
+ * ocoms_convertor_parallel_threads threads, 1 disabling the mode.
+ */
+extern int ocoms_convertor_parallel_threads;
+extern size_t ocoms_convertor_parallel_min;
+
+int32_t ocoms_convertor_advance_parallel( ocoms_convertor_t* pConv,
+                                          struct iovec* iov, uint32_t* out_size,
+                                          size_t* max_data );
+
+/*
+ * Stop the worker threads of the parallel mode, if they were started.
+ */
+void ocoms_convertor_parallel_finalize( void );
+
+/*
+ * Whether the new convertors get CONVERTOR_CHECKSUM_CRC32C, set by the
+ * ddt_checksum_crc32c MCA parameter.
+ */
+extern bool ocoms_convertor_checksum_crc32c;
+
+/*
+ * Move a convertor using the generic functions to the last checkpoint of
+ * the position index of its datatype before position, when that one is
+ * after the current position of the convertor.
+ */
+void ocoms_convertor_position_index_seek( ocoms_convertor_t* convertor, size_t position );
+
+/*
+ * Position the stack of a convertor on its bConverted, after the plan
+ * and vector functions moved it without updating the stack
+ * (CONVERTOR_STACK_STALE).
+ */
+int32_t ocoms_convertor_position_stack( ocoms_convertor_t* convertor );
+
 END_C_DECLS
 
 #endif  /* OCOMS_CONVERTOR_INTERNAL_HAS_BEEN_INCLUDED */
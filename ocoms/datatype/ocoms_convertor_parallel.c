@@ -0,0 +1,315 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Parallel pack and unpack.  A large request is cut into segments of
+ * the packed stream, each one converted by a clone of the convertor
+ * moved to the start of the segment with ocoms_convertor_set_position,
+ * into the matching part of the caller's iovecs.  The segments are run
+ * by a small pool of worker threads, started at the first use, and by
+ * the calling thread itself.  Only one request uses the pool at a time,
+ * the others are converted by their calling thread as usual.
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/datatype/ocoms_datatype.h"
+#include "ocoms/datatype/ocoms_convertor.h"
+#include "ocoms/datatype/ocoms_convertor_internal.h"
+#include "ocoms/datatype/ocoms_datatype_internal.h"
+#include "ocoms/datatype/ocoms_datatype_prototypes.h"
+
+#if OCOMS_HAVE_POSIX_THREADS && OCOMS_ENABLE_MULTI_THREADS
+#include <pthread.h>
+#include "ocoms/threads/threads.h"
+#define OCOMS_CONVERTOR_HAVE_PARALLEL 1
+#else
+#define OCOMS_CONVERTOR_HAVE_PARALLEL 0
+#endif
+
+int ocoms_convertor_parallel_threads = 1;
+size_t ocoms_convertor_parallel_min = 4 * 1024 * 1024;
+
+#if OCOMS_CONVERTOR_HAVE_PARALLEL
+
+/* the segments boundaries of the stateless functions stay on cache lines */
+#define PARALLEL_ALIGNMENT 64
+
+typedef struct ocoms_convertor_segment_t {
+    ocoms_convertor_t convertor;   /**< the clone converting the segment */
+    size_t            start;       /**< the position of the segment */
+    size_t            length;      /**< the packed bytes of the segment */
+    struct iovec*     iov;         /**< the parts of the caller's iovecs */
+    uint32_t          iov_count;
+    size_t            converted;   /**< the bytes actually converted */
+} ocoms_convertor_segment_t;
+
+/* the pool, and the request being run, protected by pool_lock */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static ocoms_thread_t* pool_threads = NULL;
+static int pool_size = 0;
+static bool pool_stop = false;
+static ocoms_convertor_segment_t* pool_segments = NULL;
+static uint32_t pool_next = 0, pool_count = 0, pool_pending = 0;
+
+/* held by the request owning the pool */
+static pthread_mutex_t pool_owner = PTHREAD_MUTEX_INITIALIZER;
+
+static void parallel_run_segment( ocoms_convertor_segment_t* segment )
+{
+    size_t position = segment->start, max_data = segment->length;
+    uint32_t iov_count = segment->iov_count;
+
+    segment->converted = 0;
+    if( OCOMS_SUCCESS != ocoms_convertor_set_position( &segment->convertor, &position ) ||
+        (position != segment->start) ) {
+        return;
+    }
+    (void)segment->convertor.fAdvance( &segment->convertor, segment->iov, &iov_count, &max_data );
+    segment->converted = max_data;
+}
+
+/* runs the segments of the current request until none is left */
+static void parallel_drain( void )
+{
+    ocoms_convertor_segment_t* segment;
+
+    pthread_mutex_lock( &pool_lock );
+    while( pool_next < pool_count ) {
+        segment = &pool_segments[pool_next++];
+        pthread_mutex_unlock( &pool_lock );
+        parallel_run_segment( segment );
+        pthread_mutex_lock( &pool_lock );
+        if( 0 == --pool_pending ) {
+            pthread_cond_signal( &pool_done );
+        }
+    }
+    pthread_mutex_unlock( &pool_lock );
+}
+
+static void* parallel_worker( ocoms_object_t* arg )
+{
+    (void)arg;
+    pthread_mutex_lock( &pool_lock );
+    for( ;; ) {
+        while( !pool_stop && (pool_next >= pool_count) ) {
+            pthread_cond_wait( &pool_work, &pool_lock );
+        }
+        if( pool_stop ) break;
+        pthread_mutex_unlock( &pool_lock );
+        parallel_drain();
+        pthread_mutex_lock( &pool_lock );
+    }
+    pthread_mutex_unlock( &pool_lock );
+    return NULL;
+}
+
+/* starts the workers, the calling thread being the last one */
+static int parallel_start_pool( void )
+{
+    int i;
+
+    pool_threads = (ocoms_thread_t*)calloc( ocoms_convertor_parallel_threads - 1,
+                                            sizeof(ocoms_thread_t) );
+    if( NULL == pool_threads ) return OCOMS_ERR_OUT_OF_RESOURCE;
+    pool_stop = false;
+    for( i = 0; i < ocoms_convertor_parallel_threads - 1; i++ ) {
+        OBJ_CONSTRUCT( &pool_threads[i], ocoms_thread_t );
+        pool_threads[i].t_run = parallel_worker;
+        if( OCOMS_SUCCESS != ocoms_thread_start( &pool_threads[i] ) ) {
+            OBJ_DESTRUCT( &pool_threads[i] );
+            break;
+        }
+    }
+    pool_size = i;
+    return OCOMS_SUCCESS;
+}
+
+void ocoms_convertor_parallel_finalize( void )
+{
+    int i;
+
+    if( NULL == pool_threads ) return;
+    pthread_mutex_lock( &pool_lock );
+    pool_stop = true;
+    pthread_cond_broadcast( &pool_work );
+    pthread_mutex_unlock( &pool_lock );
+    for( i = 0; i < pool_size; i++ ) {
+        ocoms_thread_join( &pool_threads[i], NULL );
+        OBJ_DESTRUCT( &pool_threads[i] );
+    }
+    free( pool_threads );
+    pool_threads = NULL;
+    pool_size = 0;
+}
+
+/* whether fAdvance restarts from bConverted alone, at any byte */
+static inline bool parallel_is_stateless( const ocoms_convertor_t* pConv )
+{
+    return (ocoms_pack_plan == pConv->fAdvance) || (ocoms_unpack_plan == pConv->fAdvance) ||
+           (ocoms_pack_vector == pConv->fAdvance) || (ocoms_unpack_vector == pConv->fAdvance);
+}
+
+/*
+ * Cuts [start, start + total) into segments, and the caller's iovecs
+ * into the parts backing each segment.  Returns the number of segments.
+ */
+static uint32_t parallel_split( ocoms_convertor_t* pConv, struct iovec* iov,
+                                size_t start, size_t total, size_t granule,
+                                ocoms_convertor_segment_t* segments, struct iovec* parts )
+{
+    uint32_t nsegments = (uint32_t)(pool_size + 1), count = 0, i = 0;
+    size_t slice = (total + nsegments - 1) / nsegments, end = start + total;
+    size_t boundary, next, iov_offset = 0, length;
+
+    for( boundary = start; boundary < end; boundary = next ) {
+        next = ((boundary + slice) / granule) * granule;
+        if( (next <= boundary) || (next > end) || (count == nsegments - 1) ) next = end;
+
+        segments[count].start     = boundary;
+        segments[count].length    = next - boundary;
+        segments[count].iov       = parts;
+        segments[count].iov_count = 0;
+        /* the parts of the iovecs between boundary and next */
+        for( length = next - boundary; 0 != length; ) {
+            size_t room = iov[i].iov_len - iov_offset;
+
+            if( room > length ) room = length;
+            parts->iov_base = (IOVBASE_TYPE*)((unsigned char*)iov[i].iov_base + iov_offset);
+            parts->iov_len  = room;
+            parts++;
+            segments[count].iov_count++;
+            length -= room;
+            iov_offset += room;
+            if( iov_offset == iov[i].iov_len ) {
+                iov_offset = 0;
+                i++;
+            }
+        }
+        OBJ_CONSTRUCT( &segments[count].convertor, ocoms_convertor_t );
+        ocoms_convertor_clone( pConv, &segments[count].convertor, 0 );
+        count++;
+    }
+    return count;
+}
+
+int32_t ocoms_convertor_advance_parallel( ocoms_convertor_t* pConv,
+                                          struct iovec* iov, uint32_t* out_size,
+                                          size_t* max_data )
+{
+    ocoms_convertor_segment_t* segments;
+    struct iovec* parts;
+    size_t start = pConv->bConverted, total = 0, granule, done, position;
+    uint32_t i, nsegments;
+
+    if( (pConv->flags & (CONVERTOR_WITH_CHECKSUM | CONVERTOR_CUDA)) ||
+        !(pConv->flags & CONVERTOR_HOMOGENEOUS) ) {
+        goto serial;
+    }
+    for( i = 0; i < *out_size; i++ ) {
+        if( NULL == iov[i].iov_base ) goto serial;
+        total += iov[i].iov_len;
+    }
+    if( total > pConv->local_size - start ) total = pConv->local_size - start;
+    if( total < ocoms_convertor_parallel_min ) goto serial;
+
+    /* the other functions keep a stack, they are cut on the elements of
+     * the convertor, where set_position lands exactly.  As they may also
+     * leave the end of an iovec unused, they only get a single one. */
+    if( parallel_is_stateless( pConv ) ) {
+        granule = PARALLEL_ALIGNMENT;
+    } else {
+        granule = pConv->pDesc->size;
+        if( (0 != (start % granule)) || (1 != *out_size) ) goto serial;
+    }
+
+    if( 0 != pthread_mutex_trylock( &pool_owner ) ) goto serial;
+    if( (NULL == pool_threads) && (OCOMS_SUCCESS != parallel_start_pool()) ) {
+        pthread_mutex_unlock( &pool_owner );
+        goto serial;
+    }
+    segments = (ocoms_convertor_segment_t*)malloc( (pool_size + 1) * sizeof(ocoms_convertor_segment_t) );
+    parts = (struct iovec*)malloc( (pool_size + 1) * (*out_size) * sizeof(struct iovec) );
+    if( (NULL == segments) || (NULL == parts) ) {
+        free( segments );
+        free( parts );
+        pthread_mutex_unlock( &pool_owner );
+        goto serial;
+    }
+    nsegments = parallel_split( pConv, iov, start, total, granule, segments, parts );
+
+    pthread_mutex_lock( &pool_lock );
+    pool_segments = segments;
+    pool_next     = 0;
+    pool_count    = nsegments;
+    pool_pending  = nsegments;
+    pthread_cond_broadcast( &pool_work );
+    pthread_mutex_unlock( &pool_lock );
+
+    parallel_drain();
+
+    pthread_mutex_lock( &pool_lock );
+    while( 0 != pool_pending ) {
+        pthread_cond_wait( &pool_done, &pool_lock );
+    }
+    pool_segments = NULL;
+    pool_next = pool_count = 0;
+    pthread_mutex_unlock( &pool_lock );
+    pthread_mutex_unlock( &pool_owner );
+
+    /* the data is valid up to the first segment left incomplete */
+    done = 0;
+    for( i = 0; i < nsegments; i++ ) {
+        done += segments[i].converted;
+        OBJ_DESTRUCT( &segments[i].convertor );
+        if( segments[i].converted != segments[i].length ) break;
+    }
+    for( i++; i < nsegments; i++ ) {
+        OBJ_DESTRUCT( &segments[i].convertor );
+    }
+    free( segments );
+    free( parts );
+
+    position = start + done;
+    ocoms_convertor_set_position( pConv, &position );
+    done = position - start;
+
+    *max_data = done;
+    for( i = 0; (i < *out_size) && (0 != done); i++ ) {
+        if( iov[i].iov_len > done ) iov[i].iov_len = done;
+        done -= iov[i].iov_len;
+    }
+    *out_size = i;
+    return (pConv->flags & CONVERTOR_COMPLETED) ? 1 : 0;
+
+ serial:
+    return pConv->fAdvance( pConv, iov, out_size, max_data );
+}
+
+#else
+
+void ocoms_convertor_parallel_finalize( void )
+{
+}
+
+int32_t ocoms_convertor_advance_parallel( ocoms_convertor_t* pConv,
+                                          struct iovec* iov, uint32_t* out_size,
+                                          size_t* max_data )
+{
+    return pConv->fAdvance( pConv, iov, out_size, max_data );
+}
+
+#endif  /* OCOMS_CONVERTOR_HAVE_PARALLEL */
@@ -23,7 +23,7 @@
 #if OCOMS_ENABLE_DEBUG
 #include "ocoms/util/output.h"
 
-extern int ocoms_pack_debug;
+extern bool ocoms_pack_debug;
 #define DO_DEBUG(INST)  if( ocoms_pack_debug ) { INST }
 #else
 #define DO_DEBUG(INST)
@@ -70,6 +70,10 @@ ocoms_convertor_raw( ocoms_convertor_t* pConvertor,
         return 1;  /* we're done */
     }
 
+    if( pConvertor->flags & CONVERTOR_STACK_STALE ) {
+        ocoms_convertor_position_stack( pConvertor );
+    }
+
     DO_DEBUG( ocoms_output( 0, "ocoms_convertor_raw( %p, {%p, %u}, %lu )\n", (void*)pConvertor,
                            (void*)iov, *iov_count, (unsigned long)*length ); );
 
@@ -118,7 +122,7 @@ ocoms_convertor_raw( ocoms_convertor_t* pConvertor,
                                            index, source_base, (unsigned long)blength ); );
                     iov[index].iov_base = (IOVBASE_TYPE *) source_base;
                     iov[index].iov_len  = blength;
-                    source_base += blength;
+                    source_base += pElem->elem.extent;
                     raw_data += blength;
                     count_desc--;
                 }
@@ -212,3 +216,123 @@ complete_loop:
                            pConvertor->stack_pos, pStack->index, (int)pStack->count, (long)pStack->disp ); );
     return 0;
 }
+
+int32_t
+ocoms_convertor_iov_iter_init( ocoms_convertor_iov_iter_t* iter,
+                               ocoms_convertor_t* convertor )
+{
+    /* the raw layout is the local one */
+    if( !(convertor->flags & CONVERTOR_HOMOGENEOUS) ) return OCOMS_ERR_NOT_SUPPORTED;
+    iter->convertor = convertor;
+    return ocoms_convertor_iov_iter_seek( iter, convertor->bConverted );
+}
+
+int32_t
+ocoms_convertor_iov_iter_seek( ocoms_convertor_iov_iter_t* iter,
+                               size_t position )
+{
+    ocoms_convertor_t* convertor = iter->convertor;
+    size_t start = 0;
+    int32_t rc;
+
+    if( position > convertor->local_size ) return OCOMS_ERR_BAD_PARAM;
+    iter->position     = position;
+    iter->skip         = 0;
+    iter->run.iov_base = NULL;
+    iter->run.iov_len  = 0;
+    iter->head         = 0;
+    iter->tail         = 0;
+    iter->done         = (position == convertor->local_size);
+    if( iter->done ) {
+        convertor->bConverted = convertor->local_size;
+        convertor->flags |= CONVERTOR_COMPLETED;
+        return OCOMS_SUCCESS;
+    }
+    convertor->flags &= ~CONVERTOR_COMPLETED;
+    if( convertor->flags & CONVERTOR_NO_OP ) {
+        /* ocoms_convertor_raw only looks at bConverted */
+        convertor->bConverted = position;
+        return OCOMS_SUCCESS;
+    }
+    /* Rewind the stack and move it with the generic functions, as the
+     * advance functions of the plans do not keep it up to date.
+     */
+    rc = ocoms_convertor_set_position_nocheck( convertor, &start );
+    if( OCOMS_SUCCESS != rc ) return rc;
+    ocoms_convertor_position_index_seek( convertor, position );
+    start = position;
+    rc = ocoms_convertor_generic_simple_position( convertor, &start );
+    if( rc < 0 ) return rc;
+    /* the raw runs start on a predefined element */
+    iter->skip = convertor->partial_length;
+    convertor->bConverted -= convertor->partial_length;
+    convertor->partial_length = 0;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * The raw runs are read by batches, and merged with the run kept by the
+ * iterator as long as they follow it in memory.  A run is only returned
+ * once it cannot grow anymore, or when it reaches the length limit.
+ */
+int32_t
+ocoms_convertor_iov_iter_next( ocoms_convertor_iov_iter_t* iter,
+                               struct iovec* iov, uint32_t* iov_count,
+                               size_t* length )
+{
+    size_t max_length = *length, total = 0, len;
+    uint32_t index = 0, count;
+    struct iovec* raw;
+    int32_t rc;
+
+    while( (index < *iov_count) && (total < max_length) ) {
+        if( iter->head == iter->tail ) {
+            if( !iter->done ) {
+                count = OCOMS_CONVERTOR_IOV_ITER_BATCH;
+                rc = ocoms_convertor_raw( iter->convertor, iter->batch, &count, &len );
+                if( rc < 0 ) return rc;
+                iter->done = (1 == rc);
+                iter->head = 0;
+                iter->tail = count;
+                continue;
+            }
+            if( 0 == iter->run.iov_len ) break;  /* all returned */
+        } else {
+            raw = &(iter->batch[iter->head]);
+            if( OCOMS_UNLIKELY(0 != iter->skip) ) {
+                len = (iter->skip < raw->iov_len) ? iter->skip : raw->iov_len;
+                raw->iov_base = (IOVBASE_TYPE*)((char*)raw->iov_base + len);
+                raw->iov_len -= len;
+                iter->skip   -= len;
+            }
+            if( 0 == raw->iov_len ) {
+                iter->head++;
+                continue;
+            }
+            if( 0 == iter->run.iov_len ) {
+                iter->run = *raw;
+                iter->head++;
+                continue;
+            }
+            if( ((char*)iter->run.iov_base + iter->run.iov_len) == (char*)raw->iov_base ) {
+                iter->run.iov_len += raw->iov_len;
+                iter->head++;
+                continue;
+            }
+        }
+        /* the run cannot grow anymore */
+        len = iter->run.iov_len;
+        if( len > (max_length - total) ) len = max_length - total;
+        iov[index].iov_base = iter->run.iov_base;
+        iov[index].iov_len  = len;
+        index++;
+        total += len;
+        iter->run.iov_base = (IOVBASE_TYPE*)((char*)iter->run.iov_base + len);
+        iter->run.iov_len -= len;
+    }
+    *iov_count = index;
+    *length = total;
+    iter->position += total;
+    if( iter->done && (iter->head == iter->tail) && (0 == iter->run.iov_len) ) return 1;
+    return 0;
+}
@@ -28,6 +28,20 @@
 #include "ocoms/datatype/ocoms_datatype_internal.h"
 #include "ocoms/datatype/ocoms_datatype_checksum.h"
 #include "ocoms/datatype/ocoms_convertor_internal.h"
+#include "ocoms/sys/architecture.h"
+
+#if OCOMS_ASSEMBLY_ARCH == OCOMS_AMD64 && defined(__GNUC__)
+#define OCOMS_DT_SWAP_SSSE3 1
+#include <tmmintrin.h>
+#else
+#define OCOMS_DT_SWAP_SSSE3 0
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define OCOMS_DT_SWAP_NEON 1
+#include <arm_neon.h>
+#else
+#define OCOMS_DT_SWAP_NEON 0
+#endif
 
 
 /*
@@ -54,6 +68,182 @@ ocoms_dt_swap_bytes(void *to_p, const void *from_p, const size_t size)
 }
 
 
+/*
+ * Byte swap of one element, with the processor byte swap instructions
+ * for the usual sizes.
+ */
+static inline void
+ocoms_dt_swap_element(char *to, const char *from, const size_t size)
+{
+#if defined(__GNUC__)
+    switch( size ) {
+    case 2: {
+        uint16_t v;
+        memcpy( &v, from, 2 );
+        v = __builtin_bswap16( v );
+        memcpy( to, &v, 2 );
+        return;
+    }
+    case 4: {
+        uint32_t v;
+        memcpy( &v, from, 4 );
+        v = __builtin_bswap32( v );
+        memcpy( to, &v, 4 );
+        return;
+    }
+    case 8: {
+        uint64_t v;
+        memcpy( &v, from, 8 );
+        v = __builtin_bswap64( v );
+        memcpy( to, &v, 8 );
+        return;
+    }
+    case 16: {
+        uint64_t lo, hi;
+        memcpy( &lo, from, 8 );
+        memcpy( &hi, from + 8, 8 );
+        lo = __builtin_bswap64( lo );
+        hi = __builtin_bswap64( hi );
+        memcpy( to, &hi, 8 );
+        memcpy( to + 8, &lo, 8 );
+        return;
+    }
+    }
+#endif  /* defined(__GNUC__) */
+    ocoms_dt_swap_bytes( to, from, size );
+}
+
+/*
+ * The contiguous arrays of 2, 4, 8 or 16 bytes elements are swapped 16
+ * bytes at a time by a byte shuffle: pshufb with SSSE3, vrev and vext
+ * with NEON.  The strided elements of 16 bytes get one shuffle each, the
+ * smaller ones a byte swap instruction each.
+ */
+#if OCOMS_DT_SWAP_SSSE3
+static int ocoms_dt_swap_ssse3_supported = -1;
+
+__attribute__((target("ssse3")))
+static uint32_t
+ocoms_dt_swap_ssse3(char *to, OCOMS_PTRDIFF_TYPE to_extent,
+                    const char *from, OCOMS_PTRDIFF_TYPE from_extent,
+                    const size_t size, uint32_t count)
+{
+    char shuffle[16];
+    __m128i mask, v0, v1, v2, v3;
+    size_t i, length;
+
+    for( i = 0; i < 16; i++ ) shuffle[i] = (char)((i / size) * size + (size - 1 - (i % size)));
+    mask = _mm_loadu_si128( (const __m128i*)shuffle );
+
+    if( ((OCOMS_PTRDIFF_TYPE)size != to_extent) || ((OCOMS_PTRDIFF_TYPE)size != from_extent) ) {
+        if( 16 != size ) return 0;
+        for( i = 0; i < count; i++ ) {
+            v0 = _mm_loadu_si128( (const __m128i*)from );
+            _mm_storeu_si128( (__m128i*)to, _mm_shuffle_epi8( v0, mask ) );
+            to += to_extent;
+            from += from_extent;
+        }
+        return count;
+    }
+    length = size * count;
+    for( i = 0; (i + 64) <= length; i += 64 ) {
+        v0 = _mm_loadu_si128( (const __m128i*)(from + i) );
+        v1 = _mm_loadu_si128( (const __m128i*)(from + i + 16) );
+        v2 = _mm_loadu_si128( (const __m128i*)(from + i + 32) );
+        v3 = _mm_loadu_si128( (const __m128i*)(from + i + 48) );
+        _mm_storeu_si128( (__m128i*)(to + i),      _mm_shuffle_epi8( v0, mask ) );
+        _mm_storeu_si128( (__m128i*)(to + i + 16), _mm_shuffle_epi8( v1, mask ) );
+        _mm_storeu_si128( (__m128i*)(to + i + 32), _mm_shuffle_epi8( v2, mask ) );
+        _mm_storeu_si128( (__m128i*)(to + i + 48), _mm_shuffle_epi8( v3, mask ) );
+    }
+    for( ; (i + 16) <= length; i += 16 ) {
+        v0 = _mm_loadu_si128( (const __m128i*)(from + i) );
+        _mm_storeu_si128( (__m128i*)(to + i), _mm_shuffle_epi8( v0, mask ) );
+    }
+    /* less than 16 bytes left */
+    return (uint32_t)(i / size);
+}
+#endif  /* OCOMS_DT_SWAP_SSSE3 */
+
+#if OCOMS_DT_SWAP_NEON
+static inline uint8x16_t
+ocoms_dt_swap_neon_vector(uint8x16_t v, const size_t size)
+{
+    switch( size ) {
+    case 2: return vrev16q_u8( v );
+    case 4: return vrev32q_u8( v );
+    case 8: return vrev64q_u8( v );
+    }
+    v = vrev64q_u8( v );
+    return vextq_u8( v, v, 8 );
+}
+
+static uint32_t
+ocoms_dt_swap_neon(char *to, OCOMS_PTRDIFF_TYPE to_extent,
+                   const char *from, OCOMS_PTRDIFF_TYPE from_extent,
+                   const size_t size, uint32_t count)
+{
+    uint8x16_t v0, v1, v2, v3;
+    size_t i, length;
+
+    if( ((OCOMS_PTRDIFF_TYPE)size != to_extent) || ((OCOMS_PTRDIFF_TYPE)size != from_extent) ) {
+        if( 16 != size ) return 0;
+        for( i = 0; i < count; i++ ) {
+            v0 = vld1q_u8( (const uint8_t*)from );
+            vst1q_u8( (uint8_t*)to, ocoms_dt_swap_neon_vector( v0, size ) );
+            to += to_extent;
+            from += from_extent;
+        }
+        return count;
+    }
+    length = size * count;
+    for( i = 0; (i + 64) <= length; i += 64 ) {
+        v0 = vld1q_u8( (const uint8_t*)(from + i) );
+        v1 = vld1q_u8( (const uint8_t*)(from + i + 16) );
+        v2 = vld1q_u8( (const uint8_t*)(from + i + 32) );
+        v3 = vld1q_u8( (const uint8_t*)(from + i + 48) );
+        vst1q_u8( (uint8_t*)(to + i),      ocoms_dt_swap_neon_vector( v0, size ) );
+        vst1q_u8( (uint8_t*)(to + i + 16), ocoms_dt_swap_neon_vector( v1, size ) );
+        vst1q_u8( (uint8_t*)(to + i + 32), ocoms_dt_swap_neon_vector( v2, size ) );
+        vst1q_u8( (uint8_t*)(to + i + 48), ocoms_dt_swap_neon_vector( v3, size ) );
+    }
+    for( ; (i + 16) <= length; i += 16 ) {
+        v0 = vld1q_u8( (const uint8_t*)(from + i) );
+        vst1q_u8( (uint8_t*)(to + i), ocoms_dt_swap_neon_vector( v0, size ) );
+    }
+    /* less than 16 bytes left */
+    return (uint32_t)(i / size);
+}
+#endif  /* OCOMS_DT_SWAP_NEON */
+
+static void
+ocoms_dt_swap_elements(char *to, OCOMS_PTRDIFF_TYPE to_extent,
+                       const char *from, OCOMS_PTRDIFF_TYPE from_extent,
+                       const size_t size, uint32_t count)
+{
+    uint32_t i = 0;
+
+    if( (2 == size) || (4 == size) || (8 == size) || (16 == size) ) {
+#if OCOMS_DT_SWAP_SSSE3
+        if( OCOMS_UNLIKELY(ocoms_dt_swap_ssse3_supported < 0) ) {
+            ocoms_dt_swap_ssse3_supported = __builtin_cpu_supports("ssse3") ? 1 : 0;
+        }
+        if( ocoms_dt_swap_ssse3_supported ) {
+            i = ocoms_dt_swap_ssse3( to, to_extent, from, from_extent, size, count );
+        }
+#elif OCOMS_DT_SWAP_NEON
+        i = ocoms_dt_swap_neon( to, to_extent, from, from_extent, size, count );
+#endif
+        to += i * to_extent;
+        from += i * from_extent;
+    }
+    for( ; i < count; i++ ) {
+        ocoms_dt_swap_element( to, from, size );
+        to += to_extent;
+        from += from_extent;
+    }
+}
+
 #define COPY_TYPE_HETEROGENEOUS( TYPENAME, TYPE )                                         \
 static int32_t                                                                            \
 copy_##TYPENAME##_heterogeneous(ocoms_convertor_t *pConvertor, uint32_t count,             \
@@ -69,11 +259,8 @@ copy_##TYPENAME##_heterogeneous(ocoms_convertor_t *pConvertor, uint32_t count,
                                                                         \
     if ((pConvertor->remoteArch & OCOMS_ARCH_ISBIGENDIAN) !=             \
         (ocoms_local_arch & OCOMS_ARCH_ISBIGENDIAN)) {                    \
-        for( i = 0; i < count; i++ ) {                                  \
-            ocoms_dt_swap_bytes(to, from, sizeof(TYPE));                 \
-            to += to_extent;                                            \
-            from += from_extent;                                        \
-        }                                                               \
+        ocoms_dt_swap_elements(to, to_extent, from, from_extent,        \
+                               sizeof(TYPE), count);                    \
     } else if ((OCOMS_PTRDIFF_TYPE)sizeof(TYPE) == to_extent &&          \
                (OCOMS_PTRDIFF_TYPE)sizeof(TYPE) == from_extent) {        \
          MEMCPY( to, from, count * sizeof(TYPE) );                      \
@@ -274,7 +461,7 @@ COPY_TYPE_HETEROGENEOUS( float12, long double )
 
 #if SIZEOF_FLOAT == 16
 COPY_TYPE_HETEROGENEOUS( float16, float )
-#elif SIZEOF_DOUBLE == 8
+#elif SIZEOF_DOUBLE == 16
 COPY_TYPE_HETEROGENEOUS( float16, double )
 #elif HAVE_LONG_DOUBLE && SIZEOF_LONG_DOUBLE == 16
 COPY_TYPE_HETEROGENEOUS( float16, long double )
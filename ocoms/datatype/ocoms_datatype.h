@@ -100,6 +100,9 @@ struct dt_type_desc_t {
 };
 typedef struct dt_type_desc_t dt_type_desc_t;
 
+struct ocoms_datatype_plan_t;
+struct ocoms_datatype_position_index_t;
+struct ocoms_datatype_shared_t;
 
 /*
  * The datatype description.
@@ -125,6 +128,12 @@ struct ocoms_datatype_t {
     dt_type_desc_t     desc;     /**< the data description */
     dt_type_desc_t     opt_desc; /**< short description of the data used when conversion is useless
                                       or in the send case (without conversion) */
+    struct ocoms_datatype_plan_t* plan; /**< the compiled pack/unpack plan, NULL if the datatype has none */
+    struct ocoms_datatype_position_index_t* position_index;
+                                 /**< the checkpoints of the convertor stack, NULL if the datatype has none */
+    struct ocoms_datatype_shared_t* shared;
+                                 /**< the owner of opt_desc, plan and position_index when they are shared
+                                      with other datatypes, NULL if they are private */
 
     uint32_t           btypes[OCOMS_DATATYPE_MAX_SUPPORTED];
                                  /**< basic elements count used to compute the size of the
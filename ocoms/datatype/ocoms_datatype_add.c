@@ -260,10 +260,15 @@ int32_t ocoms_datatype_add( ocoms_datatype_t* pdtBase, const ocoms_datatype_t* p
 
     pdtBase->bdt_used |= pdtAdd->bdt_used;
     newLength = pdtBase->desc.used + place_needed;
-    if( newLength > pdtBase->desc.length ) {
+    /* keep the last entry for the fake OCOMS_DATATYPE_END_LOOP added by the commit */
+    if( newLength >= pdtBase->desc.length ) {
         newLength = ((newLength / DT_INCREASE_STACK) + 1 ) * DT_INCREASE_STACK;
         pdtBase->desc.desc   = (dt_elem_desc_t*)realloc( pdtBase->desc.desc,
                                                          sizeof(dt_elem_desc_t) * newLength );
+        /* as calloc in ocoms_datatype_create, so that identical descriptions
+         * are identical in memory, padding included */
+        memset( pdtBase->desc.desc + pdtBase->desc.length, 0,
+                sizeof(dt_elem_desc_t) * (newLength - pdtBase->desc.length) );
         pdtBase->desc.length = newLength;
     }
     pLast = &(pdtBase->desc.desc[pdtBase->desc.used]);
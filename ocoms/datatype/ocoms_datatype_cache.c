@@ -0,0 +1,286 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_hash_table.h"
+#include "ocoms/threads/mutex.h"
+#include "ocoms/datatype/ocoms_datatype.h"
+#include "ocoms/datatype/ocoms_datatype_internal.h"
+
+/* initial number of buckets of the cache */
+#define CACHE_INITIAL_SIZE 256
+
+bool ocoms_datatype_commit_cache = true;
+
+/*
+ * The cache maps the structural hash of the description of a committed
+ * datatype to the chain of the shared objects with this hash, which are
+ * told apart by comparing their copy of the description, fake end loop
+ * included.  The settings the optimized description and the position
+ * index depend on are part of the key, so that a change of the MCA
+ * parameters does not reuse data built with the previous values.  It
+ * holds no reference: an entry leaves the cache with the last datatype
+ * using it.
+ */
+static ocoms_hash_table_t ocoms_datatype_cache;
+static ocoms_mutex_t ocoms_datatype_cache_lock;
+static bool ocoms_datatype_cache_initialized = false;
+
+static void ocoms_datatype_shared_construct( ocoms_datatype_shared_t* shared )
+{
+    shared->opt_desc.desc   = NULL;
+    shared->opt_desc.length = 0;
+    shared->opt_desc.used   = 0;
+    shared->plan            = NULL;
+    shared->position_index  = NULL;
+    shared->flags           = 0;
+    shared->loops           = 0;
+    shared->optimize_passes = false;
+    shared->index_interval  = 0;
+    shared->hash            = 0;
+    shared->next            = NULL;
+    shared->key             = NULL;
+    shared->keylen          = 0;
+}
+
+static void ocoms_datatype_shared_destruct( ocoms_datatype_shared_t* shared )
+{
+    if( NULL != shared->opt_desc.desc ) free( shared->opt_desc.desc );
+    if( NULL != shared->plan ) {
+        if( NULL != shared->plan->entries ) free( shared->plan->entries );
+        free( shared->plan );
+    }
+    if( NULL != shared->position_index ) {
+        if( NULL != shared->position_index->checkpoints ) free( shared->position_index->checkpoints );
+        if( NULL != shared->position_index->stacks ) free( shared->position_index->stacks );
+        free( shared->position_index );
+    }
+    if( NULL != shared->key ) free( shared->key );
+}
+
+OBJ_CLASS_INSTANCE(ocoms_datatype_shared_t, ocoms_object_t,
+                   ocoms_datatype_shared_construct, ocoms_datatype_shared_destruct);
+
+/*
+ * Hashes a description a word at a time, in four independent lanes, as
+ * the descriptions of the large datatypes are tens of kilobytes long.
+ */
+#define CACHE_HASH_MIX( H, W )                                  \
+    do {                                                        \
+        (H) = ((H) ^ (W)) * 0x9e3779b97f4a7c15ULL;               \
+        (H) ^= (H) >> 29;                                       \
+    } while(0)
+
+static uint64_t ocoms_datatype_cache_hash( const dt_elem_desc_t* desc, size_t length )
+{
+    const uint64_t* words = (const uint64_t*)desc;
+    uint64_t h0 = length, h1 = 1, h2 = 2, h3 = 3;
+    size_t i, nwords = length / sizeof(uint64_t);
+
+    for( i = 0; (i + 4) <= nwords; i += 4 ) {
+        CACHE_HASH_MIX( h0, words[i] );
+        CACHE_HASH_MIX( h1, words[i+1] );
+        CACHE_HASH_MIX( h2, words[i+2] );
+        CACHE_HASH_MIX( h3, words[i+3] );
+    }
+    for( ; i < nwords; i++ ) CACHE_HASH_MIX( h0, words[i] );
+    CACHE_HASH_MIX( h0, h1 );
+    CACHE_HASH_MIX( h0, h2 );
+    CACHE_HASH_MIX( h0, h3 );
+    /* the settings of the commit */
+    CACHE_HASH_MIX( h0, ((uint64_t)ocoms_datatype_position_index_interval << 1) |
+                        (ocoms_datatype_optimize_passes ? 1 : 0) );
+    return h0;
+}
+
+/* Returns the shared object of the description in the chain, if any. */
+static ocoms_datatype_shared_t*
+ocoms_datatype_cache_find( uint64_t hash, const dt_elem_desc_t* desc, size_t length )
+{
+    ocoms_datatype_shared_t* shared;
+
+    if( OCOMS_SUCCESS != ocoms_hash_table_get_value_uint64( &ocoms_datatype_cache, hash,
+                                                            (void**)&shared ) )
+        return NULL;
+    for( ; NULL != shared; shared = shared->next ) {
+        if( (shared->keylen == length) &&
+            (shared->optimize_passes == ocoms_datatype_optimize_passes) &&
+            (shared->index_interval == ocoms_datatype_position_index_interval) &&
+            (0 == memcmp( shared->key, desc, length )) )
+            return shared;
+    }
+    return NULL;
+}
+
+int32_t ocoms_datatype_cache_init( void )
+{
+    int rc;
+
+    if( ocoms_datatype_cache_initialized ) return OCOMS_SUCCESS;
+    OBJ_CONSTRUCT( &ocoms_datatype_cache_lock, ocoms_mutex_t );
+    OBJ_CONSTRUCT( &ocoms_datatype_cache, ocoms_hash_table_t );
+    rc = ocoms_hash_table_init( &ocoms_datatype_cache, CACHE_INITIAL_SIZE );
+    if( OCOMS_SUCCESS != rc ) {
+        OBJ_DESTRUCT( &ocoms_datatype_cache );
+        OBJ_DESTRUCT( &ocoms_datatype_cache_lock );
+        return rc;
+    }
+    ocoms_datatype_cache_initialized = true;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * The datatypes still alive keep their shared data, only the cache
+ * itself goes away.
+ */
+void ocoms_datatype_cache_finalize( void )
+{
+    if( !ocoms_datatype_cache_initialized ) return;
+    ocoms_datatype_cache_initialized = false;
+    OBJ_DESTRUCT( &ocoms_datatype_cache );
+    OBJ_DESTRUCT( &ocoms_datatype_cache_lock );
+}
+
+/*
+ * Looks for a committed datatype with the same description.  On success
+ * the datatype shares its optimized description, plan and position
+ * index, and the commit is done.
+ */
+int32_t ocoms_datatype_cache_lookup( ocoms_datatype_t* pData )
+{
+    ocoms_datatype_shared_t* shared;
+    size_t length = (pData->desc.used + 1) * sizeof(dt_elem_desc_t);
+    uint64_t hash;
+
+    if( !ocoms_datatype_cache_initialized || (0 == pData->desc.used) ) return OCOMS_ERR_NOT_FOUND;
+    hash = ocoms_datatype_cache_hash( pData->desc.desc, length );
+
+    OCOMS_THREAD_LOCK( &ocoms_datatype_cache_lock );
+    shared = ocoms_datatype_cache_find( hash, pData->desc.desc, length );
+    /* the contiguous datatypes have neither plan nor position index */
+    if( (NULL != shared) && ((shared->flags ^ pData->flags) & OCOMS_DATATYPE_FLAG_CONTIGUOUS) ) {
+        shared = NULL;
+    }
+    if( NULL != shared ) OBJ_RETAIN( shared );
+    OCOMS_THREAD_UNLOCK( &ocoms_datatype_cache_lock );
+    if( NULL == shared ) return OCOMS_ERR_NOT_FOUND;
+
+    pData->shared         = shared;
+    pData->opt_desc       = shared->opt_desc;
+    pData->plan           = shared->plan;
+    pData->position_index = shared->position_index;
+    /* the optimizer passes may have added loops to opt_desc */
+    if( pData->btypes[OCOMS_DATATYPE_LOOP] < shared->loops )
+        pData->btypes[OCOMS_DATATYPE_LOOP] = shared->loops;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * Moves the optimized description, plan and position index of a newly
+ * committed datatype to a shared object, and makes it available to the
+ * next commits of the same description.
+ */
+int32_t ocoms_datatype_cache_insert( ocoms_datatype_t* pData )
+{
+    ocoms_datatype_shared_t *shared, *head;
+    int rc;
+
+    if( !ocoms_datatype_cache_initialized || (0 == pData->desc.used) ||
+        (NULL == pData->opt_desc.desc) || (pData->opt_desc.desc == pData->desc.desc) )
+        return OCOMS_SUCCESS;
+
+    shared = OBJ_NEW(ocoms_datatype_shared_t);
+    if( NULL == shared ) return OCOMS_ERR_OUT_OF_RESOURCE;
+    shared->keylen = (pData->desc.used + 1) * sizeof(dt_elem_desc_t);
+    shared->key    = malloc( shared->keylen );
+    if( NULL == shared->key ) {
+        OBJ_RELEASE( shared );
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    memcpy( shared->key, pData->desc.desc, shared->keylen );
+    shared->flags = pData->flags;
+    shared->loops = pData->btypes[OCOMS_DATATYPE_LOOP];
+    shared->optimize_passes = ocoms_datatype_optimize_passes;
+    shared->index_interval  = ocoms_datatype_position_index_interval;
+    shared->hash  = ocoms_datatype_cache_hash( pData->desc.desc, shared->keylen );
+
+    OCOMS_THREAD_LOCK( &ocoms_datatype_cache_lock );
+    if( NULL != ocoms_datatype_cache_find( shared->hash, shared->key, shared->keylen ) ) {
+        /* committed meanwhile by another thread, keep the private copy */
+        OCOMS_THREAD_UNLOCK( &ocoms_datatype_cache_lock );
+        OBJ_RELEASE( shared );
+        return OCOMS_SUCCESS;
+    }
+    if( OCOMS_SUCCESS == ocoms_hash_table_get_value_uint64( &ocoms_datatype_cache, shared->hash,
+                                                            (void**)&head ) ) {
+        shared->next = head;
+    }
+    /* a lookup may find the entry as soon as it is in the table */
+    shared->opt_desc       = pData->opt_desc;
+    shared->plan           = pData->plan;
+    shared->position_index = pData->position_index;
+    rc = ocoms_hash_table_set_value_uint64( &ocoms_datatype_cache, shared->hash, shared );
+    if( OCOMS_SUCCESS != rc ) {
+        /* the datatype keeps its private copy */
+        shared->opt_desc.desc  = NULL;
+        shared->plan           = NULL;
+        shared->position_index = NULL;
+        OCOMS_THREAD_UNLOCK( &ocoms_datatype_cache_lock );
+        OBJ_RELEASE( shared );
+        return rc;
+    }
+    pData->shared = shared;
+    OCOMS_THREAD_UNLOCK( &ocoms_datatype_cache_lock );
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * Drops the reference of a datatype on its shared data.  The entry is
+ * removed from the cache under the lock, so a concurrent lookup cannot
+ * find an object being destroyed.
+ */
+void ocoms_datatype_cache_release( ocoms_datatype_t* pData )
+{
+    ocoms_datatype_shared_t *shared = pData->shared, *head, **prev;
+
+    if( NULL == shared ) return;
+    pData->shared          = NULL;
+    pData->opt_desc.desc   = NULL;
+    pData->opt_desc.length = 0;
+    pData->opt_desc.used   = 0;
+    pData->plan            = NULL;
+    pData->position_index  = NULL;
+
+    if( !ocoms_datatype_cache_initialized ) {
+        OBJ_RELEASE( shared );
+        return;
+    }
+    OCOMS_THREAD_LOCK( &ocoms_datatype_cache_lock );
+    if( (1 == shared->super.obj_reference_count) &&
+        (OCOMS_SUCCESS == ocoms_hash_table_get_value_uint64( &ocoms_datatype_cache, shared->hash,
+                                                             (void**)&head )) ) {
+        /* unlink it from the chain of its hash */
+        for( prev = &head; (NULL != *prev) && (shared != *prev); prev = &((*prev)->next) ) ;
+        if( NULL != *prev ) *prev = shared->next;
+        if( NULL == head ) {
+            (void)ocoms_hash_table_remove_value_uint64( &ocoms_datatype_cache, shared->hash );
+        } else {
+            (void)ocoms_hash_table_set_value_uint64( &ocoms_datatype_cache, shared->hash, head );
+        }
+    }
+    OBJ_RELEASE( shared );
+    OCOMS_THREAD_UNLOCK( &ocoms_datatype_cache_lock );
+}
@@ -22,28 +22,32 @@
 #define DATATYPE_CHECKSUM_H_HAS_BEEN_INCLUDED
 
 
+#include "ocoms/datatype/ocoms_convertor.h"
 #include "ocoms/datatype/ocoms_datatype_memcpy.h"
 #include "ocoms/util/crc.h"
 
 #if defined(CHECKSUM)
 
-#if defined (OCOMS_CSUM_DST)
-#define MEMCPY_CSUM( DST, SRC, BLENGTH, CONVERTOR ) \
-do { \
-    (CONVERTOR)->checksum += OCOMS_CSUM_BCOPY_PARTIAL( (SRC), (DST), (BLENGTH), (BLENGTH), &(CONVERTOR)->csum_ui1, &(CONVERTOR)->csum_ui2 ); \
-} while (0)
-
-#else  /* if OCOMS_CSUM_DST */
-
+/*
+ * The convertors with CONVERTOR_CHECKSUM_CRC32C chain a CRC32C over the
+ * packed data instead of summing it by 32-bit words.
+ */
 #define MEMCPY_CSUM( DST, SRC, BLENGTH, CONVERTOR ) \
 do { \
-    (CONVERTOR)->checksum += OCOMS_CSUM_BCOPY_PARTIAL( (SRC), (DST), (BLENGTH), (BLENGTH), &(CONVERTOR)->csum_ui1, &(CONVERTOR)->csum_ui2 ); \
+    if( (CONVERTOR)->flags & CONVERTOR_CHECKSUM_CRC32C ) { \
+        (CONVERTOR)->checksum = OCOMS_CRC32C_BCOPY_PARTIAL( (SRC), (DST), (BLENGTH), (CONVERTOR)->checksum ); \
+    } else { \
+        (CONVERTOR)->checksum += OCOMS_CSUM_BCOPY_PARTIAL( (SRC), (DST), (BLENGTH), (BLENGTH), &(CONVERTOR)->csum_ui1, &(CONVERTOR)->csum_ui2 ); \
+    } \
 } while (0)
-#endif  /* if OCOMS_CSUM_DST */
 
 #define COMPUTE_CSUM( SRC, BLENGTH, CONVERTOR ) \
 do { \
-    (CONVERTOR)->checksum += OCOMS_CSUM_PARTIAL( (SRC), (BLENGTH), &(CONVERTOR)->csum_ui1, &(CONVERTOR)->csum_ui2 ); \
+    if( (CONVERTOR)->flags & CONVERTOR_CHECKSUM_CRC32C ) { \
+        (CONVERTOR)->checksum = OCOMS_CRC32C_PARTIAL( (SRC), (BLENGTH), (CONVERTOR)->checksum ); \
+    } else { \
+        (CONVERTOR)->checksum += OCOMS_CSUM_PARTIAL( (SRC), (BLENGTH), &(CONVERTOR)->csum_ui1, &(CONVERTOR)->csum_ui2 ); \
+    } \
 } while (0)
 
 #else  /* if CHECKSUM */
@@ -53,6 +53,8 @@ int32_t ocoms_datatype_clone( const ocoms_datatype_t * src_type, ocoms_datatype_
         if( 0 != src_type->opt_desc.used ) {
             if( src_type->opt_desc.desc == src_type->desc.desc) {
                 dest_type->opt_desc = dest_type->desc;
+            } else if( NULL != src_type->shared ) {
+                /* shared with the source datatype */
             } else {
                 desc_length = dest_type->opt_desc.used + 1;
                 dest_type->opt_desc.desc = (dt_elem_desc_t*)malloc( desc_length * sizeof(dt_elem_desc_t) );
@@ -65,6 +67,20 @@ int32_t ocoms_datatype_clone( const ocoms_datatype_t * src_type, ocoms_datatype_
             }
         }
     }
+    /* the plan and the position index are private to each datatype,
+     * unless they are shared */
+    if( NULL != src_type->shared ) {
+        OBJ_RETAIN( src_type->shared );
+    } else {
+        dest_type->plan = NULL;
+        if( NULL != src_type->plan ) {
+            (void)ocoms_datatype_plan_build( dest_type );
+        }
+        dest_type->position_index = NULL;
+        if( NULL != src_type->position_index ) {
+            (void)ocoms_datatype_position_index_build( dest_type );
+        }
+    }
     dest_type->id  = src_type->id;  /* preserve the default id. This allow us to
                                      * copy predefined types. */
     return OCOMS_SUCCESS;
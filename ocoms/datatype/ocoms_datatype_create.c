@@ -45,6 +45,9 @@ static void ocoms_datatype_construct( ocoms_datatype_t* pData )
     pData->opt_desc.desc      = NULL;
     pData->opt_desc.length    = 0;
     pData->opt_desc.used      = 0;
+    pData->plan               = NULL;
+    pData->position_index     = NULL;
+    pData->shared             = NULL;
     pData->align              = 1;
     pData->flags              = OCOMS_DATATYPE_FLAG_CONTIGUOUS;
     pData->true_lb            = LONG_MAX;
@@ -57,6 +60,8 @@ static void ocoms_datatype_construct( ocoms_datatype_t* pData )
 static void ocoms_datatype_destruct( ocoms_datatype_t* datatype )
 {
     if (!ocoms_datatype_is_predefined(datatype)) {
+        /* the shared data belong to the cache entry */
+        ocoms_datatype_cache_release( datatype );
         if( datatype->desc.desc != NULL ) {
             free( datatype->desc.desc );
             datatype->desc.length = 0;
@@ -69,6 +74,8 @@ static void ocoms_datatype_destruct( ocoms_datatype_t* datatype )
             datatype->opt_desc.used   = 0;
             datatype->opt_desc.desc   = NULL;
         }
+        ocoms_datatype_plan_release( datatype );
+        ocoms_datatype_position_index_release( datatype );
     }
     /**
      * As the default description and the optimized description can point to the
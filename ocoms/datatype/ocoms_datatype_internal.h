@@ -37,6 +37,8 @@
 #include <stdint.h>
 #endif
 
+#include "ocoms/datatype/ocoms_datatype.h"
+
 #if defined(VERBOSE)
 #include "ocoms/util/output.h"
 
@@ -474,6 +476,109 @@ static inline int GET_FIRST_NON_LOOP( const union dt_elem_desc* _pElem )
         (COUNTER) = (ELEMENT)->elem.count;                              \
     } while (0)
 
+/*
+ * A compiled plan lists the data of one element of a committed datatype
+ * as runs of equally spaced blocks, in packing order.  The homogeneous
+ * pack and unpack functions walk it with plain loops instead of
+ * interpreting the description with a stack, and can restart from any
+ * byte position with a binary search on the packed offsets.
+ */
+struct ocoms_datatype_plan_entry_t {
+    OCOMS_PTRDIFF_TYPE disp;     /**< displacement of the first block */
+    OCOMS_PTRDIFF_TYPE stride;   /**< distance between the starts of two blocks */
+    size_t             blength;  /**< length of a block in bytes */
+    uint32_t           count;    /**< number of blocks */
+    size_t             packed;   /**< packed bytes of the element before the first block */
+};
+typedef struct ocoms_datatype_plan_entry_t ocoms_datatype_plan_entry_t;
+
+struct ocoms_datatype_plan_t {
+    uint32_t                     used;     /**< number of entries */
+    uint32_t                     length;   /**< number of allocated entries */
+    ocoms_datatype_plan_entry_t* entries;  /**< the runs, in packing order */
+};
+typedef struct ocoms_datatype_plan_t ocoms_datatype_plan_t;
+
+/* a single run describes a vector: count blocks of blength bytes at a
+ * fixed stride, repeated at the extent of the datatype */
+#define OCOMS_DATATYPE_PLAN_IS_VECTOR( PLAN )  (1 == (PLAN)->used)
+
+/* datatypes needing more entries keep using the generic functions */
+#define OCOMS_DATATYPE_PLAN_MAX_ENTRIES 1024
+
+int32_t ocoms_datatype_plan_build( struct ocoms_datatype_t* pData );
+void ocoms_datatype_plan_release( struct ocoms_datatype_t* pData );
+
+/*
+ * The position index of a large datatype holds snapshots of the stack of
+ * a convertor walking one element of the datatype, taken every interval
+ * packed bytes.  Moving a convertor to any position restarts from the
+ * closest snapshot before it, and only replays the description from
+ * there, instead of from the current position or from the beginning.
+ */
+struct ocoms_datatype_checkpoint_t {
+    size_t             offset;     /**< packed bytes of the element before the snapshot */
+    uint32_t           stack_pos;  /**< the position on the stack of the snapshot */
+};
+typedef struct ocoms_datatype_checkpoint_t ocoms_datatype_checkpoint_t;
+
+struct ocoms_datatype_position_index_t {
+    const union dt_elem_desc*    desc;         /**< the description walked by the snapshots */
+    uint32_t                     used;         /**< number of checkpoints */
+    uint32_t                     depth;        /**< number of stack entries per checkpoint */
+    ocoms_datatype_checkpoint_t* checkpoints;  /**< the checkpoints, by increasing offset */
+    struct dt_stack_t*           stacks;       /**< the snapshots, depth entries each */
+};
+typedef struct ocoms_datatype_position_index_t ocoms_datatype_position_index_t;
+
+/* packed bytes between two checkpoints, 0 disabling the index.  Set by
+ * the ddt_position_index_interval MCA parameter. */
+extern size_t ocoms_datatype_position_index_interval;
+
+/* the largest number of checkpoints of a datatype, the interval grows
+ * for the datatypes which would need more */
+#define OCOMS_DATATYPE_POSITION_INDEX_MAX 4096
+
+int32_t ocoms_datatype_position_index_build( struct ocoms_datatype_t* pData );
+void ocoms_datatype_position_index_release( struct ocoms_datatype_t* pData );
+
+/* whether commit rewrites the optimized description with the optimizer
+ * passes.  Set by the ddt_optimize_passes MCA parameter. */
+extern bool ocoms_datatype_optimize_passes;
+
+/*
+ * Committed datatypes with the same description share their optimized
+ * description, plan and position index, found at commit in a cache keyed
+ * by a hash of the description.  The shared object is refcounted, and
+ * owns these data for all the datatypes using it.
+ */
+struct ocoms_datatype_shared_t {
+    ocoms_object_t                          super;
+    dt_type_desc_t                          opt_desc;
+    struct ocoms_datatype_plan_t*           plan;
+    struct ocoms_datatype_position_index_t* position_index;
+    uint16_t                                flags;   /**< flags of the first datatype */
+    uint32_t                                loops;   /**< stack depth needed by opt_desc */
+    bool                                    optimize_passes; /**< ocoms_datatype_optimize_passes at commit */
+    size_t                                  index_interval;  /**< ocoms_datatype_position_index_interval at commit */
+    uint64_t                                hash;    /**< structural hash of the description */
+    struct ocoms_datatype_shared_t*         next;    /**< next shared object with the same hash */
+    void*                                   key;     /**< copy of the description, fake end loop included */
+    size_t                                  keylen;
+};
+typedef struct ocoms_datatype_shared_t ocoms_datatype_shared_t;
+OBJ_CLASS_DECLARATION(ocoms_datatype_shared_t);
+
+/* whether commit looks for an identical datatype first.  Set by the
+ * ddt_commit_cache MCA parameter. */
+extern bool ocoms_datatype_commit_cache;
+
+int32_t ocoms_datatype_cache_init( void );
+void ocoms_datatype_cache_finalize( void );
+int32_t ocoms_datatype_cache_lookup( struct ocoms_datatype_t* pData );
+int32_t ocoms_datatype_cache_insert( struct ocoms_datatype_t* pData );
+void ocoms_datatype_cache_release( struct ocoms_datatype_t* pData );
+
 OCOMS_DECLSPEC int ocoms_datatype_contain_basic_datatypes( const struct ocoms_datatype_t* pData, char* ptr, size_t length );
 OCOMS_DECLSPEC int ocoms_datatype_dump_data_flags( unsigned short usflags, char* ptr, size_t length );
 OCOMS_DECLSPEC int ocoms_datatype_dump_data_desc( union dt_elem_desc* pDesc, int nbElems, char* ptr, size_t length );
@@ -0,0 +1,57 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "ocoms/datatype/ocoms_datatype_memcpy.h"
+
+size_t ocoms_datatype_memcpy_nt_min = (size_t)-1;
+
+/*
+ * Copy with non-temporal stores, for blocks much larger than the last
+ * level cache which would otherwise evict the working set of the
+ * application.  The destination is aligned on 16 bytes with a short
+ * memcpy, then moved by 64 bytes per iteration.
+ */
+void ocoms_datatype_memcpy_nt( void* dst, const void* src, size_t length )
+{
+#if OCOMS_DATATYPE_HAVE_MEMCPY_NT
+    unsigned char* d = (unsigned char*)dst;
+    const unsigned char* s = (const unsigned char*)src;
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    __m128i x0, x1, x2, x3;
+
+    if( length < head + 64 ) {
+        memcpy( dst, src, length );
+        return;
+    }
+    memcpy( d, s, head );
+    d += head; s += head; length -= head;
+
+    for( ; length >= 64; length -= 64, d += 64, s += 64 ) {
+        x0 = _mm_loadu_si128( (const __m128i*)(s +  0) );
+        x1 = _mm_loadu_si128( (const __m128i*)(s + 16) );
+        x2 = _mm_loadu_si128( (const __m128i*)(s + 32) );
+        x3 = _mm_loadu_si128( (const __m128i*)(s + 48) );
+        _mm_stream_si128( (__m128i*)(d +  0), x0 );
+        _mm_stream_si128( (__m128i*)(d + 16), x1 );
+        _mm_stream_si128( (__m128i*)(d + 32), x2 );
+        _mm_stream_si128( (__m128i*)(d + 48), x3 );
+    }
+    /* order the streaming stores before any later store */
+    _mm_sfence();
+    memcpy( d, s, length );
+#else
+    memcpy( dst, src, length );
+#endif  /* OCOMS_DATATYPE_HAVE_MEMCPY_NT */
+}
@@ -16,7 +16,164 @@
 #ifndef OCOMS_DATATYPE_MEMCPY_H_HAS_BEEN_INCLUDED
 #define OCOMS_DATATYPE_MEMCPY_H_HAS_BEEN_INCLUDED
 
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stddef.h>
+#include <string.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#include "ocoms/sys/architecture.h"
+#include "ocoms/primitives/prefetch.h"
+
+/*
+ * Copies of at least ocoms_datatype_memcpy_nt_min bytes bypass the
+ * caches with non-temporal stores, when the architecture supports
+ * them.  The limit is set by ocoms_datatype_init from the
+ * ddt_memcpy_nt_threshold MCA parameter; it is SIZE_MAX when the
+ * streaming copy is disabled or not available.
+ */
+#if OCOMS_ASSEMBLY_ARCH == OCOMS_AMD64 && defined(__SSE2__)
+#define OCOMS_DATATYPE_HAVE_MEMCPY_NT 1
+#define OCOMS_DATATYPE_HAVE_SSE2_GATHER 1
+#include <emmintrin.h>
+#else
+#define OCOMS_DATATYPE_HAVE_MEMCPY_NT 0
+#define OCOMS_DATATYPE_HAVE_SSE2_GATHER 0
+#endif
+
+BEGIN_C_DECLS
+
+OCOMS_DECLSPEC extern size_t ocoms_datatype_memcpy_nt_min;
+
+OCOMS_DECLSPEC void ocoms_datatype_memcpy_nt( void* dst, const void* src, size_t length );
+
+static inline void ocoms_datatype_memcpy( void* dst, const void* src, size_t length )
+{
+#if OCOMS_DATATYPE_HAVE_MEMCPY_NT
+    if( OCOMS_UNLIKELY(length >= ocoms_datatype_memcpy_nt_min) ) {
+        ocoms_datatype_memcpy_nt( dst, src, length );
+        return;
+    }
+#endif
+    memcpy( dst, src, length );
+}
+
 #define MEMCPY( DST, SRC, BLENGTH ) \
-    memcpy( (DST), (SRC), (BLENGTH) )
+    ocoms_datatype_memcpy( (DST), (SRC), (BLENGTH) )
+
+/*
+ * Copy COUNT blocks of BLENGTH bytes, the blocks being DST_STRIDE bytes
+ * apart in the destination and SRC_STRIDE bytes apart in the source.
+ * The common sizes of the predefined types get a loop with a
+ * compile-time length, which the compiler turns into plain loads and
+ * stores instead of a memcpy call per block.
+ */
+#define OCOMS_DATATYPE_STRIDED_LOOP( LENGTH )                       \
+    for( ; count > 0; count-- ) {                                   \
+        memcpy( dst, src, (LENGTH) );                               \
+        dst += dst_stride;                                          \
+        src += src_stride;                                          \
+    }
+
+#if OCOMS_DATATYPE_HAVE_SSE2_GATHER
+/*
+ * Gather strided blocks of 4 or 8 bytes into a packed destination, 16
+ * bytes per store.  Returns the number of blocks left for the scalar
+ * loop.  Scattering the other way gains nothing, the strided stores
+ * dominate.
+ */
+static inline uint32_t ocoms_datatype_gather_sse2( unsigned char** pdst, const unsigned char** psrc,
+                                                   OCOMS_PTRDIFF_TYPE src_stride,
+                                                   size_t blength, uint32_t count )
+{
+    unsigned char* dst = *pdst;
+    const unsigned char* src = *psrc;
+    __m128i a, b, c, d;
+    int32_t w;
+
+    if( 8 == blength ) {
+        for( ; count >= 2; count -= 2 ) {
+            a = _mm_loadl_epi64( (const __m128i*)src );
+            b = _mm_loadl_epi64( (const __m128i*)(src + src_stride) );
+            _mm_storeu_si128( (__m128i*)dst, _mm_unpacklo_epi64(a, b) );
+            dst += 16;
+            src += 2 * src_stride;
+        }
+    } else {
+        for( ; count >= 4; count -= 4 ) {
+            memcpy( &w, src, 4 );                  a = _mm_cvtsi32_si128( w );
+            memcpy( &w, src + src_stride, 4 );     b = _mm_cvtsi32_si128( w );
+            memcpy( &w, src + 2 * src_stride, 4 ); c = _mm_cvtsi32_si128( w );
+            memcpy( &w, src + 3 * src_stride, 4 ); d = _mm_cvtsi32_si128( w );
+            _mm_storeu_si128( (__m128i*)dst,
+                              _mm_unpacklo_epi64( _mm_unpacklo_epi32(a, b),
+                                                  _mm_unpacklo_epi32(c, d) ) );
+            dst += 16;
+            src += 4 * src_stride;
+        }
+    }
+    *pdst = dst;
+    *psrc = src;
+    return count;
+}
+#endif  /* OCOMS_DATATYPE_HAVE_SSE2_GATHER */
+
+static inline void ocoms_datatype_memcpy_strided( unsigned char* dst, OCOMS_PTRDIFF_TYPE dst_stride,
+                                                  const unsigned char* src, OCOMS_PTRDIFF_TYPE src_stride,
+                                                  size_t blength, uint32_t count )
+{
+#if OCOMS_DATATYPE_HAVE_SSE2_GATHER
+    if( ((4 == blength) || (8 == blength)) && ((OCOMS_PTRDIFF_TYPE)blength == dst_stride) ) {
+        count = ocoms_datatype_gather_sse2( &dst, &src, src_stride, blength, count );
+    }
+#endif  /* OCOMS_DATATYPE_HAVE_SSE2_GATHER */
+    switch( blength ) {
+    case 1:  OCOMS_DATATYPE_STRIDED_LOOP( 1 );  break;
+    case 2:  OCOMS_DATATYPE_STRIDED_LOOP( 2 );  break;
+    case 4:  OCOMS_DATATYPE_STRIDED_LOOP( 4 );  break;
+    case 8:  OCOMS_DATATYPE_STRIDED_LOOP( 8 );  break;
+    case 16: OCOMS_DATATYPE_STRIDED_LOOP( 16 ); break;
+    case 32: OCOMS_DATATYPE_STRIDED_LOOP( 32 ); break;
+    default:
+        /* the other short blocks are copied as two overlapping words */
+        if( (blength > 8) && (blength < 32) ) {
+            size_t word = (blength < 16) ? 8 : 16, tail = blength - word;
+            for( ; count > 0; count-- ) {
+                if( 8 == word ) {
+                    memcpy( dst, src, 8 );
+                    memcpy( dst + tail, src + tail, 8 );
+                } else {
+                    memcpy( dst, src, 16 );
+                    memcpy( dst + tail, src + tail, 16 );
+                }
+                dst += dst_stride;
+                src += src_stride;
+            }
+            break;
+        }
+        for( ; count > 0; count-- ) {
+            MEMCPY( dst, src, blength );
+            dst += dst_stride;
+            src += src_stride;
+        }
+    }
+}
+
+#undef OCOMS_DATATYPE_STRIDED_LOOP
+
+/*
+ * The pack and unpack engines hand whole runs of strided blocks to
+ * ocoms_datatype_memcpy_strided, unless every block has to go through
+ * a hook of its own: the checksum, the CUDA copy or the debug checks.
+ */
+#if !defined(CHECKSUM) && !OCOMS_CUDA_SUPPORT && !OCOMS_ENABLE_DEBUG
+#define OCOMS_DATATYPE_USE_STRIDED_KERNELS 1
+#else
+#define OCOMS_DATATYPE_USE_STRIDED_KERNELS 0
+#endif
+
+END_C_DECLS
 
 #endif  /* OCOMS_DATATYPE_MEMCPY_H_HAS_BEEN_INCLUDED */
@@ -32,6 +32,7 @@
 #include "ocoms/datatype/ocoms_datatype_internal.h"
 #include "ocoms/datatype/ocoms_datatype.h"
 #include "ocoms/datatype/ocoms_convertor_internal.h"
+#include "ocoms/datatype/ocoms_datatype_memcpy.h"
 #include "ocoms/mca/base/mca_base_var.h"
 
 /* by default the debuging is turned off */
@@ -40,6 +41,11 @@ bool ocoms_unpack_debug = false;
 bool ocoms_pack_debug = false;
 bool ocoms_position_debug = false;
 bool ocoms_copy_debug = false;
+bool ocoms_optimize_debug = false;
+
+/* size from which the datatype engine copies with non-temporal stores,
+ * 0 to always go through the caches */
+static size_t ocoms_datatype_memcpy_nt_threshold = 0;
 
 extern int ocoms_cuda_verbose;
 
@@ -142,9 +148,81 @@ OCOMS_DECLSPEC const ocoms_datatype_t* ocoms_datatype_basicDatatypes[OCOMS_DATAT
 
 int ocoms_datatype_register_params(void)
 {
-#if OCOMS_ENABLE_DEBUG
     int ret;
 
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_memcpy_nt_threshold",
+                                 "Size in bytes from which the datatype engine copies blocks with "
+                                 "non-temporal stores, bypassing the caches (0 = never)",
+                                 MCA_BASE_VAR_TYPE_SIZE_T, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_datatype_memcpy_nt_threshold);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_checksum_crc32c",
+                                 "Whether the checksumming convertors compute a CRC32C of the data, "
+                                 "with the processor CRC instructions if any, instead of a sum of 32-bit words",
+                                 MCA_BASE_VAR_TYPE_BOOL, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_convertor_checksum_crc32c);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_parallel_threads",
+                                 "Number of threads packing and unpacking a large message "
+                                 "(1 = the calling thread only)",
+                                 MCA_BASE_VAR_TYPE_INT, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_convertor_parallel_threads);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_parallel_min",
+                                 "Size in bytes from which a pack or unpack request is split "
+                                 "between ddt_parallel_threads threads",
+                                 MCA_BASE_VAR_TYPE_SIZE_T, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_convertor_parallel_min);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_commit_cache",
+                                 "Whether the commit of a datatype shares the optimized description, "
+                                 "plan and position index of an identical committed datatype",
+                                 MCA_BASE_VAR_TYPE_BOOL, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_datatype_commit_cache);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_optimize_passes",
+                                 "Whether the commit of a datatype flattens its loops and coalesces its "
+                                 "elements beyond the merge of the contiguous predefined elements",
+                                 MCA_BASE_VAR_TYPE_BOOL, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_datatype_optimize_passes);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_position_index_interval",
+                                 "Size in bytes between two checkpoints of the position index "
+                                 "built at commit, used to move convertors to any position (0 = no index)",
+                                 MCA_BASE_VAR_TYPE_SIZE_T, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_5,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_datatype_position_index_interval);
+    if (0 > ret) {
+        return ret;
+    }
+
+    /* unlike the other ddt debug variables, available in all the builds */
+    ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_optimize_debug",
+                                 "Whether to output the descriptions before and after the ddt optimizer passes (nonzero = enabled)",
+                                 MCA_BASE_VAR_TYPE_BOOL, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_3,
+                                 MCA_BASE_VAR_SCOPE_LOCAL, &ocoms_optimize_debug);
+    if (0 > ret) {
+        return ret;
+    }
+
+#if OCOMS_ENABLE_DEBUG
     ret = ocoms_mca_base_var_register ("ocoms", "mpi", NULL, "ddt_unpack_debug",
 				 "Whether to output debugging information in the ddt unpack functions (nonzero = enabled)",
 				 MCA_BASE_VAR_TYPE_BOOL, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_3,
@@ -221,7 +299,15 @@ int32_t ocoms_datatype_init( void )
         datatype->desc.desc[1].end_loop.size            = datatype->size;
     }
 
-    return OCOMS_SUCCESS;
+    /* select the copy kernels once for all */
+    ocoms_datatype_memcpy_nt_min = (size_t)-1;
+#if OCOMS_DATATYPE_HAVE_MEMCPY_NT
+    if( 0 != ocoms_datatype_memcpy_nt_threshold ) {
+        ocoms_datatype_memcpy_nt_min = ocoms_datatype_memcpy_nt_threshold;
+    }
+#endif
+
+    return ocoms_datatype_cache_init();
 }
 
 
@@ -240,9 +326,15 @@ int32_t ocoms_datatype_finalize( void )
     ocoms_datatype_dfd = -1;
 #endif /* VERBOSE */
 
+    /* stop the threads of the parallel pack and unpack */
+    ocoms_convertor_parallel_finalize();
+
     /* clear all master convertors */
     ocoms_convertor_destroy_masters();
 
+    /* the datatypes still alive keep their shared descriptions */
+    ocoms_datatype_cache_finalize();
+
     return OCOMS_SUCCESS;
 }
 
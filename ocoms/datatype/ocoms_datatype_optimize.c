@@ -28,10 +28,23 @@
 #include <stdlib.h>
 
 #include "ocoms/platform/ocoms_config.h"
+#include "ocoms/platform/ocoms_constants.h"
 #include "ocoms/datatype/ocoms_datatype.h"
 #include "ocoms/datatype/ocoms_convertor.h"
 #include "ocoms/datatype/ocoms_datatype_internal.h"
 
+#include "ocoms/util/output.h"
+
+/* the dump of the optimizer passes is available in all the builds */
+extern bool ocoms_optimize_debug;
+
+/* largest number of elements a loop is unrolled into */
+#define OPT_UNROLL_MAX 8
+/* smallest number of equally spaced blocks turned into a loop */
+#define OPT_LOOP_MIN   3
+
+bool ocoms_datatype_optimize_passes = true;
+
 #define SET_EMPTY_ELEMENT( ELEM )                 \
     do {                                          \
         ddt_elem_desc_t* _elem = (ELEM);          \
@@ -277,6 +290,308 @@ ocoms_datatype_optimize_short( ocoms_datatype_t* pData,
     return OCOMS_SUCCESS;
 }
 
+/*
+ * The passes below rewrite the description produced by
+ * ocoms_datatype_optimize_short, only used by the homogeneous convertors,
+ * into a new one:
+ * - loops running once, and small loops of elements, are unrolled;
+ * - a loop around a single contiguous element covering its extent is one
+ *   large block, and a loop around a single basic element is a strided
+ *   element;
+ * - adjacent contiguous elements become one block, of bytes when their
+ *   types differ, and equally spaced basic elements of the same type one
+ *   strided element;
+ * - runs of equally spaced blocks of the same type and length become a
+ *   loop around a single block.
+ */
+typedef struct {
+    dt_elem_desc_t* desc;
+    uint32_t        used;
+    uint32_t        length;
+    uint32_t        new_loops;  /* loops created by the passes */
+} opt_desc_t;
+
+static inline size_t opt_basic_size( const ddt_elem_desc_t* elem )
+{
+    return ocoms_datatype_basicDatatypes[elem->common.type]->size;
+}
+
+static inline int opt_is_contiguous( const ddt_elem_desc_t* elem )
+{
+    return (1 == elem->count) || ((OCOMS_PTRDIFF_TYPE)opt_basic_size( elem ) == elem->extent);
+}
+
+static dt_elem_desc_t* opt_append( opt_desc_t* out )
+{
+    if( out->used == out->length ) {
+        uint32_t length = 2 * out->length;
+        dt_elem_desc_t* desc = (dt_elem_desc_t*)realloc( out->desc, length * sizeof(dt_elem_desc_t) );
+        if( NULL == desc ) return NULL;
+        out->desc   = desc;
+        out->length = length;
+    }
+    return &(out->desc[out->used++]);
+}
+
+/*
+ * Appends an element to the sequence starting at seq_start, merging it
+ * into the previous one when possible.
+ */
+static int opt_emit_elem( opt_desc_t* out, uint32_t seq_start, const ddt_elem_desc_t* elem )
+{
+    dt_elem_desc_t* place;
+
+    if( out->used > seq_start ) {
+        ddt_elem_desc_t* prev = &(out->desc[out->used - 1].elem);
+        size_t prev_size = opt_basic_size( prev ), size = opt_basic_size( elem );
+
+        if( (prev->common.flags & OCOMS_DATATYPE_FLAG_DATA) && opt_is_contiguous( prev ) &&
+            opt_is_contiguous( elem ) &&
+            (elem->disp == prev->disp + (OCOMS_PTRDIFF_TYPE)(prev->count * prev_size)) ) {
+            /* adjacent blocks, in bytes when the types differ */
+            if( prev->common.type == elem->common.type ) {
+                if( ((uint64_t)prev->count + elem->count) <= UINT32_MAX ) {
+                    CREATE_ELEM( (dt_elem_desc_t*)prev, elem->common.type, OCOMS_DATATYPE_FLAG_BASIC,
+                                 prev->count + elem->count, prev->disp, size );
+                    return OCOMS_SUCCESS;
+                }
+            } else if( (prev->count * prev_size + elem->count * size) <= UINT32_MAX ) {
+                CREATE_ELEM( (dt_elem_desc_t*)prev, OCOMS_DATATYPE_UINT1, OCOMS_DATATYPE_FLAG_BASIC,
+                             (uint32_t)(prev->count * prev_size + elem->count * size), prev->disp, 1 );
+                return OCOMS_SUCCESS;
+            }
+        }
+        if( (prev->common.flags & OCOMS_DATATYPE_FLAG_DATA) && (prev->common.type == elem->common.type) &&
+            (1 == elem->count) && (prev->count < UINT32_MAX) ) {
+            /* equally spaced basic elements */
+            OCOMS_PTRDIFF_TYPE stride = elem->disp - prev->disp;
+            if( (1 == prev->count) && (stride > (OCOMS_PTRDIFF_TYPE)size) ) {
+                CREATE_ELEM( (dt_elem_desc_t*)prev, elem->common.type,
+                             OCOMS_DATATYPE_FLAG_BASIC & ~(OCOMS_DATATYPE_FLAG_CONTIGUOUS | OCOMS_DATATYPE_FLAG_NO_GAPS),
+                             2, prev->disp, stride );
+                return OCOMS_SUCCESS;
+            }
+            if( (prev->count > 1) && (prev->extent > (OCOMS_PTRDIFF_TYPE)size) &&
+                (elem->disp == prev->disp + (OCOMS_PTRDIFF_TYPE)prev->count * prev->extent) ) {
+                prev->count++;
+                return OCOMS_SUCCESS;
+            }
+        }
+    }
+    place = opt_append( out );
+    if( NULL == place ) return OCOMS_ERR_OUT_OF_RESOURCE;
+    place->elem = *elem;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * Turns the runs of at least OPT_LOOP_MIN equally spaced blocks of the
+ * same type and length of the sequence starting at seq_start into loops.
+ */
+static int opt_coalesce_blocks( opt_desc_t* out, uint32_t seq_start )
+{
+    uint32_t pos, run, n, used = out->used, dst = seq_start;
+    dt_elem_desc_t *desc = out->desc, *elems;
+    ddt_elem_desc_t* first;
+    OCOMS_PTRDIFF_TYPE stride;
+    size_t blength;
+
+    for( pos = seq_start; pos < used; ) {
+        if( OCOMS_DATATYPE_LOOP == desc[pos].elem.common.type ) {
+            /* its body is done already, just move it */
+            for( n = desc[pos].loop.items + 1; n > 0; n--, dst++, pos++ ) {
+                if( dst != pos ) desc[dst] = desc[pos];
+            }
+            continue;
+        }
+        first = &(desc[pos].elem);
+        run = 1;
+        if( (first->common.flags & OCOMS_DATATYPE_FLAG_DATA) && (first->count > 1) && opt_is_contiguous( first ) &&
+            ((pos + 1) < used) && (desc[pos+1].elem.common.flags & OCOMS_DATATYPE_FLAG_DATA) ) {
+            stride = desc[pos+1].elem.disp - first->disp;
+            blength = first->count * opt_basic_size( first );
+            while( ((pos + run) < used) &&
+                   (desc[pos+run].elem.common.flags & OCOMS_DATATYPE_FLAG_DATA) &&
+                   (desc[pos+run].elem.common.type == first->common.type) &&
+                   (desc[pos+run].elem.count == first->count) && opt_is_contiguous( &(desc[pos+run].elem) ) &&
+                   (desc[pos+run].elem.disp == first->disp + (OCOMS_PTRDIFF_TYPE)run * stride) )
+                run++;
+            if( (run >= OPT_LOOP_MIN) && (stride > (OCOMS_PTRDIFF_TYPE)blength) ) {
+                /* the loop takes 3 entries in place of run */
+                elems = &(desc[dst]);
+                n = run;
+                elems[1].elem = *first;
+                CREATE_LOOP_START( &elems[0], n, 2, stride,
+                                   OCOMS_DATATYPE_FLAG_CONTIGUOUS );
+                CREATE_LOOP_END( &elems[2], 2, elems[1].elem.disp, blength,
+                                 OCOMS_DATATYPE_FLAG_CONTIGUOUS );
+                dst += 3;
+                pos += run;
+                out->new_loops++;
+                continue;
+            }
+            run = 1;
+        }
+        if( dst != pos ) desc[dst] = desc[pos];
+        dst++; pos++;
+    }
+    out->used = dst;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * Rewrites the entries [pos, end) of the description in into out, where
+ * the elements merge with the ones of the sequence starting at seq_start.
+ */
+static int opt_rewrite( const dt_elem_desc_t* in, uint32_t pos, uint32_t end,
+                        opt_desc_t* out, uint32_t seq_start )
+{
+    uint32_t body_start, nb_body, i, j;
+    int rc;
+
+    while( pos < end ) {
+        if( OCOMS_DATATYPE_LOOP == in[pos].elem.common.type ) {
+            const ddt_loop_desc_t* loop = &(in[pos].loop);
+            const ddt_endloop_desc_t* end_loop = &(in[pos + loop->items].end_loop);
+            dt_elem_desc_t body[OPT_UNROLL_MAX / 2];
+            ddt_elem_desc_t elem;
+            dt_elem_desc_t* place;
+
+            if( 1 == loop->loops ) {
+                /* a single iteration is just its body */
+                rc = opt_rewrite( in, pos + 1, pos + loop->items, out, seq_start );
+                if( OCOMS_SUCCESS != rc ) return rc;
+                pos += loop->items + 1;
+                continue;
+            }
+            body_start = out->used;
+            if( NULL == opt_append( out ) ) return OCOMS_ERR_OUT_OF_RESOURCE;
+            rc = opt_rewrite( in, pos + 1, pos + loop->items, out, body_start + 1 );
+            if( OCOMS_SUCCESS != rc ) return rc;
+            rc = opt_coalesce_blocks( out, body_start + 1 );
+            if( OCOMS_SUCCESS != rc ) return rc;
+            nb_body = out->used - body_start - 1;
+
+            if( (nb_body > 1) && (((uint64_t)loop->loops * nb_body) <= OPT_UNROLL_MAX) ) {
+                /* a small loop: unroll it, the inner loops moving with their elements */
+                for( i = 0; i < nb_body; i++ ) body[i] = out->desc[body_start + 1 + i];
+                out->used = body_start;
+                for( j = 0; j < loop->loops; j++ ) {
+                    OCOMS_PTRDIFF_TYPE shift = (OCOMS_PTRDIFF_TYPE)j * loop->extent;
+                    for( i = 0; i < nb_body; i++ ) {
+                        if( body[i].elem.common.flags & OCOMS_DATATYPE_FLAG_DATA ) {
+                            elem = body[i].elem;
+                            elem.disp += shift;
+                            rc = opt_emit_elem( out, seq_start, &elem );
+                            if( OCOMS_SUCCESS != rc ) return rc;
+                            continue;
+                        }
+                        place = opt_append( out );
+                        if( NULL == place ) return OCOMS_ERR_OUT_OF_RESOURCE;
+                        *place = body[i];
+                        if( OCOMS_DATATYPE_END_LOOP == place->elem.common.type )
+                            place->end_loop.first_elem_disp += shift;
+                    }
+                }
+                pos += loop->items + 1;
+                continue;
+            }
+            if( 1 == nb_body ) {
+                elem = out->desc[body_start + 1].elem;
+                if( (elem.common.flags & OCOMS_DATATYPE_FLAG_DATA) && opt_is_contiguous( &elem ) &&
+                    (loop->extent == (OCOMS_PTRDIFF_TYPE)(elem.count * opt_basic_size( &elem ))) &&
+                    (((uint64_t)elem.count * loop->loops) <= UINT32_MAX) ) {
+                    /* contiguous iterations: a single block */
+                    CREATE_ELEM( (dt_elem_desc_t*)&elem, elem.common.type, OCOMS_DATATYPE_FLAG_BASIC,
+                                 elem.count * loop->loops, elem.disp, opt_basic_size( &elem ) );
+                } else if( (elem.common.flags & OCOMS_DATATYPE_FLAG_DATA) && (1 == elem.count) ) {
+                    /* one basic element per iteration: a strided element */
+                    CREATE_ELEM( (dt_elem_desc_t*)&elem, elem.common.type,
+                                 OCOMS_DATATYPE_FLAG_BASIC & ~(OCOMS_DATATYPE_FLAG_CONTIGUOUS | OCOMS_DATATYPE_FLAG_NO_GAPS),
+                                 loop->loops, elem.disp, loop->extent );
+                } else {
+                    goto keep_loop;
+                }
+                out->used = body_start;
+                rc = opt_emit_elem( out, seq_start, &elem );
+                if( OCOMS_SUCCESS != rc ) return rc;
+                pos += loop->items + 1;
+                continue;
+            }
+        keep_loop:
+            /* the layout of the body did not change, nor its first element and size */
+            CREATE_LOOP_START( &(out->desc[body_start]), loop->loops, nb_body + 1,
+                               loop->extent, loop->common.flags );
+            place = opt_append( out );
+            if( NULL == place ) return OCOMS_ERR_OUT_OF_RESOURCE;
+            CREATE_LOOP_END( place, nb_body + 1, end_loop->first_elem_disp, end_loop->size,
+                             end_loop->common.flags );
+            pos += loop->items + 1;
+            continue;
+        }
+        if( in[pos].elem.common.flags & OCOMS_DATATYPE_FLAG_DATA ) {
+            rc = opt_emit_elem( out, seq_start, &(in[pos].elem) );
+            if( OCOMS_SUCCESS != rc ) return rc;
+        }
+        pos++;
+    }
+    return OCOMS_SUCCESS;
+}
+
+static void opt_dump( const char* title, dt_elem_desc_t* desc, uint32_t used )
+{
+    size_t length = used * 100 + 100;
+    char* buffer = (char*)malloc( length );
+    int index;
+
+    if( NULL == buffer ) return;
+    index = snprintf( buffer, length, "%s (%u elements)\n", title, used );
+    index += ocoms_datatype_dump_data_desc( desc, used, buffer + index, length - index );
+    buffer[index] = '\0';
+    ocoms_output( 0, "%s", buffer );
+    free( buffer );
+}
+
+/*
+ * Replaces the optimized description of the datatype by its rewrite,
+ * keeping room for the fake OCOMS_DATATYPE_END_LOOP.  The loops created
+ * count in the stack depth of the datatype.
+ */
+static int32_t ocoms_datatype_optimize_rewrite( ocoms_datatype_t* pData, dt_type_desc_t* pTypeDesc )
+{
+    opt_desc_t out;
+    int rc;
+
+    out.length    = pTypeDesc->used + 1;
+    out.used      = 0;
+    out.new_loops = 0;
+    out.desc      = (dt_elem_desc_t*)malloc( out.length * sizeof(dt_elem_desc_t) );
+    if( NULL == out.desc ) return OCOMS_ERR_OUT_OF_RESOURCE;
+
+    rc = opt_rewrite( pTypeDesc->desc, 0, pTypeDesc->used, &out, 0 );
+    if( OCOMS_SUCCESS == rc ) rc = opt_coalesce_blocks( &out, 0 );
+    if( (OCOMS_SUCCESS == rc) && (out.used == out.length) ) {
+        /* room for the fake end loop */
+        if( NULL == opt_append( &out ) ) rc = OCOMS_ERR_OUT_OF_RESOURCE;
+        else out.used--;
+    }
+    if( OCOMS_SUCCESS != rc ) {
+        free( out.desc );
+        return rc;  /* keep the short description */
+    }
+
+    if( OCOMS_UNLIKELY(ocoms_optimize_debug) ) {
+        opt_dump( "description before the optimizer passes", pTypeDesc->desc, pTypeDesc->used );
+        opt_dump( "description after the optimizer passes", out.desc, out.used );
+    }
+    free( pTypeDesc->desc );
+    pTypeDesc->desc   = out.desc;
+    pTypeDesc->length = out.length - 1;
+    pTypeDesc->used   = out.used;
+    pData->btypes[OCOMS_DATATYPE_LOOP] += out.new_loops;
+    return OCOMS_SUCCESS;
+}
+
 int32_t ocoms_datatype_commit( ocoms_datatype_t * pData )
 {
     ddt_endloop_desc_t* pLast = &(pData->desc.desc[pData->desc.used].end_loop);
@@ -303,6 +618,7 @@ int32_t ocoms_datatype_commit( ocoms_datatype_t * pData )
     pLast->common.type     = OCOMS_DATATYPE_END_LOOP;
     pLast->common.flags    = 0;
     pLast->items           = pData->desc.used;
+    pLast->unused          = -1;
     pLast->first_elem_disp = first_elem_disp;
     pLast->size            = pData->size;
 
@@ -314,10 +630,19 @@ int32_t ocoms_datatype_commit( ocoms_datatype_t * pData )
         return OCOMS_SUCCESS;
     }
 
+    /* An identical datatype may already have done the work. */
+    if( ocoms_datatype_commit_cache &&
+        (OCOMS_SUCCESS == ocoms_datatype_cache_lookup( pData )) ) {
+        return OCOMS_SUCCESS;
+    }
+
     /* If the data is contiguous is useless to generate an optimized version. */
     /*if( pData->size == (pData->true_ub - pData->true_lb) ) return OCOMS_SUCCESS; */
 
     (void)ocoms_datatype_optimize_short( pData, 1, &(pData->opt_desc) );
+    if( ocoms_datatype_optimize_passes && (0 != pData->opt_desc.used) ) {
+        (void)ocoms_datatype_optimize_rewrite( pData, &(pData->opt_desc) );
+    }
     if( 0 != pData->opt_desc.used ) {
         /* let's add a fake element at the end just to avoid useless comparaisons
          * in pack/unpack functions.
@@ -329,5 +654,14 @@ int32_t ocoms_datatype_commit( ocoms_datatype_t * pData )
         pLast->first_elem_disp = first_elem_disp;
         pLast->size            = pData->size;
     }
+
+    /* the contiguous datatypes have their own pack and unpack functions */
+    if( !(pData->flags & OCOMS_DATATYPE_FLAG_CONTIGUOUS) ) {
+        (void)ocoms_datatype_plan_build( pData );
+        (void)ocoms_datatype_position_index_build( pData );
+    }
+    if( ocoms_datatype_commit_cache ) {
+        (void)ocoms_datatype_cache_insert( pData );
+    }
     return OCOMS_SUCCESS;
 }
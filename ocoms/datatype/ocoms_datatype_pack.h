@@ -60,6 +60,12 @@ static inline void pack_predefined_data( ocoms_convertor_t* CONVERTOR,
         _source        += _copy_blength;
         *(DESTINATION) += _copy_blength;
     } else {
+#if OCOMS_DATATYPE_USE_STRIDED_KERNELS
+        ocoms_datatype_memcpy_strided( *(DESTINATION), _copy_blength, _source, _elem->extent,
+                                       _copy_blength, _copy_count );
+        *(DESTINATION) += (OCOMS_PTRDIFF_TYPE)_copy_count * _copy_blength;
+        _source        += (OCOMS_PTRDIFF_TYPE)_copy_count * _elem->extent;
+#else
         uint32_t _i;
         for( _i = 0; _i < _copy_count; _i++ ) {
             OCOMS_DATATYPE_SAFEGUARD_POINTER( _source, _copy_blength, (CONVERTOR)->pBaseBuf,
@@ -70,6 +76,7 @@ static inline void pack_predefined_data( ocoms_convertor_t* CONVERTOR,
             *(DESTINATION) += _copy_blength;
             _source        += _elem->extent;
         }
+#endif  /* OCOMS_DATATYPE_USE_STRIDED_KERNELS */
         _copy_blength *= _copy_count;
     }
     *(SOURCE)  = _source - _elem->disp;
@@ -0,0 +1,394 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/datatype/ocoms_datatype.h"
+#include "ocoms/datatype/ocoms_convertor.h"
+#include "ocoms/datatype/ocoms_datatype_internal.h"
+#include "ocoms/datatype/ocoms_datatype_memcpy.h"
+#include "ocoms/datatype/ocoms_datatype_prototypes.h"
+
+/* number of runs the builder may produce before merging, which bounds
+ * the time spent by the commit on datatypes that do not compress */
+#define PLAN_BUILD_BUDGET (64 * OCOMS_DATATYPE_PLAN_MAX_ENTRIES)
+
+/* initial number of entries of a plan */
+#define PLAN_INITIAL_LENGTH 8
+
+/*
+ * Appends a run of COUNT blocks of BLENGTH bytes, STRIDE bytes apart, to
+ * the plan, merging it into the last entry whenever the result is still
+ * a single run of equally spaced blocks.
+ */
+static int plan_append( ocoms_datatype_plan_t* plan, size_t* budget,
+                        OCOMS_PTRDIFF_TYPE disp, OCOMS_PTRDIFF_TYPE stride,
+                        size_t blength, uint32_t count )
+{
+    ocoms_datatype_plan_entry_t* last;
+
+    if( 0 == (*budget)-- ) return OCOMS_ERR_OUT_OF_RESOURCE;
+
+    /* equally spaced blocks without gaps are a single block */
+    if( (count > 1) && ((OCOMS_PTRDIFF_TYPE)blength == stride) ) {
+        blength *= count;
+        count = 1;
+    }
+    if( 1 == count ) stride = 0;
+
+    if( 0 != plan->used ) {
+        last = &(plan->entries[plan->used - 1]);
+        if( (1 == last->count) && (1 == count) &&
+            ((last->disp + (OCOMS_PTRDIFF_TYPE)last->blength) == disp) ) {
+            /* two adjacent blocks */
+            last->blength += blength;
+            return OCOMS_SUCCESS;
+        }
+        if( (last->blength == blength) && ((uint64_t)last->count + count <= UINT32_MAX) ) {
+            if( 1 == last->count ) {
+                /* a second block sets the stride of the run */
+                if( (1 == count) || ((disp - last->disp) == stride) ) {
+                    last->stride = disp - last->disp;
+                    last->count += count;
+                    return OCOMS_SUCCESS;
+                }
+            } else if( ((1 == count) || (last->stride == stride)) &&
+                       ((last->disp + (OCOMS_PTRDIFF_TYPE)last->count * last->stride) == disp) ) {
+                /* the run continues */
+                last->count += count;
+                return OCOMS_SUCCESS;
+            }
+        }
+    }
+
+    if( plan->used == plan->length ) {
+        ocoms_datatype_plan_entry_t* entries;
+        uint32_t length = (0 == plan->length) ? PLAN_INITIAL_LENGTH : 2 * plan->length;
+
+        if( plan->length >= OCOMS_DATATYPE_PLAN_MAX_ENTRIES ) return OCOMS_ERR_OUT_OF_RESOURCE;
+        entries = (ocoms_datatype_plan_entry_t*)realloc( plan->entries, length * sizeof(*entries) );
+        if( NULL == entries ) return OCOMS_ERR_OUT_OF_RESOURCE;
+        plan->entries = entries;
+        plan->length  = length;
+    }
+    last = &(plan->entries[plan->used++]);
+    last->disp    = disp;
+    last->stride  = stride;
+    last->blength = blength;
+    last->count   = count;
+    last->packed  = 0;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * Appends the runs of the description entries [pos_desc, end_desc), whose
+ * displacements are relative to base.
+ */
+static int plan_walk( ocoms_datatype_plan_t* plan, size_t* budget, const dt_elem_desc_t* desc,
+                      uint32_t pos_desc, uint32_t end_desc, OCOMS_PTRDIFF_TYPE base )
+{
+    const dt_elem_desc_t* pElem;
+    size_t basic_size;
+    uint32_t i;
+    int rc;
+
+    while( pos_desc < end_desc ) {
+        pElem = &(desc[pos_desc]);
+        if( OCOMS_DATATYPE_LOOP == pElem->elem.common.type ) {
+            const ddt_loop_desc_t* loop = &(pElem->loop);
+            const ddt_elem_desc_t* body = &(desc[pos_desc + 1].elem);
+
+            basic_size = ocoms_datatype_basicDatatypes[body->common.type]->size;
+            if( (2 == loop->items) && (body->common.flags & OCOMS_DATATYPE_FLAG_DATA) &&
+                ((OCOMS_PTRDIFF_TYPE)basic_size == body->extent) ) {
+                /* a loop around a single contiguous block is a strided run */
+                rc = plan_append( plan, budget, base + body->disp, loop->extent,
+                                  basic_size * body->count, loop->loops );
+                if( OCOMS_SUCCESS != rc ) return rc;
+            } else {
+                for( i = 0; i < loop->loops; i++ ) {
+                    rc = plan_walk( plan, budget, desc, pos_desc + 1, pos_desc + loop->items,
+                                    base + (OCOMS_PTRDIFF_TYPE)i * loop->extent );
+                    if( OCOMS_SUCCESS != rc ) return rc;
+                }
+            }
+            pos_desc += loop->items + 1;
+            continue;
+        }
+        if( pElem->elem.common.flags & OCOMS_DATATYPE_FLAG_DATA ) {
+            basic_size = ocoms_datatype_basicDatatypes[pElem->elem.common.type]->size;
+            if( (OCOMS_PTRDIFF_TYPE)basic_size == pElem->elem.extent ) {
+                rc = plan_append( plan, budget, base + pElem->elem.disp, 0,
+                                  basic_size * pElem->elem.count, 1 );
+            } else {
+                rc = plan_append( plan, budget, base + pElem->elem.disp, pElem->elem.extent,
+                                  basic_size, pElem->elem.count );
+            }
+            if( OCOMS_SUCCESS != rc ) return rc;
+        }
+        pos_desc++;
+    }
+    return OCOMS_SUCCESS;
+}
+
+void ocoms_datatype_plan_release( ocoms_datatype_t* pData )
+{
+    if( NULL == pData->plan ) return;
+    if( NULL != pData->plan->entries ) free( pData->plan->entries );
+    free( pData->plan );
+    pData->plan = NULL;
+}
+
+/*
+ * Builds the plan of a committed datatype from its optimized description.
+ * Datatypes whose plan would be too long are left without one, and keep
+ * using the generic pack and unpack functions.
+ */
+int32_t ocoms_datatype_plan_build( ocoms_datatype_t* pData )
+{
+    const dt_type_desc_t* desc = (0 != pData->opt_desc.used) ? &(pData->opt_desc) : &(pData->desc);
+    ocoms_datatype_plan_t* plan;
+    size_t budget = PLAN_BUILD_BUDGET, packed = 0;
+    uint32_t i;
+    int rc;
+
+    ocoms_datatype_plan_release( pData );
+    if( (0 == pData->size) || (0 == desc->used) ) return OCOMS_SUCCESS;
+
+    plan = (ocoms_datatype_plan_t*)calloc( 1, sizeof(ocoms_datatype_plan_t) );
+    if( NULL == plan ) return OCOMS_ERR_OUT_OF_RESOURCE;
+
+    rc = plan_walk( plan, &budget, desc->desc, 0, desc->used, 0 );
+    if( OCOMS_SUCCESS == rc ) {
+        for( i = 0; i < plan->used; i++ ) {
+            plan->entries[i].packed = packed;
+            packed += plan->entries[i].blength * plan->entries[i].count;
+        }
+        if( packed != pData->size ) rc = OCOMS_ERROR;
+    }
+    if( OCOMS_SUCCESS != rc ) {
+        if( NULL != plan->entries ) free( plan->entries );
+        free( plan );
+        return rc;
+    }
+    pData->plan = plan;
+    return OCOMS_SUCCESS;
+}
+
+/*
+ * Copies between the user buffer and the iovecs following the plan.  The
+ * position is recomputed from bConverted at each call, so the convertor
+ * needs no stack and can be moved to any byte.  The stack is left behind
+ * (CONVERTOR_STACK_STALE) until something else needs it.
+ */
+static inline int32_t
+ocoms_plan_copy( ocoms_convertor_t* pConv, struct iovec* iov, uint32_t* out_size,
+                 size_t* max_data, int pack )
+{
+    const ocoms_datatype_t* pData = pConv->pDesc;
+    const ocoms_datatype_plan_t* plan = pData->plan;
+    const ocoms_datatype_plan_entry_t *entry, *end = plan->entries + plan->used;
+    OCOMS_PTRDIFF_TYPE extent = pData->ub - pData->lb;
+    size_t initial_amount = pConv->bConverted, in_elem, offset, space, length, boff;
+    unsigned char *user, *packed, *memory;
+    uint32_t iov_count, block, nblocks, lo, hi, mid;
+
+    /* find the run, the block and the byte inside the block */
+    user = pConv->pBaseBuf + (OCOMS_PTRDIFF_TYPE)(pConv->bConverted / pData->size) * extent;
+    in_elem = pConv->bConverted % pData->size;
+    lo = 0; hi = plan->used - 1;
+    while( lo < hi ) {
+        mid = (lo + hi + 1) / 2;
+        if( plan->entries[mid].packed <= in_elem ) lo = mid;
+        else hi = mid - 1;
+    }
+    entry  = &(plan->entries[lo]);
+    offset = in_elem - entry->packed;
+    block  = (uint32_t)(offset / entry->blength);
+    boff   = offset - (size_t)block * entry->blength;
+
+    for( iov_count = 0; iov_count < (*out_size); iov_count++ ) {
+        length = pConv->local_size - pConv->bConverted;
+        if( 0 == length ) break;
+        space = iov[iov_count].iov_len;
+        if( space > length ) space = length;
+        packed = (unsigned char*)iov[iov_count].iov_base;
+
+        while( 0 != space ) {
+            memory = user + entry->disp + (OCOMS_PTRDIFF_TYPE)block * entry->stride + boff;
+            if( (0 != boff) || (space < entry->blength) ) {
+                /* the beginning or the end of a block */
+                length = entry->blength - boff;
+                if( length > space ) length = space;
+                if( pack ) MEMCPY( packed, memory, length );
+                else MEMCPY( memory, packed, length );
+                boff += length;
+                if( boff == entry->blength ) {
+                    boff = 0;
+                    block++;
+                }
+            } else {
+                nblocks = entry->count - block;
+                if( (space / entry->blength) < nblocks )
+                    nblocks = (uint32_t)(space / entry->blength);
+                length = (size_t)nblocks * entry->blength;
+                if( 1 == nblocks ) {
+                    if( pack ) MEMCPY( packed, memory, length );
+                    else MEMCPY( memory, packed, length );
+                } else if( pack ) {
+                    ocoms_datatype_memcpy_strided( packed, entry->blength, memory, entry->stride,
+                                                   entry->blength, nblocks );
+                } else {
+                    ocoms_datatype_memcpy_strided( memory, entry->stride, packed, entry->blength,
+                                                   entry->blength, nblocks );
+                }
+                block += nblocks;
+            }
+            packed += length;
+            space  -= length;
+            if( block == entry->count ) {
+                block = 0;
+                if( ++entry == end ) {
+                    entry = plan->entries;
+                    user += extent;
+                }
+            }
+        }
+        iov[iov_count].iov_len = packed - (unsigned char*)iov[iov_count].iov_base;
+        pConv->bConverted += iov[iov_count].iov_len;
+    }
+
+    *max_data = pConv->bConverted - initial_amount;
+    pConv->flags |= CONVERTOR_STACK_STALE;
+    *out_size = iov_count;
+    if( pConv->bConverted == pConv->local_size ) {
+        pConv->flags |= CONVERTOR_COMPLETED;
+        return 1;
+    }
+    return 0;
+}
+
+int32_t
+ocoms_pack_plan( ocoms_convertor_t* pConvertor,
+                 struct iovec* iov, uint32_t* out_size,
+                 size_t* max_data )
+{
+    return ocoms_plan_copy( pConvertor, iov, out_size, max_data, 1 );
+}
+
+int32_t
+ocoms_unpack_plan( ocoms_convertor_t* pConvertor,
+                   struct iovec* iov, uint32_t* out_size,
+                   size_t* max_data )
+{
+    return ocoms_plan_copy( pConvertor, iov, out_size, max_data, 0 );
+}
+
+/*
+ * Copies the data of a vector, a plan made of a single run, as a 2-D
+ * array of blocks: the rows are the elements of the convertor, unless
+ * the elements follow each other at the stride of the blocks, in which
+ * case the whole message is a single row.  Full blocks go through the
+ * strided copy, which gathers the small blocks with SIMD loads and
+ * streams the large ones.
+ */
+static inline int32_t
+ocoms_vector_copy( ocoms_convertor_t* pConv, struct iovec* iov, uint32_t* out_size,
+                   size_t* max_data, int pack )
+{
+    const ocoms_datatype_t* pData = pConv->pDesc;
+    const ocoms_datatype_plan_entry_t* entry = &(pData->plan->entries[0]);
+    OCOMS_PTRDIFF_TYPE stride = entry->stride, row_extent = pData->ub - pData->lb;
+    size_t blength = entry->blength, row_length = entry->count;
+    size_t initial_amount = pConv->bConverted, space, length, boff, block, nblocks;
+    unsigned char *row, *packed, *memory;
+    uint32_t iov_count;
+
+    if( row_extent == (OCOMS_PTRDIFF_TYPE)entry->count * stride ) {
+        row_length *= pConv->count;
+    }
+    block = pConv->bConverted / blength;
+    boff  = pConv->bConverted - block * blength;
+    row   = pConv->pBaseBuf + entry->disp + (OCOMS_PTRDIFF_TYPE)(block / row_length) * row_extent;
+    block = block % row_length;
+
+    for( iov_count = 0; iov_count < (*out_size); iov_count++ ) {
+        length = pConv->local_size - pConv->bConverted;
+        if( 0 == length ) break;
+        space = iov[iov_count].iov_len;
+        if( space > length ) space = length;
+        packed = (unsigned char*)iov[iov_count].iov_base;
+
+        while( 0 != space ) {
+            memory = row + (OCOMS_PTRDIFF_TYPE)block * stride + boff;
+            if( (0 != boff) || (space < blength) ) {
+                length = blength - boff;
+                if( length > space ) length = space;
+                if( pack ) MEMCPY( packed, memory, length );
+                else MEMCPY( memory, packed, length );
+                boff += length;
+                if( boff == blength ) {
+                    boff = 0;
+                    block++;
+                }
+            } else {
+                nblocks = row_length - block;
+                if( (space / blength) < nblocks ) nblocks = space / blength;
+                if( nblocks > UINT32_MAX ) nblocks = UINT32_MAX;
+                length = nblocks * blength;
+                if( pack ) {
+                    ocoms_datatype_memcpy_strided( packed, blength, memory, stride,
+                                                   blength, (uint32_t)nblocks );
+                } else {
+                    ocoms_datatype_memcpy_strided( memory, stride, packed, blength,
+                                                   blength, (uint32_t)nblocks );
+                }
+                block += nblocks;
+            }
+            packed += length;
+            space  -= length;
+            if( block == row_length ) {
+                block = 0;
+                row += row_extent;
+            }
+        }
+        iov[iov_count].iov_len = packed - (unsigned char*)iov[iov_count].iov_base;
+        pConv->bConverted += iov[iov_count].iov_len;
+    }
+
+    *max_data = pConv->bConverted - initial_amount;
+    pConv->flags |= CONVERTOR_STACK_STALE;
+    *out_size = iov_count;
+    if( pConv->bConverted == pConv->local_size ) {
+        pConv->flags |= CONVERTOR_COMPLETED;
+        return 1;
+    }
+    return 0;
+}
+
+int32_t
+ocoms_pack_vector( ocoms_convertor_t* pConvertor,
+                   struct iovec* iov, uint32_t* out_size,
+                   size_t* max_data )
+{
+    return ocoms_vector_copy( pConvertor, iov, out_size, max_data, 1 );
+}
+
+int32_t
+ocoms_unpack_vector( ocoms_convertor_t* pConvertor,
+                     struct iovec* iov, uint32_t* out_size,
+                     size_t* max_data )
+{
+    return ocoms_vector_copy( pConvertor, iov, out_size, max_data, 0 );
+}
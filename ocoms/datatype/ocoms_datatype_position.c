@@ -24,13 +24,16 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
 #endif
 
+#include "ocoms/platform/ocoms_constants.h"
 #include "ocoms/datatype/ocoms_datatype.h"
 #include "ocoms/datatype/ocoms_convertor.h"
+#include "ocoms/datatype/ocoms_convertor_internal.h"
 #include "ocoms/datatype/ocoms_datatype_internal.h"
 
 #if OCOMS_ENABLE_DEBUG
@@ -42,6 +45,8 @@ extern bool ocoms_position_debug;
 #define DO_DEBUG(INST)
 #endif  /* OCOMS_ENABLE_DEBUG */
 
+size_t ocoms_datatype_position_index_interval = 8 * 1024;
+
 /* The pack/unpack functions need a cleanup. I have to create a proper interface to access
  * all basic functionalities, hence using them as basic blocks for all conversion functions.
  *
@@ -241,3 +246,150 @@ int ocoms_convertor_generic_simple_position( ocoms_convertor_t* pConvertor,
     }
     return 1;
 }
+
+void ocoms_datatype_position_index_release( ocoms_datatype_t* pData )
+{
+    if( NULL == pData->position_index ) return;
+    if( NULL != pData->position_index->checkpoints ) free( pData->position_index->checkpoints );
+    if( NULL != pData->position_index->stacks ) free( pData->position_index->stacks );
+    free( pData->position_index );
+    pData->position_index = NULL;
+}
+
+/*
+ * Builds the position index of a committed datatype, by moving a send
+ * convertor on a single element with the generic position function and
+ * saving its stack every interval bytes.  The first checkpoint is the
+ * beginning of the element.  Datatypes smaller than two intervals do
+ * not need an index.
+ */
+int32_t ocoms_datatype_position_index_build( ocoms_datatype_t* pData )
+{
+    ocoms_datatype_position_index_t* index;
+    ocoms_convertor_t convertor;
+    dt_type_desc_t* desc = (0 != pData->opt_desc.used) ? &(pData->opt_desc) : &(pData->desc);
+    size_t interval = ocoms_datatype_position_index_interval, position;
+    dt_stack_t* pStack;
+    uint32_t depth, length, i;
+    int32_t rc = OCOMS_SUCCESS;
+
+    ocoms_datatype_position_index_release( pData );
+    if( (0 == interval) || (0 == desc->used) || (pData->size < 2 * interval) )
+        return OCOMS_SUCCESS;
+    if( (pData->size / interval) >= OCOMS_DATATYPE_POSITION_INDEX_MAX )
+        interval = pData->size / (OCOMS_DATATYPE_POSITION_INDEX_MAX - 1) + 1;
+    length = (uint32_t)((pData->size - 1) / interval) + 1;
+    depth  = pData->btypes[OCOMS_DATATYPE_LOOP] + 2;
+
+    index = (ocoms_datatype_position_index_t*)calloc( 1, sizeof(ocoms_datatype_position_index_t) );
+    if( NULL == index ) return OCOMS_ERR_OUT_OF_RESOURCE;
+    index->desc        = desc->desc;
+    index->depth       = depth;
+    index->checkpoints = (ocoms_datatype_checkpoint_t*)malloc( length * sizeof(ocoms_datatype_checkpoint_t) );
+    index->stacks      = (dt_stack_t*)malloc( (size_t)length * depth * sizeof(dt_stack_t) );
+    pStack             = (dt_stack_t*)malloc( depth * sizeof(dt_stack_t) );
+    if( (NULL == index->checkpoints) || (NULL == index->stacks) || (NULL == pStack) ) {
+        if( NULL != pStack ) free( pStack );
+        pData->position_index = index;
+        ocoms_datatype_position_index_release( pData );
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+
+    OBJ_CONSTRUCT( &convertor, ocoms_convertor_t );
+    convertor.pStack         = pStack;
+    convertor.stack_size     = depth;
+    convertor.flags          = CONVERTOR_SEND | CONVERTOR_HOMOGENEOUS;
+    convertor.pDesc          = pData;
+    convertor.use_desc       = desc;
+    convertor.count          = 1;
+    convertor.local_size     = pData->size;
+    convertor.remote_size    = pData->size;
+    convertor.pBaseBuf       = NULL;
+    convertor.bConverted     = 0;
+    convertor.partial_length = 0;
+    convertor.stack_pos      = 1;
+    pStack[0].index = -1;
+    pStack[0].type  = 0;
+    pStack[0].count = 1;
+    pStack[0].disp  = 0;
+    pStack[1].index = 0;
+    pStack[1].type  = 0;
+    pStack[1].disp  = 0;
+    if( OCOMS_DATATYPE_LOOP == desc->desc[0].elem.common.type ) {
+        pStack[1].count = desc->desc[0].loop.loops;
+    } else {
+        pStack[1].count = desc->desc[0].elem.count;
+    }
+
+    for( position = 0; ; ) {
+        /* the convertor may have stopped before position, on the last
+         * complete predefined element */
+        i = index->used;
+        if( (0 == i) || (index->checkpoints[i-1].offset < convertor.bConverted) ) {
+            index->checkpoints[i].offset    = convertor.bConverted;
+            index->checkpoints[i].stack_pos = convertor.stack_pos;
+            memcpy( index->stacks + (size_t)i * depth, pStack,
+                    (convertor.stack_pos + 1) * sizeof(dt_stack_t) );
+            index->used++;
+        }
+        position += interval;
+        if( (position >= pData->size) || (index->used == length) ) break;
+        if( 0 != ocoms_convertor_generic_simple_position( &convertor, &position ) ) break;
+        if( convertor.stack_pos >= depth ) {
+            rc = OCOMS_ERROR;
+            break;
+        }
+        convertor.bConverted    -= convertor.partial_length;
+        convertor.partial_length = 0;
+    }
+
+    convertor.pStack     = convertor.static_stack;
+    convertor.stack_size = DT_STATIC_STACK_SIZE;
+    OBJ_DESTRUCT( &convertor );
+    free( pStack );
+
+    pData->position_index = index;
+    if( OCOMS_SUCCESS != rc ) ocoms_datatype_position_index_release( pData );
+    return rc;
+}
+
+void ocoms_convertor_position_index_seek( ocoms_convertor_t* convertor, size_t position )
+{
+    const ocoms_datatype_t* pData = convertor->pDesc;
+    const ocoms_datatype_position_index_t* index = pData->position_index;
+    const ocoms_datatype_checkpoint_t* checkpoint;
+    OCOMS_PTRDIFF_TYPE extent, disp;
+    size_t element, in_elem, target;
+    uint32_t lo, hi, mid, i;
+
+    if( (NULL == index) || (convertor->use_desc->desc != index->desc) ) return;
+    element = position / pData->size;
+    if( element >= convertor->count ) return;
+    in_elem = position - element * pData->size;
+
+    lo = 0; hi = index->used - 1;
+    while( lo < hi ) {
+        mid = (lo + hi + 1) / 2;
+        if( index->checkpoints[mid].offset <= in_elem ) lo = mid;
+        else hi = mid - 1;
+    }
+    checkpoint = &(index->checkpoints[lo]);
+    target = element * pData->size + checkpoint->offset;
+    if( (target <= convertor->bConverted) || (checkpoint->stack_pos >= convertor->stack_size) )
+        return;  /* the convertor is already closer */
+
+    DO_DEBUG( ocoms_output( 0, "position index seek from %lu to checkpoint %u at %lu for %lu\n",
+                           (unsigned long)convertor->bConverted, lo, (unsigned long)target,
+                           (unsigned long)position ); );
+    /* all the entries but the last one have absolute displacements */
+    extent = pData->ub - pData->lb;
+    disp   = (OCOMS_PTRDIFF_TYPE)element * extent;
+    memcpy( convertor->pStack, index->stacks + (size_t)lo * index->depth,
+            (checkpoint->stack_pos + 1) * sizeof(dt_stack_t) );
+    for( i = 0; i < checkpoint->stack_pos; i++ )
+        convertor->pStack[i].disp += disp;
+    convertor->pStack[0].count = convertor->count - element;
+    convertor->stack_pos       = checkpoint->stack_pos;
+    convertor->bConverted      = target;
+    convertor->partial_length  = 0;
+}
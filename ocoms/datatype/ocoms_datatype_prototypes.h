@@ -77,6 +77,22 @@ int32_t
 ocoms_generic_simple_unpack_checksum( ocoms_convertor_t* pConvertor,
                                      struct iovec* iov, uint32_t* out_size,
                                      size_t* max_data );
+int32_t
+ocoms_pack_plan( ocoms_convertor_t* pConvertor,
+                 struct iovec* iov, uint32_t* out_size,
+                 size_t* max_data );
+int32_t
+ocoms_unpack_plan( ocoms_convertor_t* pConvertor,
+                   struct iovec* iov, uint32_t* out_size,
+                   size_t* max_data );
+int32_t
+ocoms_pack_vector( ocoms_convertor_t* pConvertor,
+                   struct iovec* iov, uint32_t* out_size,
+                   size_t* max_data );
+int32_t
+ocoms_unpack_vector( ocoms_convertor_t* pConvertor,
+                     struct iovec* iov, uint32_t* out_size,
+                     size_t* max_data );
 
 END_C_DECLS
 
@@ -63,6 +63,12 @@ static inline void unpack_predefined_data( ocoms_convertor_t* CONVERTOR, /* the
         *(SOURCE)    += _copy_blength;
         _destination += _copy_blength;
     } else {
+#if OCOMS_DATATYPE_USE_STRIDED_KERNELS
+        ocoms_datatype_memcpy_strided( _destination, _elem->extent, *(SOURCE), _copy_blength,
+                                       _copy_blength, _copy_count );
+        _destination += (OCOMS_PTRDIFF_TYPE)_copy_count * _elem->extent;
+        *(SOURCE)    += (OCOMS_PTRDIFF_TYPE)_copy_count * _copy_blength;
+#else
         uint32_t _i;
         for( _i = 0; _i < _copy_count; _i++ ) {
             OCOMS_DATATYPE_SAFEGUARD_POINTER( _destination, _copy_blength, (CONVERTOR)->pBaseBuf,
@@ -73,6 +79,7 @@ static inline void unpack_predefined_data( ocoms_convertor_t* CONVERTOR, /* the
             *(SOURCE)    += _copy_blength;
             _destination += _elem->extent;
         }
+#endif  /* OCOMS_DATATYPE_USE_STRIDED_KERNELS */
         _copy_blength *= _copy_count;
     }
     (*DESTINATION)  = _destination - _elem->disp;
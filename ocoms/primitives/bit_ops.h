@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/** @file
+ *
+ * Word-level bit scanning primitives
+ *
+ * Count-trailing-zeros and population-count helpers on 32 and 64 bit
+ * words.  They map to a single instruction when the compiler provides
+ * the corresponding builtins and fall back to portable loops
+ * otherwise.  The ctz helpers are undefined for a zero argument.
+ */
+
+#ifndef OCOMS_BIT_OPS_H
+#define OCOMS_BIT_OPS_H
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stdint.h>
+
+static inline int ocoms_ctz32(uint32_t word)
+{
+#if OCOMS_C_HAVE_BUILTIN_CTZ
+    return __builtin_ctz(word);
+#else
+    int pos = 0;
+    while (!(word & 0x1)) {
+        ++pos;
+        word >>= 1;
+    }
+    return pos;
+#endif
+}
+
+static inline int ocoms_ctz64(uint64_t word)
+{
+#if OCOMS_C_HAVE_BUILTIN_CTZ
+    return __builtin_ctzll(word);
+#else
+    uint32_t low = (uint32_t) word;
+    return (0 != low) ? ocoms_ctz32(low) : 32 + ocoms_ctz32((uint32_t) (word >> 32));
+#endif
+}
+
+static inline int ocoms_popcount64(uint64_t word)
+{
+#if OCOMS_C_HAVE_BUILTIN_POPCOUNT
+    return __builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+#endif  /* OCOMS_BIT_OPS_H */
@@ -36,6 +36,27 @@
 #include <unistd.h>
 #endif  /* HAVE_UNISTD_H */
 #include "ocoms/util/crc.h"
+#include "ocoms/sys/architecture.h"
+#include "ocoms/sys/atomic.h"
+
+#if OCOMS_ASSEMBLY_ARCH == OCOMS_AMD64 && defined(__GNUC__)
+#define OCOMS_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#else
+#define OCOMS_CRC32C_SSE42 0
+#endif
+#if defined(__aarch64__) && defined(__GNUC__)
+#define OCOMS_CRC32C_ARMV8 1
+#include <arm_acle.h>
+#if defined(__linux__) && !defined(__ARM_FEATURE_CRC32)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#else
+#define OCOMS_CRC32C_ARMV8 0
+#endif
 
 
 #if (OCOMS_ALIGNMENT_LONG == 8)
@@ -1202,3 +1223,230 @@ unsigned int ocoms_uicrc_partial(
     return partial_crc;
 }
 
+
+/*
+ * CRC32C.  The hardware versions run three independent CRCs over three
+ * consecutive blocks of the buffer, to hide the latency of the crc32
+ * instruction, then combine them by shifting the first ones over the
+ * length of the following blocks with precomputed tables, as described by
+ * Mark Adler.  The copy is fused in the same loop, so the data is read
+ * only once.  The software version works a byte at a time.
+ */
+
+#define CRC32C_POLYNOMIAL  0x82f63b78  /* reflected */
+#define CRC32C_LONG        8192        /* bytes of the blocks of the large buffers */
+#define CRC32C_SHORT       256         /* bytes of the blocks of the small buffers */
+
+typedef uint32_t (*ocoms_crc32c_fn_t)( const unsigned char* src, unsigned char* dst,
+                                       size_t len, uint32_t crc );
+
+static uint32_t _ocoms_crc32c_table[256];
+static uint32_t _ocoms_crc32c_long[4][256];
+static uint32_t _ocoms_crc32c_short[4][256];
+/* set last, once the tables are filled: it also tells the init is done */
+static volatile ocoms_crc32c_fn_t _ocoms_crc32c_fn = NULL;
+
+/* multiplies the vector by the 32x32 matrix over GF(2) */
+static uint32_t crc32c_gf2_times( const uint32_t* mat, uint32_t vec )
+{
+    uint32_t sum = 0;
+
+    while( vec ) {
+        if( vec & 1 ) sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+static void crc32c_gf2_square( uint32_t* square, const uint32_t* mat )
+{
+    int n;
+
+    for( n = 0; n < 32; n++ ) square[n] = crc32c_gf2_times( mat, mat[n] );
+}
+
+/* builds the tables shifting a CRC over len zero bytes, len being a power of 2 */
+static void crc32c_zeros( uint32_t zeros[][256], size_t len )
+{
+    uint32_t odd[32], even[32], *op = even, row;
+    int n;
+
+    /* operator for 1 zero bit, squared into 2 then 4 bits */
+    odd[0] = CRC32C_POLYNOMIAL;
+    for( n = 1, row = 1; n < 32; n++, row <<= 1 ) odd[n] = row;
+    crc32c_gf2_square( even, odd );
+    crc32c_gf2_square( odd, even );
+    /* square until len bytes, the first square giving 1 byte */
+    for( ;; ) {
+        crc32c_gf2_square( even, odd );
+        len >>= 1;
+        if( 0 == len ) { op = even; break; }
+        crc32c_gf2_square( odd, even );
+        len >>= 1;
+        if( 0 == len ) { op = odd; break; }
+    }
+    for( n = 0; n < 256; n++ ) {
+        zeros[0][n] = crc32c_gf2_times( op, n );
+        zeros[1][n] = crc32c_gf2_times( op, n << 8 );
+        zeros[2][n] = crc32c_gf2_times( op, n << 16 );
+        zeros[3][n] = crc32c_gf2_times( op, (uint32_t)n << 24 );
+    }
+}
+
+static inline uint32_t crc32c_shift( uint32_t zeros[][256], uint32_t crc )
+{
+    return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+           zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+static uint32_t crc32c_sw( const unsigned char* src, unsigned char* dst,
+                           size_t len, uint32_t crc )
+{
+    crc = ~crc;
+    if( NULL != dst ) memcpy( dst, src, len );
+    while( len-- ) {
+        crc = (crc >> 8) ^ _ocoms_crc32c_table[(crc ^ *src++) & 0xff];
+    }
+    return ~crc;
+}
+
+/*
+ * The body of the hardware versions, CRC8 and CRC64 being the crc32
+ * instructions on one byte and on 8 bytes.
+ */
+#define CRC32C_HW_BLOCKS( BLOCK, ZEROS, CRC64 )                          \
+    while( len >= 3 * (BLOCK) ) {                                       \
+        const unsigned char* end = src + (BLOCK);                       \
+        uint64_t crc1 = 0, crc2 = 0, w0, w1, w2;                        \
+        do {                                                            \
+            memcpy( &w0, src, 8 );                                      \
+            memcpy( &w1, src + (BLOCK), 8 );                            \
+            memcpy( &w2, src + 2 * (BLOCK), 8 );                        \
+            if( NULL != dst ) {                                         \
+                memcpy( dst, &w0, 8 );                                  \
+                memcpy( dst + (BLOCK), &w1, 8 );                        \
+                memcpy( dst + 2 * (BLOCK), &w2, 8 );                    \
+                dst += 8;                                               \
+            }                                                           \
+            crc0 = CRC64( crc0, w0 );                                   \
+            crc1 = CRC64( crc1, w1 );                                   \
+            crc2 = CRC64( crc2, w2 );                                   \
+            src += 8;                                                   \
+        } while( src < end );                                           \
+        crc0 = crc32c_shift( (ZEROS), (uint32_t)crc0 ) ^ crc1;          \
+        crc0 = crc32c_shift( (ZEROS), (uint32_t)crc0 ) ^ crc2;          \
+        src += 2 * (BLOCK);                                             \
+        if( NULL != dst ) dst += 2 * (BLOCK);                           \
+        len -= 3 * (BLOCK);                                             \
+    }
+
+#define CRC32C_HW_BODY( CRC8, CRC64 )                                    \
+    uint64_t crc0 = (uint32_t)~crc, w;                                  \
+                                                                        \
+    while( (0 != len) && (0 != ((uintptr_t)src & 7)) ) {                \
+        if( NULL != dst ) *dst++ = *src;                                \
+        crc0 = CRC8( (uint32_t)crc0, *src++ );                          \
+        len--;                                                          \
+    }                                                                   \
+    CRC32C_HW_BLOCKS( CRC32C_LONG, _ocoms_crc32c_long, CRC64 );         \
+    CRC32C_HW_BLOCKS( CRC32C_SHORT, _ocoms_crc32c_short, CRC64 );       \
+    while( len >= 8 ) {                                                 \
+        memcpy( &w, src, 8 );                                           \
+        if( NULL != dst ) {                                             \
+            memcpy( dst, &w, 8 );                                       \
+            dst += 8;                                                   \
+        }                                                               \
+        crc0 = CRC64( crc0, w );                                        \
+        src += 8;                                                       \
+        len -= 8;                                                       \
+    }                                                                   \
+    while( 0 != len ) {                                                 \
+        if( NULL != dst ) *dst++ = *src;                                \
+        crc0 = CRC8( (uint32_t)crc0, *src++ );                          \
+        len--;                                                          \
+    }                                                                   \
+    return ~(uint32_t)crc0;
+
+#if OCOMS_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42( const unsigned char* src, unsigned char* dst,
+                              size_t len, uint32_t crc )
+{
+    CRC32C_HW_BODY( _mm_crc32_u8, _mm_crc32_u64 )
+}
+#endif  /* OCOMS_CRC32C_SSE42 */
+
+#if OCOMS_CRC32C_ARMV8
+#define CRC32C_ARMV8_64( CRC, W )  ((uint64_t)__crc32cd( (uint32_t)(CRC), (W) ))
+
+__attribute__((target("+crc")))
+static uint32_t crc32c_armv8( const unsigned char* src, unsigned char* dst,
+                              size_t len, uint32_t crc )
+{
+    CRC32C_HW_BODY( __crc32cb, CRC32C_ARMV8_64 )
+}
+#endif  /* OCOMS_CRC32C_ARMV8 */
+
+static ocoms_crc32c_fn_t ocoms_initialize_crc32c(void)
+{
+    ocoms_crc32c_fn_t fn;
+    uint32_t crc;
+    int i, j;
+
+    for( i = 0; i < 256; i++ ) {
+        crc = i;
+        for( j = 0; j < 8; j++ )
+            crc = (crc & 1) ? ((crc >> 1) ^ CRC32C_POLYNOMIAL) : (crc >> 1);
+        _ocoms_crc32c_table[i] = crc;
+    }
+    crc32c_zeros( _ocoms_crc32c_long, CRC32C_LONG );
+    crc32c_zeros( _ocoms_crc32c_short, CRC32C_SHORT );
+
+    fn = crc32c_sw;
+#if OCOMS_CRC32C_SSE42
+    if( __builtin_cpu_supports("sse4.2") ) fn = crc32c_sse42;
+#endif
+#if OCOMS_CRC32C_ARMV8
+#if defined(__ARM_FEATURE_CRC32)
+    fn = crc32c_armv8;
+#elif defined(__linux__)
+    if( getauxval(AT_HWCAP) & HWCAP_CRC32 ) fn = crc32c_armv8;
+#endif
+#endif  /* OCOMS_CRC32C_ARMV8 */
+
+    /* the tables must be visible before the function using them */
+    ocoms_atomic_wmb();
+    _ocoms_crc32c_fn = fn;
+    return fn;
+}
+
+uint32_t ocoms_bcopy_crc32c_partial(
+    const void *  source,
+    void *  destination,
+    size_t copylen,
+    uint32_t partial_crc)
+{
+    ocoms_crc32c_fn_t fn = _ocoms_crc32c_fn;
+
+    if (NULL == fn) {
+        fn = ocoms_initialize_crc32c();
+    } else {
+        ocoms_atomic_rmb();
+    }
+    return fn( (const unsigned char*)source, (unsigned char*)destination,
+               copylen, partial_crc );
+}
+
+uint32_t ocoms_crc32c_partial(
+    const void *  source, size_t crclen, uint32_t partial_crc)
+{
+    ocoms_crc32c_fn_t fn = _ocoms_crc32c_fn;
+
+    if (NULL == fn) {
+        fn = ocoms_initialize_crc32c();
+    } else {
+        ocoms_atomic_rmb();
+    }
+    return fn( (const unsigned char*)source, NULL, crclen, partial_crc );
+}
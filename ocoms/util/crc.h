@@ -40,6 +40,10 @@ BEGIN_C_DECLS
 #define OCOMS_CSUM_BCOPY_PARTIAL( SRC, DST, LEN1, LEN2, UI1, UI2 ) \
     ocoms_bcopy_uicsum_partial( SRC, DST, LEN1, LEN2, UI1, UI2 )
 #define OCOMS_CSUM_ZERO  0
+#define OCOMS_CRC32C_PARTIAL( SRC, LEN, CRC ) \
+    ocoms_crc32c_partial( SRC, LEN, CRC )
+#define OCOMS_CRC32C_BCOPY_PARTIAL( SRC, DST, LEN, CRC ) \
+    ocoms_bcopy_crc32c_partial( SRC, DST, LEN, CRC )
 
 
 OCOMS_DECLSPEC unsigned long
@@ -180,6 +184,32 @@ ocoms_uicrc(const void *  source, size_t crclen)
     return ocoms_uicrc_partial(source, crclen, CRC_INITIAL_REGISTER);
 }
                                                                                                                   
+/*
+ * CRC32C (Castagnoli polynomial) support, with the SSE4.2 or ARMv8 CRC
+ * instructions when the processor has them.  A buffer can be processed
+ * in pieces by passing the value of the previous piece as partial_crc,
+ * starting from 0.
+ */
+
+OCOMS_DECLSPEC uint32_t
+ocoms_bcopy_crc32c_partial(
+    const void *  source,
+    void *  destination,
+    size_t copylen,
+    uint32_t partial_crc);
+
+OCOMS_DECLSPEC uint32_t
+ocoms_crc32c_partial(
+    const void *  source,
+    size_t crclen,
+    uint32_t partial_crc);
+
+static inline uint32_t
+ocoms_crc32c(const void *  source, size_t crclen)
+{
+    return ocoms_crc32c_partial(source, crclen, 0);
+}
+
 END_C_DECLS
 
 #endif
@@ -25,9 +25,12 @@
 
 #include "ocoms/platform/ocoms_constants.h"
 #include "ocoms/util/ocoms_bitmap.h"
+#include "ocoms/primitives/bit_ops.h"
+#include "ocoms/sys/atomic.h"
 
 
-#define SIZE_OF_CHAR ((int) (sizeof(char) * 8))
+#define SIZE_OF_BASE_TYPE 64
+#define ALL_ONES (~((uint64_t) 0))
 
 static void ocoms_bitmap_construct(ocoms_bitmap_t *bm);
 static void ocoms_bitmap_destruct(ocoms_bitmap_t *bm);
@@ -42,6 +45,8 @@ ocoms_bitmap_construct(ocoms_bitmap_t *bm)
     bm->bitmap = NULL;
     bm->array_size = 0;
     bm->max_size = INT_MAX;
+    bm->summary = NULL;
+    bm->top_summary = NULL;
 }
 
 
@@ -51,6 +56,226 @@ ocoms_bitmap_destruct(ocoms_bitmap_t *bm)
     if (NULL != bm->bitmap) {
         free(bm->bitmap);
     }
+    if (NULL != bm->summary) {
+        free(bm->summary);
+    }
+    if (NULL != bm->top_summary) {
+        free(bm->top_summary);
+    }
+}
+
+
+/*
+ * Compute one summary level from the level below: bit i is set when
+ * word i below is full.  Bits past the end of the level below are set
+ * as well, so that searches never stop on them.
+ */
+static void
+ocoms_bitmap_summarize(uint64_t *summary, int summary_size,
+                       const uint64_t *below, int below_size)
+{
+    int i;
+
+    for (i = 0; i < summary_size; ++i) {
+        summary[i] = 0;
+    }
+    for (i = 0; i < below_size; ++i) {
+        if (ALL_ONES == below[i]) {
+            summary[i / SIZE_OF_BASE_TYPE] |= 1ULL << (i % SIZE_OF_BASE_TYPE);
+        }
+    }
+    if (0 != below_size % SIZE_OF_BASE_TYPE) {
+        summary[summary_size - 1] |= ALL_ONES << (below_size % SIZE_OF_BASE_TYPE);
+    }
+}
+
+
+/*
+ * (Re)allocate both summary levels for a bitmap of array_size words.
+ * Called before array_size is updated, so that a failure leaves the
+ * bitmap consistent with its old size.
+ */
+static int
+ocoms_bitmap_size_summary(ocoms_bitmap_t *bm, int array_size)
+{
+    int summary_size = (array_size + SIZE_OF_BASE_TYPE - 1) / SIZE_OF_BASE_TYPE;
+    int top_size = (summary_size + SIZE_OF_BASE_TYPE - 1) / SIZE_OF_BASE_TYPE;
+    uint64_t *summary, *top_summary;
+
+    /* an empty map keeps its arrays, realloc may return NULL for 0 bytes */
+    if (0 == summary_size) {
+        return OCOMS_SUCCESS;
+    }
+    summary = (uint64_t *) realloc(bm->summary, summary_size * sizeof(uint64_t));
+    if (NULL == summary) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    bm->summary = summary;
+    top_summary = (uint64_t *) realloc(bm->top_summary, top_size * sizeof(uint64_t));
+    if (NULL == top_summary) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    bm->top_summary = top_summary;
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * Recompute both summary levels from scratch, the arrays being already
+ * sized for the current size of the bitmap.
+ */
+static void
+ocoms_bitmap_summarize_all(ocoms_bitmap_t *bm)
+{
+    int summary_size = (bm->array_size + SIZE_OF_BASE_TYPE - 1) / SIZE_OF_BASE_TYPE;
+    int top_size = (summary_size + SIZE_OF_BASE_TYPE - 1) / SIZE_OF_BASE_TYPE;
+
+    ocoms_bitmap_summarize(bm->summary, summary_size, bm->bitmap, bm->array_size);
+    ocoms_bitmap_summarize(bm->top_summary, top_size, bm->summary, summary_size);
+}
+
+
+/*
+ * Recompute both summary levels from scratch, (re)allocating them to
+ * match the current size of the bitmap.  Used after the whole-map
+ * operations.
+ */
+static int
+ocoms_bitmap_rebuild_summary(ocoms_bitmap_t *bm)
+{
+    int rc = ocoms_bitmap_size_summary(bm, bm->array_size);
+
+    if (OCOMS_SUCCESS != rc) {
+        return rc;
+    }
+    ocoms_bitmap_summarize_all(bm);
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * Non-atomic summary maintenance after word index has been updated.
+ */
+static inline void
+ocoms_bitmap_word_filled(ocoms_bitmap_t *bm, int index)
+{
+    int s = index / SIZE_OF_BASE_TYPE;
+
+    if (ALL_ONES == bm->bitmap[index]) {
+        bm->summary[s] |= 1ULL << (index % SIZE_OF_BASE_TYPE);
+        if (ALL_ONES == bm->summary[s]) {
+            bm->top_summary[s / SIZE_OF_BASE_TYPE] |= 1ULL << (s % SIZE_OF_BASE_TYPE);
+        }
+    }
+}
+
+static inline void
+ocoms_bitmap_word_emptied(ocoms_bitmap_t *bm, int index)
+{
+    int s = index / SIZE_OF_BASE_TYPE;
+
+    bm->summary[s] &= ~(1ULL << (index % SIZE_OF_BASE_TYPE));
+    bm->top_summary[s / SIZE_OF_BASE_TYPE] &= ~(1ULL << (s % SIZE_OF_BASE_TYPE));
+}
+
+
+/*
+ * Grow the bitmap to at least new_size words, zeroing the new words.
+ */
+static int
+ocoms_bitmap_grow(ocoms_bitmap_t *bm, int new_size)
+{
+    uint64_t *bitmap;
+    int rc;
+
+    if (new_size > bm->max_size) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+    rc = ocoms_bitmap_size_summary(bm, new_size);
+    if (OCOMS_SUCCESS != rc) {
+        return rc;
+    }
+    bitmap = (uint64_t *) realloc(bm->bitmap, new_size * sizeof(uint64_t));
+    if (NULL == bitmap) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    bm->bitmap = bitmap;
+
+    /* zero out the new elements */
+    memset(&bm->bitmap[bm->array_size], 0,
+           (new_size - bm->array_size) * sizeof(uint64_t));
+
+    /* Update the array_size */
+    bm->array_size = new_size;
+    ocoms_bitmap_summarize_all(bm);
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * Compare-and-swap on a bitmap word.  When the platform has no 64 bit
+ * compare-and-swap, operate on the 32 bit half of the word holding
+ * the bit instead.
+ */
+static inline bool
+ocoms_bitmap_word_cmpset(uint64_t *word, int offset, uint64_t oldval, uint64_t newval)
+{
+#if OCOMS_ENABLE_MULTI_THREADS
+#if OCOMS_HAVE_ATOMIC_CMPSET_64
+    (void) offset;
+    return 0 != ocoms_atomic_cmpset_64((volatile int64_t *) word,
+                                       (int64_t) oldval, (int64_t) newval);
+#else
+    int shift = (offset < 32) ? 0 : 32;
+#if defined(WORDS_BIGENDIAN)
+    volatile int32_t *half = (volatile int32_t *) word + (0 == shift);
+#else
+    volatile int32_t *half = (volatile int32_t *) word + (0 != shift);
+#endif
+    return 0 != ocoms_atomic_cmpset_32(half, (int32_t) (uint32_t) (oldval >> shift),
+                                       (int32_t) (uint32_t) (newval >> shift));
+#endif  /* OCOMS_HAVE_ATOMIC_CMPSET_64 */
+#else
+    (void) offset;
+    (void) oldval;
+    *word = newval;
+    return true;
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+}
+
+
+/*
+ * Make the summary bit at offset in *summary reflect whether *below
+ * is full.  Concurrent updaters may race on the summary bit, so the
+ * word below is checked again after the update: whoever writes the
+ * summary bit last also sees the final state of the word below, which
+ * keeps the summary exact once all the updates have completed.
+ */
+static void
+ocoms_bitmap_sync_summary_bit(uint64_t *summary, int offset, uint64_t *below)
+{
+    uint64_t mask = 1ULL << offset, oldval, newval;
+    bool full;
+
+    do {
+        full = (ALL_ONES == *(volatile uint64_t *) below);
+        do {
+            oldval = *(volatile uint64_t *) summary;
+            newval = full ? (oldval | mask) : (oldval & ~mask);
+        } while (oldval != newval &&
+                 !ocoms_bitmap_word_cmpset(summary, offset, oldval, newval));
+    } while (full != (ALL_ONES == *(volatile uint64_t *) below));
+}
+
+static void
+ocoms_bitmap_sync_summary(ocoms_bitmap_t *bm, int index)
+{
+    int s = index / SIZE_OF_BASE_TYPE;
+
+    ocoms_bitmap_sync_summary_bit(&bm->summary[s], index % SIZE_OF_BASE_TYPE,
+                                  &bm->bitmap[index]);
+    ocoms_bitmap_sync_summary_bit(&bm->top_summary[s / SIZE_OF_BASE_TYPE],
+                                  s % SIZE_OF_BASE_TYPE, &bm->summary[s]);
 }
 
 
@@ -67,8 +292,8 @@ int ocoms_bitmap_set_max_size (ocoms_bitmap_t *bm, int max_size)
      * we set it (in numbers of bits!), otherwise it is
      * set to INT_MAX in the constructor.
      */
-    actual_size = max_size / SIZE_OF_CHAR;
-    actual_size += (max_size % SIZE_OF_CHAR == 0) ? 0 : 1;
+    actual_size = max_size / SIZE_OF_BASE_TYPE;
+    actual_size += (max_size % SIZE_OF_BASE_TYPE == 0) ? 0 : 1;
 
     bm->max_size = actual_size;
 
@@ -86,14 +311,17 @@ ocoms_bitmap_init(ocoms_bitmap_t *bm, int size)
      * we test here (in numbers of bits!)
      * By default, the max size is INT_MAX, set in the constructor.
      */
-    if ((size <= 0) || (NULL == bm) || (size > bm->max_size)) {
+    if ((size <= 0) || (NULL == bm)) {
         return OCOMS_ERR_BAD_PARAM;
     }
     
-    actual_size = size / SIZE_OF_CHAR;
-    actual_size += (size % SIZE_OF_CHAR == 0) ? 0 : 1;
+    actual_size = size / SIZE_OF_BASE_TYPE;
+    actual_size += (size % SIZE_OF_BASE_TYPE == 0) ? 0 : 1;
+    if (actual_size > bm->max_size) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
     bm->array_size = actual_size;
-    bm->bitmap = (unsigned char *) malloc(actual_size);
+    bm->bitmap = (uint64_t *) malloc(actual_size * sizeof(uint64_t));
     if (NULL == bm->bitmap) {
         return OCOMS_ERR_OUT_OF_RESOURCE;
     }
@@ -102,60 +330,45 @@ ocoms_bitmap_init(ocoms_bitmap_t *bm, int size)
      * Leave bm->max_size untouched: it is initialized to INT_MAX in the constructor
      */
 
-    ocoms_bitmap_clear_all_bits(bm);
-    return OCOMS_SUCCESS;
+    return ocoms_bitmap_clear_all_bits(bm);
 }
 
 
 int
 ocoms_bitmap_set_bit(ocoms_bitmap_t *bm, int bit)
 {
-    int index, offset, new_size;
-    size_t new_size_large;
+    int index, offset, rc;
     
-    if ((bit < 0) || (NULL == bm) || (bit > bm->max_size)) {
+    if ((bit < 0) || (NULL == bm) || (bit / SIZE_OF_BASE_TYPE >= bm->max_size)) {
         return OCOMS_ERR_BAD_PARAM;
     }
     
-    index = bit / SIZE_OF_CHAR; 
-    offset = bit % SIZE_OF_CHAR;
+    index = bit / SIZE_OF_BASE_TYPE; 
+    offset = bit % SIZE_OF_BASE_TYPE;
     
     if (index >= bm->array_size) {
         
         /* We need to allocate more space for the bitmap, since we are
          out of range. We don't throw any error here, because this is
-         valid and we simply expand the bitmap */
-        
-        new_size_large = (index / bm->array_size + 1 ) * bm->array_size;
-        
-        /* Note that new_size is guaranteed to be <=
-         INT_MAX, which is guaranteed to fit in a
-         [signed] int. */
+         valid and we simply expand the bitmap. New size is just a
+         multiple of the original size to fit in the index (capped at
+         max_size, which we validated above contains the bit). */
         
-        new_size = (int) new_size_large;
+        size_t new_size_large = (0 == bm->array_size) ? (size_t) index + 1 :
+            ((size_t) index / bm->array_size + 1) * bm->array_size;
+        if (new_size_large > (size_t) bm->max_size) {
+            new_size_large = bm->max_size;
+        }
 
-        /*
-         * No further tests against max_size (or OCOMS_FORTRAN_HANDLE_MAX) are
-         * necessary, since we validated above, that the bit already is contained!
-         */
-        
-        /* New size is just a multiple of the original size to fit in
-         the index. */
-        
-        bm->bitmap = (unsigned char *) realloc(bm->bitmap, (int) new_size);
-        if (NULL == bm->bitmap) {
-            return OCOMS_ERR_OUT_OF_RESOURCE;
+        rc = ocoms_bitmap_grow(bm, (int) new_size_large);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
         }
-        
-        /* zero out the new elements */
-        memset(&bm->bitmap[bm->array_size], 0, new_size - bm->array_size);
-        
-        /* Update the array_size */
-        bm->array_size = new_size;
     }
     
     /* Now set the bit */
-    bm->bitmap[index] |= (1 << offset);
+    bm->bitmap[index] |= (1ULL << offset);
+    ocoms_bitmap_word_filled(bm, index);
     
     return OCOMS_SUCCESS;
 }
@@ -166,18 +379,15 @@ ocoms_bitmap_clear_bit(ocoms_bitmap_t *bm, int bit)
 {
     int index, offset;
     
-    if ((bit < 0) || NULL == bm || (bit >= (bm->array_size * SIZE_OF_CHAR))) {
+    if ((bit < 0) || NULL == bm || (bit / SIZE_OF_BASE_TYPE >= bm->array_size)) {
         return OCOMS_ERR_BAD_PARAM;
     }
     
-    index = bit / SIZE_OF_CHAR; 
-    offset = bit % SIZE_OF_CHAR;
+    index = bit / SIZE_OF_BASE_TYPE; 
+    offset = bit % SIZE_OF_BASE_TYPE;
     
-    if (index >= bm->array_size) {
-        return OCOMS_ERR_BAD_PARAM;
-    }
-    
-    bm->bitmap[index] &= ~(1 << offset);
+    bm->bitmap[index] &= ~(1ULL << offset);
+    ocoms_bitmap_word_emptied(bm, index);
     return OCOMS_SUCCESS;
 }
 
@@ -187,18 +397,14 @@ ocoms_bitmap_is_set_bit(ocoms_bitmap_t *bm, int bit)
 {
     int index, offset;
     
-    if ((bit < 0) || NULL == bm || (bit >= (bm->array_size * SIZE_OF_CHAR))) {
+    if ((bit < 0) || NULL == bm || (bit / SIZE_OF_BASE_TYPE >= bm->array_size)) {
         return false;
     }
     
-    index = bit / SIZE_OF_CHAR; 
-    offset = bit % SIZE_OF_CHAR;
-    
-    if (index >= bm->array_size) {
-        return false;
-    }
+    index = bit / SIZE_OF_BASE_TYPE; 
+    offset = bit % SIZE_OF_BASE_TYPE;
     
-    if (0 != (bm->bitmap[index] & (1 << offset))) {
+    if (0 != (bm->bitmap[index] & (1ULL << offset))) {
         return true;
     }
     
@@ -206,6 +412,60 @@ ocoms_bitmap_is_set_bit(ocoms_bitmap_t *bm, int bit)
 }
 
 
+int
+ocoms_bitmap_atomic_set_bit(ocoms_bitmap_t *bm, int bit)
+{
+    uint64_t *word, mask, oldval;
+    int offset;
+
+    if ((bit < 0) || NULL == bm || (bit / SIZE_OF_BASE_TYPE >= bm->array_size)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+
+    word = &bm->bitmap[bit / SIZE_OF_BASE_TYPE];
+    offset = bit % SIZE_OF_BASE_TYPE;
+    mask = 1ULL << offset;
+    do {
+        oldval = *(volatile uint64_t *) word;
+        if (oldval & mask) {
+            return OCOMS_EXISTS;
+        }
+    } while (!ocoms_bitmap_word_cmpset(word, offset, oldval, oldval | mask));
+
+    if (ALL_ONES == (oldval | mask)) {
+        ocoms_bitmap_sync_summary(bm, bit / SIZE_OF_BASE_TYPE);
+    }
+    return OCOMS_SUCCESS;
+}
+
+
+int
+ocoms_bitmap_atomic_clear_bit(ocoms_bitmap_t *bm, int bit)
+{
+    uint64_t *word, mask, oldval;
+    int offset;
+
+    if ((bit < 0) || NULL == bm || (bit / SIZE_OF_BASE_TYPE >= bm->array_size)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+
+    word = &bm->bitmap[bit / SIZE_OF_BASE_TYPE];
+    offset = bit % SIZE_OF_BASE_TYPE;
+    mask = 1ULL << offset;
+    do {
+        oldval = *(volatile uint64_t *) word;
+        if (!(oldval & mask)) {
+            return OCOMS_ERR_NOT_FOUND;
+        }
+    } while (!ocoms_bitmap_word_cmpset(word, offset, oldval, oldval & ~mask));
+
+    if (ALL_ONES == oldval) {
+        ocoms_bitmap_sync_summary(bm, bit / SIZE_OF_BASE_TYPE);
+    }
+    return OCOMS_SUCCESS;
+}
+
+
 int
 ocoms_bitmap_clear_all_bits(ocoms_bitmap_t *bm)
 {
@@ -213,8 +473,8 @@ ocoms_bitmap_clear_all_bits(ocoms_bitmap_t *bm)
         return OCOMS_ERR_BAD_PARAM;
     }
     
-    memset(bm->bitmap, 0, bm->array_size);
-    return OCOMS_SUCCESS;
+    memset(bm->bitmap, 0, bm->array_size * sizeof(uint64_t));
+    return ocoms_bitmap_rebuild_summary(bm);
 }
 
 
@@ -225,46 +485,186 @@ ocoms_bitmap_set_all_bits(ocoms_bitmap_t *bm)
         return OCOMS_ERR_BAD_PARAM;
     }
     
-    memset(bm->bitmap, 0xff, bm->array_size);
+    memset(bm->bitmap, 0xff, bm->array_size * sizeof(uint64_t));
     
-    return OCOMS_SUCCESS;
+    return ocoms_bitmap_rebuild_summary(bm);
 }
 
 
 int
 ocoms_bitmap_find_and_set_first_unset_bit(ocoms_bitmap_t *bm, int *position)
 {
-    int i = 0;
-    unsigned char temp;
-    unsigned char all_ones = 0xff;
+    int i = 0, top_size, s, index;
+    uint64_t temp;
     
     if (NULL == bm) {
         return OCOMS_ERR_BAD_PARAM;
     }
     
-    /* Neglect all which don't have an unset bit */
+    /* Neglect all the groups of 64 words which don't have an unset bit */
     *position = 0;
-    while((i < bm->array_size) && (bm->bitmap[i] == all_ones)) {
+    top_size = (bm->array_size + SIZE_OF_BASE_TYPE * SIZE_OF_BASE_TYPE - 1) /
+        (SIZE_OF_BASE_TYPE * SIZE_OF_BASE_TYPE);
+    while((i < top_size) && (bm->top_summary[i] == ALL_ONES)) {
         ++i;
     }
     
-    if (i == bm->array_size) {
+    if (i == top_size) {
         /* increase the bitmap size then */
-        *position = bm->array_size * SIZE_OF_CHAR;
+        *position = bm->array_size * SIZE_OF_BASE_TYPE;
         return ocoms_bitmap_set_bit(bm, *position);
     }
     
-    /* This one has an unset bit, find its bit number */
-    
-    temp = bm->bitmap[i];
-    while (temp & 0x1) {
-        ++(*position);
-        temp >>= 1;
-    }
-    
+    /* Walk down the summaries to a word which has an unset bit */
+    s = i * SIZE_OF_BASE_TYPE + ocoms_ctz64(~bm->top_summary[i]);
+    index = s * SIZE_OF_BASE_TYPE + ocoms_ctz64(~bm->summary[s]);
+
+    /* and find its bit number */
+    temp = bm->bitmap[index];
+    *position = index * SIZE_OF_BASE_TYPE + ocoms_ctz64(~temp);
+
     /* Now set the bit number */
-    bm->bitmap[i] |= (bm->bitmap[i] + 1);
+    bm->bitmap[index] = temp | (temp + 1);
+    ocoms_bitmap_word_filled(bm, index);
     
-    (*position) += i * SIZE_OF_CHAR;
+    return OCOMS_SUCCESS;
+}
+
+
+int
+ocoms_bitmap_find_next_set_bit(ocoms_bitmap_t *bm, int start, int *position)
+{
+    int i;
+    uint64_t temp;
+
+    if ((start < 0) || (NULL == bm)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+
+    i = start / SIZE_OF_BASE_TYPE;
+    if (i >= bm->array_size) {
+        return OCOMS_ERR_NOT_FOUND;
+    }
+
+    /* mask off the bits below start in the first word */
+    temp = bm->bitmap[i] & (ALL_ONES << (start % SIZE_OF_BASE_TYPE));
+    while (0 == temp) {
+        if (++i == bm->array_size) {
+            return OCOMS_ERR_NOT_FOUND;
+        }
+        temp = bm->bitmap[i];
+    }
+
+    *position = i * SIZE_OF_BASE_TYPE + ocoms_ctz64(temp);
+    return OCOMS_SUCCESS;
+}
+
+
+int
+ocoms_bitmap_popcount(ocoms_bitmap_t *bm)
+{
+    int i, count = 0;
+
+    if (NULL == bm) {
+        return 0;
+    }
+
+    for (i = 0; i < bm->array_size; ++i) {
+        count += ocoms_popcount64(bm->bitmap[i]);
+    }
+    return count;
+}
+
+
+int
+ocoms_bitmap_bitwise_and_inplace(ocoms_bitmap_t *dest, ocoms_bitmap_t *src)
+{
+    int i, common;
+
+    if ((NULL == dest) || (NULL == src)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+
+    common = (dest->array_size < src->array_size) ? dest->array_size : src->array_size;
+    for (i = 0; i < common; ++i) {
+        dest->bitmap[i] &= src->bitmap[i];
+    }
+    for (; i < dest->array_size; ++i) {
+        dest->bitmap[i] = 0;
+    }
+    return ocoms_bitmap_rebuild_summary(dest);
+}
+
+
+int
+ocoms_bitmap_bitwise_or_inplace(ocoms_bitmap_t *dest, ocoms_bitmap_t *src)
+{
+    int i, rc;
+
+    if ((NULL == dest) || (NULL == src)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+
+    if (dest->array_size < src->array_size) {
+        rc = ocoms_bitmap_grow(dest, src->array_size);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+    }
+    for (i = 0; i < src->array_size; ++i) {
+        dest->bitmap[i] |= src->bitmap[i];
+    }
+    return ocoms_bitmap_rebuild_summary(dest);
+}
+
+
+int
+ocoms_bitmap_bitwise_xor_inplace(ocoms_bitmap_t *dest, ocoms_bitmap_t *src)
+{
+    int i, rc;
+
+    if ((NULL == dest) || (NULL == src)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+
+    if (dest->array_size < src->array_size) {
+        rc = ocoms_bitmap_grow(dest, src->array_size);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+    }
+    for (i = 0; i < src->array_size; ++i) {
+        dest->bitmap[i] ^= src->bitmap[i];
+    }
+    return ocoms_bitmap_rebuild_summary(dest);
+}
+
+
+int
+ocoms_bitmap_copy(ocoms_bitmap_t *dest, ocoms_bitmap_t *src)
+{
+    uint64_t *bitmap;
+    int rc;
+
+    /*
+     * Only grow the arrays: growing keeps dest valid for its old size
+     * whichever allocation fails, and a smaller copy fits in them.
+     */
+    if (dest->array_size < src->array_size) {
+        bitmap = (uint64_t *) realloc(dest->bitmap, src->array_size * sizeof(uint64_t));
+        if (NULL == bitmap) {
+            return OCOMS_ERR_OUT_OF_RESOURCE;
+        }
+        dest->bitmap = bitmap;
+        rc = ocoms_bitmap_size_summary(dest, src->array_size);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+    }
+    if (0 != src->array_size) {
+        memcpy(dest->bitmap, src->bitmap, src->array_size * sizeof(uint64_t));
+    }
+    dest->array_size = src->array_size;
+    ocoms_bitmap_summarize_all(dest);
     return OCOMS_SUCCESS;
 }
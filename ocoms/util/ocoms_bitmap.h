@@ -38,6 +38,24 @@
  *  OCOMS_FORTRAN_HANDLE_MAX, which is min(INT_MAX, fortran INTEGER max).
  *  Currently the only user of this is ompi/attribute/attribute.c
  *
+ *  The bits are stored in 64 bit words, so that searches, population
+ *  counts and the whole-map operations (and / or / xor) process 64
+ *  bits per step using count-trailing-zeros and popcount instructions
+ *  where available; the whole-map loops are simple enough for the
+ *  compiler to vectorize.
+ *
+ *  Two summary levels are kept on top of the bitmap: a bit per
+ *  bitmap word, set when that word is full, and a bit per summary
+ *  word, set when that summary word is full.  Finding the first unset
+ *  bit therefore costs three count-trailing-zeros steps for bitmaps of
+ *  up to 2^18 bits, instead of a scan over the whole bitmap.
+ *
+ *  The bitmap is not thread safe, with the exception of
+ *  ocoms_bitmap_atomic_set_bit and ocoms_bitmap_atomic_clear_bit,
+ *  which may be used concurrently with each other and with
+ *  ocoms_bitmap_is_set_bit on bits within the current size (they
+ *  never expand the bitmap).
+ *
  */
 
 #ifndef OCOMS_BITMAP_H
@@ -53,9 +71,11 @@ BEGIN_C_DECLS
 
 struct ocoms_bitmap_t {
     ocoms_object_t super;   /**< Subclass of ocoms_object_t */
-    unsigned char *bitmap; /**< The actual bitmap array of characters */
-    int array_size;        /**< The actual array size that maintains the bitmap */
-    int max_size;          /**< The maximum size that this bitmap may grow (optional) */
+    uint64_t *bitmap;      /**< The actual bitmap array of 64 bit words */
+    int array_size;        /**< The actual array size (in words) that maintains the bitmap */
+    int max_size;          /**< The maximum size (in words) that this bitmap may grow (optional) */
+    uint64_t *summary;     /**< One bit per bitmap word, set when the word is full */
+    uint64_t *top_summary; /**< One bit per summary word, set when the summary word is full */
 };
 
 typedef struct ocoms_bitmap_t ocoms_bitmap_t;
@@ -125,6 +145,33 @@ OCOMS_DECLSPEC int ocoms_bitmap_clear_bit(ocoms_bitmap_t *bm, int bit);
 OCOMS_DECLSPEC bool ocoms_bitmap_is_set_bit(ocoms_bitmap_t *bm, int bit);
 
 
+/**
+ * Atomically set a bit of the bitmap. Unlike ocoms_bitmap_set_bit the
+ * bitmap is never extended.
+ *
+ * @param  bitmap The input bitmap (IN)
+ * @param  bit    The bit which is to be set (IN)
+ * @return OCOMS_SUCCESS if this call changed the bit from 0 to 1,
+ *         OCOMS_EXISTS if the bit was already set,
+ *         OCOMS_ERR_BAD_PARAM if the bit is out of range
+ *
+ */
+OCOMS_DECLSPEC int ocoms_bitmap_atomic_set_bit(ocoms_bitmap_t *bm, int bit);
+
+
+/**
+ * Atomically clear a bit of the bitmap.
+ *
+ * @param  bitmap The input bitmap (IN)
+ * @param  bit    The bit which is to be cleared (IN)
+ * @return OCOMS_SUCCESS if this call changed the bit from 1 to 0,
+ *         OCOMS_ERR_NOT_FOUND if the bit was already clear,
+ *         OCOMS_ERR_BAD_PARAM if the bit is out of range
+ *
+ */
+OCOMS_DECLSPEC int ocoms_bitmap_atomic_clear_bit(ocoms_bitmap_t *bm, int bit);
+
+
 /**
  * Find the first clear bit in the bitmap and set it
  *
@@ -137,6 +184,27 @@ OCOMS_DECLSPEC int ocoms_bitmap_find_and_set_first_unset_bit(ocoms_bitmap_t *bm,
                                                            int *position); 
 
 
+/**
+ * Find the first set bit at or after a given position
+ *
+ * @param  bitmap     The input bitmap (IN)
+ * @param  start      First bit to consider (IN)
+ * @param  position   Position of the set bit (OUT)
+ * @return OCOMS_SUCCESS if a set bit was found,
+ *         OCOMS_ERR_NOT_FOUND if there is no set bit at or after start
+ *
+ * Iterating over all the set bits of a bitmap:
+ *
+ * for (rc = ocoms_bitmap_find_next_set_bit(bm, 0, &pos);
+ *      OCOMS_SUCCESS == rc;
+ *      rc = ocoms_bitmap_find_next_set_bit(bm, pos + 1, &pos)) {
+ *    do something with pos;
+ * }
+ */
+OCOMS_DECLSPEC int ocoms_bitmap_find_next_set_bit(ocoms_bitmap_t *bm, int start,
+                                                  int *position);
+
+
 /**
  * Clear all bits in the bitmap
  *
@@ -156,6 +224,32 @@ OCOMS_DECLSPEC int ocoms_bitmap_clear_all_bits(ocoms_bitmap_t *bm);
 OCOMS_DECLSPEC int ocoms_bitmap_set_all_bits(ocoms_bitmap_t *bm);
 
 
+/**
+ * Count the set bits in the bitmap
+ *
+ * @param bitmap The input bitmap (IN)
+ * @return Number of bits set, 0 if bm is NULL
+ *
+ */
+OCOMS_DECLSPEC int ocoms_bitmap_popcount(ocoms_bitmap_t *bm);
+
+
+/**
+ * Bitwise operations between two bitmaps: dest = dest OP src
+ *
+ * Bits beyond the size of src are taken as 0.  With or and xor the
+ * destination is extended to the size of src if it is smaller.
+ *
+ * @param dest The destination bitmap (IN/OUT)
+ * @param src  The source bitmap (IN)
+ * @return OPAL error code or success
+ *
+ */
+OCOMS_DECLSPEC int ocoms_bitmap_bitwise_and_inplace(ocoms_bitmap_t *dest, ocoms_bitmap_t *src);
+OCOMS_DECLSPEC int ocoms_bitmap_bitwise_or_inplace(ocoms_bitmap_t *dest, ocoms_bitmap_t *src);
+OCOMS_DECLSPEC int ocoms_bitmap_bitwise_xor_inplace(ocoms_bitmap_t *dest, ocoms_bitmap_t *src);
+
+
 /**
  * Gives the current size (number of bits) in the bitmap. This is the
  * legal (accessible) number of bits
@@ -166,7 +260,7 @@ OCOMS_DECLSPEC int ocoms_bitmap_set_all_bits(ocoms_bitmap_t *bm);
  */
 static inline int ocoms_bitmap_size(ocoms_bitmap_t *bm)
 {
-    return (NULL == bm) ? 0 : (bm->array_size * ((int) (sizeof(char) * 8)));
+    return (NULL == bm) ? 0 : (bm->array_size * ((int) (sizeof(uint64_t) * 8)));
 }
 
 
@@ -175,14 +269,9 @@ static inline int ocoms_bitmap_size(ocoms_bitmap_t *bm)
  *
  * @param dest Pointer to the destination bitmap
  * @param src Pointer to the source bitmap
- * @ return OPAL error code if something goes wrong
+ * @return OPAL error code if something goes wrong
  */
-static inline void ocoms_bitmap_copy(ocoms_bitmap_t *dest, ocoms_bitmap_t *src)
-{
-    dest->bitmap = (unsigned char*)malloc(src->array_size);
-    memcpy(dest->bitmap, src->bitmap, src->array_size);
-    dest->array_size = src->array_size;
-}
+OCOMS_DECLSPEC int ocoms_bitmap_copy(ocoms_bitmap_t *dest, ocoms_bitmap_t *src);
 
 END_C_DECLS
 
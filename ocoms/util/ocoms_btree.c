@@ -0,0 +1,634 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_btree.h"
+
+/* every node but the root holds at least MIN_KEYS keys */
+#define MIN_KEYS (OCOMS_BTREE_NODE_KEYS / 2)
+
+/* leaves and inner nodes are allocated with the same size, so that
+ * spare nodes can be used for either */
+#define NODE_BYTES                                                  \
+    ((sizeof(ocoms_btree_leaf_t) > sizeof(ocoms_btree_inner_t)) ?   \
+     sizeof(ocoms_btree_leaf_t) : sizeof(ocoms_btree_inner_t))
+
+#define LEAF(node)  ((ocoms_btree_leaf_t *) (node))
+#define INNER(node) ((ocoms_btree_inner_t *) (node))
+
+static void ocoms_btree_construct(ocoms_btree_t *tree);
+static void ocoms_btree_destruct(ocoms_btree_t *tree);
+
+OBJ_CLASS_INSTANCE(ocoms_btree_t, ocoms_object_t,
+                   ocoms_btree_construct, ocoms_btree_destruct);
+
+
+static void ocoms_btree_construct(ocoms_btree_t *tree)
+{
+    tree->root = NULL;
+    tree->first_leaf = NULL;
+    tree->comp = NULL;
+    tree->height = 0;
+    tree->spare = NULL;
+    tree->num_spare = 0;
+    tree->tree_size = 0;
+}
+
+static void free_subtree(ocoms_btree_node_t *node, ocoms_btree_node_t *keep)
+{
+    int i;
+
+    if (!node->is_leaf) {
+        for (i = 0; i <= node->num_keys; i++) {
+            free_subtree(INNER(node)->children[i], keep);
+        }
+    }
+    if (node != keep) {
+        free(node);
+    }
+}
+
+/* give spare nodes beyond count back to the system */
+static void trim_spares(ocoms_btree_t *tree, int count)
+{
+    ocoms_btree_node_t *node;
+
+    while (tree->num_spare > count) {
+        node = tree->spare;
+        tree->spare = (ocoms_btree_node_t *) node->keys[0];
+        tree->num_spare--;
+        free(node);
+    }
+}
+
+static void ocoms_btree_destruct(ocoms_btree_t *tree)
+{
+    if (NULL != tree->root) {
+        free_subtree(tree->root, NULL);
+    }
+    trim_spares(tree, 0);
+    ocoms_btree_construct(tree);
+}
+
+
+/*
+ * Node allocation.  Insertions first make sure that enough spare nodes
+ * are available for a split at every level, so that once started they
+ * can not fail half way.
+ */
+static int reserve_spares(ocoms_btree_t *tree, int count)
+{
+    ocoms_btree_node_t *node;
+
+    while (tree->num_spare < count) {
+#if HAVE_POSIX_MEMALIGN
+        void *ptr;
+        if (0 != posix_memalign(&ptr, 64, NODE_BYTES)) {
+            return OCOMS_ERR_OUT_OF_RESOURCE;
+        }
+        node = (ocoms_btree_node_t *) ptr;
+#else
+        node = (ocoms_btree_node_t *) malloc(NODE_BYTES);
+        if (NULL == node) {
+            return OCOMS_ERR_OUT_OF_RESOURCE;
+        }
+#endif  /* HAVE_POSIX_MEMALIGN */
+        node->keys[0] = tree->spare;
+        tree->spare = node;
+        tree->num_spare++;
+    }
+    return OCOMS_SUCCESS;
+}
+
+static ocoms_btree_node_t *node_take(ocoms_btree_t *tree, bool leaf)
+{
+    ocoms_btree_node_t *node = tree->spare;
+
+    tree->spare = (ocoms_btree_node_t *) node->keys[0];
+    tree->num_spare--;
+    node->num_keys = 0;
+    node->is_leaf = leaf;
+    if (leaf) {
+        LEAF(node)->next = NULL;
+    }
+    return node;
+}
+
+static void node_release(ocoms_btree_t *tree, ocoms_btree_node_t *node)
+{
+    if (tree->num_spare < tree->height + 2) {
+        node->keys[0] = tree->spare;
+        tree->spare = node;
+        tree->num_spare++;
+    } else {
+        free(node);
+    }
+}
+
+
+int ocoms_btree_init(ocoms_btree_t *tree, ocoms_btree_comp_fn_t comp)
+{
+    int rc;
+
+    if (NULL != tree->root) {
+        ocoms_btree_clear(tree);
+    } else {
+        rc = reserve_spares(tree, 1);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+        tree->root = node_take(tree, true);
+        tree->first_leaf = LEAF(tree->root);
+    }
+    tree->comp = comp;
+    return OCOMS_SUCCESS;
+}
+
+void ocoms_btree_clear(ocoms_btree_t *tree)
+{
+    /* keep the leftmost leaf as the new, empty, root */
+    free_subtree(tree->root, &tree->first_leaf->node);
+    tree->first_leaf->node.num_keys = 0;
+    tree->first_leaf->next = NULL;
+    tree->root = &tree->first_leaf->node;
+    tree->height = 0;
+    tree->tree_size = 0;
+    trim_spares(tree, tree->height + 2);
+}
+
+
+/* first position whose key is not less than key */
+static inline int node_lower_bound(ocoms_btree_comp_fn_t comp, ocoms_btree_node_t *node,
+                                   void *key)
+{
+    int lo = 0, hi = node->num_keys, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (comp(key, node->keys[mid]) > 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* first position whose key is greater than key */
+static inline int node_upper_bound(ocoms_btree_comp_fn_t comp, ocoms_btree_node_t *node,
+                                   void *key)
+{
+    int lo = 0, hi = node->num_keys, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (comp(key, node->keys[mid]) >= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+/*
+ * Insert below node.  When node has to be split, the new right
+ * sibling and the key separating it from node are returned for the
+ * caller to insert in the parent.
+ */
+static void insert_rec(ocoms_btree_t *tree, ocoms_btree_node_t *node, void *key, void *value,
+                       void **up_key, ocoms_btree_node_t **up_node)
+{
+    void *keys[OCOMS_BTREE_NODE_KEYS + 1];
+    void *items[OCOMS_BTREE_NODE_KEYS + 2];
+    ocoms_btree_node_t *right, *child_up = NULL;
+    void *child_key;
+    int n = node->num_keys, pos, mid;
+
+    *up_node = NULL;
+
+    if (node->is_leaf) {
+        ocoms_btree_leaf_t *leaf = LEAF(node);
+
+        pos = node_upper_bound(tree->comp, node, key);
+        if (n < OCOMS_BTREE_NODE_KEYS) {
+            memmove(&node->keys[pos + 1], &node->keys[pos], (n - pos) * sizeof(void *));
+            memmove(&leaf->values[pos + 1], &leaf->values[pos], (n - pos) * sizeof(void *));
+            node->keys[pos] = key;
+            leaf->values[pos] = value;
+            node->num_keys++;
+            return;
+        }
+
+        /* full: spread the n + 1 entries over two leaves */
+        memcpy(keys, node->keys, pos * sizeof(void *));
+        memcpy(items, leaf->values, pos * sizeof(void *));
+        keys[pos] = key;
+        items[pos] = value;
+        memcpy(&keys[pos + 1], &node->keys[pos], (n - pos) * sizeof(void *));
+        memcpy(&items[pos + 1], &leaf->values[pos], (n - pos) * sizeof(void *));
+
+        mid = (n + 1) / 2;
+        right = node_take(tree, true);
+        memcpy(node->keys, keys, mid * sizeof(void *));
+        memcpy(leaf->values, items, mid * sizeof(void *));
+        node->num_keys = mid;
+        memcpy(right->keys, &keys[mid], (n + 1 - mid) * sizeof(void *));
+        memcpy(LEAF(right)->values, &items[mid], (n + 1 - mid) * sizeof(void *));
+        right->num_keys = n + 1 - mid;
+
+        LEAF(right)->next = leaf->next;
+        leaf->next = LEAF(right);
+        *up_key = right->keys[0];
+        *up_node = right;
+        return;
+    }
+
+    pos = node_upper_bound(tree->comp, node, key);
+    insert_rec(tree, INNER(node)->children[pos], key, value, &child_key, &child_up);
+    if (NULL == child_up) {
+        return;
+    }
+
+    if (n < OCOMS_BTREE_NODE_KEYS) {
+        memmove(&node->keys[pos + 1], &node->keys[pos], (n - pos) * sizeof(void *));
+        memmove(&INNER(node)->children[pos + 2], &INNER(node)->children[pos + 1],
+                (n - pos) * sizeof(ocoms_btree_node_t *));
+        node->keys[pos] = child_key;
+        INNER(node)->children[pos + 1] = child_up;
+        node->num_keys++;
+        return;
+    }
+
+    /* full: n + 1 keys and n + 2 children, the middle key moves up */
+    memcpy(keys, node->keys, pos * sizeof(void *));
+    keys[pos] = child_key;
+    memcpy(&keys[pos + 1], &node->keys[pos], (n - pos) * sizeof(void *));
+    memcpy(items, INNER(node)->children, (pos + 1) * sizeof(void *));
+    items[pos + 1] = child_up;
+    memcpy(&items[pos + 2], &INNER(node)->children[pos + 1], (n - pos) * sizeof(void *));
+
+    mid = (n + 1) / 2;
+    right = node_take(tree, false);
+    memcpy(node->keys, keys, mid * sizeof(void *));
+    memcpy(INNER(node)->children, items, (mid + 1) * sizeof(void *));
+    node->num_keys = mid;
+    memcpy(right->keys, &keys[mid + 1], (n - mid) * sizeof(void *));
+    memcpy(INNER(right)->children, &items[mid + 1], (n - mid + 1) * sizeof(void *));
+    right->num_keys = n - mid;
+
+    *up_key = keys[mid];
+    *up_node = right;
+}
+
+int ocoms_btree_insert(ocoms_btree_t *tree, void *key, void *value)
+{
+    ocoms_btree_node_t *root, *up_node;
+    void *up_key;
+    int rc;
+
+    /* one node per level for the splits, plus a new root */
+    rc = reserve_spares(tree, tree->height + 2);
+    if (OCOMS_SUCCESS != rc) {
+        return rc;
+    }
+
+    insert_rec(tree, tree->root, key, value, &up_key, &up_node);
+    if (NULL != up_node) {
+        root = node_take(tree, false);
+        root->keys[0] = up_key;
+        INNER(root)->children[0] = tree->root;
+        INNER(root)->children[1] = up_node;
+        root->num_keys = 1;
+        tree->root = root;
+        tree->height++;
+    }
+    tree->tree_size++;
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * Rebalancing after a deletion: children[i] of parent is one key short.
+ */
+static void borrow_from_left(ocoms_btree_node_t *parent, int i)
+{
+    ocoms_btree_node_t *child = INNER(parent)->children[i];
+    ocoms_btree_node_t *left = INNER(parent)->children[i - 1];
+    int n = child->num_keys, ln = left->num_keys;
+
+    memmove(&child->keys[1], &child->keys[0], n * sizeof(void *));
+    if (child->is_leaf) {
+        memmove(&LEAF(child)->values[1], &LEAF(child)->values[0], n * sizeof(void *));
+        child->keys[0] = left->keys[ln - 1];
+        LEAF(child)->values[0] = LEAF(left)->values[ln - 1];
+        parent->keys[i - 1] = child->keys[0];
+    } else {
+        memmove(&INNER(child)->children[1], &INNER(child)->children[0],
+                (n + 1) * sizeof(ocoms_btree_node_t *));
+        child->keys[0] = parent->keys[i - 1];
+        INNER(child)->children[0] = INNER(left)->children[ln];
+        parent->keys[i - 1] = left->keys[ln - 1];
+    }
+    left->num_keys--;
+    child->num_keys++;
+}
+
+static void borrow_from_right(ocoms_btree_node_t *parent, int i)
+{
+    ocoms_btree_node_t *child = INNER(parent)->children[i];
+    ocoms_btree_node_t *right = INNER(parent)->children[i + 1];
+    int n = child->num_keys, rn = right->num_keys;
+
+    if (child->is_leaf) {
+        child->keys[n] = right->keys[0];
+        LEAF(child)->values[n] = LEAF(right)->values[0];
+        memmove(&right->keys[0], &right->keys[1], (rn - 1) * sizeof(void *));
+        memmove(&LEAF(right)->values[0], &LEAF(right)->values[1], (rn - 1) * sizeof(void *));
+        parent->keys[i] = right->keys[0];
+    } else {
+        child->keys[n] = parent->keys[i];
+        INNER(child)->children[n + 1] = INNER(right)->children[0];
+        parent->keys[i] = right->keys[0];
+        memmove(&right->keys[0], &right->keys[1], (rn - 1) * sizeof(void *));
+        memmove(&INNER(right)->children[0], &INNER(right)->children[1],
+                rn * sizeof(ocoms_btree_node_t *));
+    }
+    right->num_keys--;
+    child->num_keys++;
+}
+
+/* merge children[i + 1] of parent into children[i] */
+static void merge_children(ocoms_btree_t *tree, ocoms_btree_node_t *parent, int i)
+{
+    ocoms_btree_node_t *left = INNER(parent)->children[i];
+    ocoms_btree_node_t *right = INNER(parent)->children[i + 1];
+    int ln = left->num_keys, rn = right->num_keys;
+
+    if (left->is_leaf) {
+        memcpy(&left->keys[ln], right->keys, rn * sizeof(void *));
+        memcpy(&LEAF(left)->values[ln], LEAF(right)->values, rn * sizeof(void *));
+        left->num_keys = ln + rn;
+        LEAF(left)->next = LEAF(right)->next;
+    } else {
+        left->keys[ln] = parent->keys[i];
+        memcpy(&left->keys[ln + 1], right->keys, rn * sizeof(void *));
+        memcpy(&INNER(left)->children[ln + 1], INNER(right)->children,
+               (rn + 1) * sizeof(ocoms_btree_node_t *));
+        left->num_keys = ln + rn + 1;
+    }
+
+    memmove(&parent->keys[i], &parent->keys[i + 1],
+            (parent->num_keys - i - 1) * sizeof(void *));
+    memmove(&INNER(parent)->children[i + 1], &INNER(parent)->children[i + 2],
+            (parent->num_keys - i - 1) * sizeof(ocoms_btree_node_t *));
+    parent->num_keys--;
+    node_release(tree, right);
+}
+
+static void fix_child(ocoms_btree_t *tree, ocoms_btree_node_t *parent, int i)
+{
+    if (i > 0 && INNER(parent)->children[i - 1]->num_keys > MIN_KEYS) {
+        borrow_from_left(parent, i);
+    } else if (i < parent->num_keys && INNER(parent)->children[i + 1]->num_keys > MIN_KEYS) {
+        borrow_from_right(parent, i);
+    } else if (i > 0) {
+        merge_children(tree, parent, i - 1);
+    } else {
+        merge_children(tree, parent, i);
+    }
+}
+
+/*
+ * Delete the first entry with key below node.  Returns whether node
+ * was left with less than MIN_KEYS keys.
+ */
+static bool delete_rec(ocoms_btree_t *tree, ocoms_btree_node_t *node, void *key, bool *found)
+{
+    int pos = node_lower_bound(tree->comp, node, key);
+
+    if (node->is_leaf) {
+        if (pos == node->num_keys || 0 != tree->comp(key, node->keys[pos])) {
+            return false;
+        }
+        memmove(&node->keys[pos], &node->keys[pos + 1],
+                (node->num_keys - pos - 1) * sizeof(void *));
+        memmove(&LEAF(node)->values[pos], &LEAF(node)->values[pos + 1],
+                (node->num_keys - pos - 1) * sizeof(void *));
+        node->num_keys--;
+        *found = true;
+        return node->num_keys < MIN_KEYS;
+    }
+
+    for (;;) {
+        if (delete_rec(tree, INNER(node)->children[pos], key, found)) {
+            fix_child(tree, node, pos);
+        }
+        /* entries equal to a separator may continue in the next subtree */
+        if (*found || pos == node->num_keys || 0 != tree->comp(key, node->keys[pos])) {
+            break;
+        }
+        pos++;
+    }
+    return node->num_keys < MIN_KEYS;
+}
+
+int ocoms_btree_delete(ocoms_btree_t *tree, void *key)
+{
+    ocoms_btree_node_t *root = tree->root;
+    bool found = false;
+
+    delete_rec(tree, root, key, &found);
+    if (!found) {
+        return OCOMS_ERR_NOT_FOUND;
+    }
+    tree->tree_size--;
+
+    /* an inner root left with a single child is replaced by it */
+    if (!root->is_leaf && 0 == root->num_keys) {
+        tree->root = INNER(root)->children[0];
+        tree->height--;
+        node_release(tree, root);
+        trim_spares(tree, tree->height + 2);
+    }
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * Lookups.  The descent follows the first separator not less than the
+ * key, so it ends in the leaf holding the first candidate entry, or in
+ * the leaf just before it.
+ */
+static ocoms_btree_leaf_t *find_leaf(ocoms_btree_t *tree, ocoms_btree_comp_fn_t comp,
+                                     void *key, int *index)
+{
+    ocoms_btree_node_t *node = tree->root;
+    ocoms_btree_leaf_t *leaf;
+    int pos;
+
+    while (!node->is_leaf) {
+        node = INNER(node)->children[node_lower_bound(comp, node, key)];
+    }
+    leaf = LEAF(node);
+    pos = node_lower_bound(comp, node, key);
+    if (pos == node->num_keys) {
+        leaf = leaf->next;
+        pos = 0;
+    }
+    *index = pos;
+    return leaf;
+}
+
+void *ocoms_btree_find_with(ocoms_btree_t *tree, void *key, ocoms_btree_comp_fn_t compfn)
+{
+    int pos;
+    ocoms_btree_leaf_t *leaf = find_leaf(tree, compfn, key, &pos);
+
+    if (NULL == leaf || 0 != compfn(key, leaf->node.keys[pos])) {
+        return NULL;
+    }
+    return leaf->values[pos];
+}
+
+void *ocoms_btree_lower_bound(ocoms_btree_t *tree, void *key, void **found_key)
+{
+    int pos;
+    ocoms_btree_leaf_t *leaf = find_leaf(tree, tree->comp, key, &pos);
+
+    if (NULL == leaf) {
+        return NULL;
+    }
+    if (NULL != found_key) {
+        *found_key = leaf->node.keys[pos];
+    }
+    return leaf->values[pos];
+}
+
+void ocoms_btree_iter_lower_bound(ocoms_btree_t *tree, void *key, ocoms_btree_iter_t *iter)
+{
+    iter->leaf = find_leaf(tree, tree->comp, key, &iter->index);
+}
+
+int ocoms_btree_find_range(ocoms_btree_t *tree, void *lo_key, void *hi_key,
+                           ocoms_btree_visit_fn_t visit, void *context)
+{
+    ocoms_btree_iter_t iter;
+    void *key, *value;
+    int rc;
+
+    if (NULL == visit) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+    ocoms_btree_iter_lower_bound(tree, lo_key, &iter);
+    while (ocoms_btree_iter_next(&iter, &key, &value) && tree->comp(hi_key, key) >= 0) {
+        rc = visit(key, value, context);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+    }
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * Bulk load: build the leaves left to right, then each inner level
+ * from the one below, spreading the entries evenly so that every node
+ * gets at least MIN_KEYS keys.
+ */
+int ocoms_btree_bulk_load(ocoms_btree_t *tree, void **keys, void **values, size_t count)
+{
+    ocoms_btree_node_t **level, *node;
+    ocoms_btree_leaf_t *prev = NULL;
+    void **level_min;
+    size_t num_nodes, total, per_node, extra, i, j, next;
+    int rc, height = 0;
+
+    if (0 != tree->tree_size) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+    if (0 == count) {
+        return OCOMS_SUCCESS;
+    }
+
+    /* allocate all the nodes up front, so that the load can not fail half way */
+    num_nodes = (count + OCOMS_BTREE_NODE_KEYS - 1) / OCOMS_BTREE_NODE_KEYS;
+    for (total = num_nodes, i = num_nodes; i > 1; total += i) {
+        i = (i + OCOMS_BTREE_NODE_KEYS) / (OCOMS_BTREE_NODE_KEYS + 1);
+    }
+    level = (ocoms_btree_node_t **) malloc(num_nodes * sizeof(ocoms_btree_node_t *));
+    level_min = (void **) malloc(num_nodes * sizeof(void *));
+    if (NULL == level || NULL == level_min ||
+        OCOMS_SUCCESS != (rc = reserve_spares(tree, (int) total + 2))) {
+        free(level);
+        free(level_min);
+        trim_spares(tree, tree->height + 2);
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+
+    /* the leaves */
+    per_node = count / num_nodes;
+    extra = count % num_nodes;
+    for (i = 0, next = 0; i < num_nodes; i++) {
+        node = node_take(tree, true);
+        node->num_keys = (uint16_t) (per_node + (i < extra));
+        memcpy(node->keys, &keys[next], node->num_keys * sizeof(void *));
+        memcpy(LEAF(node)->values, &values[next], node->num_keys * sizeof(void *));
+        next += node->num_keys;
+        if (NULL != prev) {
+            prev->next = LEAF(node);
+        }
+        prev = LEAF(node);
+        level[i] = node;
+        level_min[i] = node->keys[0];
+    }
+
+    /* the inner levels, built in place over the level below */
+    while (num_nodes > 1) {
+        size_t num_parents = (num_nodes + OCOMS_BTREE_NODE_KEYS) / (OCOMS_BTREE_NODE_KEYS + 1);
+        per_node = num_nodes / num_parents;
+        extra = num_nodes % num_parents;
+        for (i = 0, next = 0; i < num_parents; i++) {
+            size_t num_children = per_node + (i < extra);
+            void *min = level_min[next];
+            node = node_take(tree, false);
+            for (j = 0; j < num_children; j++, next++) {
+                INNER(node)->children[j] = level[next];
+                if (j > 0) {
+                    node->keys[j - 1] = level_min[next];
+                }
+            }
+            node->num_keys = (uint16_t) (num_children - 1);
+            level[i] = node;
+            level_min[i] = min;
+        }
+        num_nodes = num_parents;
+        height++;
+    }
+
+    node_release(tree, tree->root);
+    tree->root = level[0];
+    while (!level[0]->is_leaf) {
+        level[0] = INNER(level[0])->children[0];
+    }
+    tree->first_leaf = LEAF(level[0]);
+    tree->height = height;
+    tree->tree_size = count;
+    trim_spares(tree, tree->height + 2);
+
+    free(level);
+    free(level_min);
+    return OCOMS_SUCCESS;
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/** @file
+ *
+ *     An ordered map stored as a B+tree
+ *
+ *     ocoms_btree_t offers the same compare-function based interface
+ *     as ocoms_rb_tree_t, but stores up to OCOMS_BTREE_NODE_KEYS keys
+ *     per node with the key pointers packed together, so a lookup
+ *     visits a handful of wide nodes instead of one node per level of
+ *     a binary tree.  All the values live in the leaves, which are
+ *     chained in key order for range iteration.  It is meant for
+ *     read-mostly indexes, such as registration caches keyed by
+ *     address; a tree can also be bulk-loaded from sorted input.
+ *
+ *     As with the rb-tree, several entries may share the same key.
+ */
+
+#ifndef OCOMS_BTREE_H
+#define OCOMS_BTREE_H
+
+#include "ocoms/platform/ocoms_config.h"
+#include <stdlib.h>
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_object.h"
+
+BEGIN_C_DECLS
+
+/**
+ * Maximal number of keys in a node.  Leaves and inner nodes are both
+ * four cache lines on LP64 platforms.
+ */
+#define OCOMS_BTREE_NODE_KEYS 15
+
+/**
+ * \internal
+ *
+ * Header and keys, common to leaves and inner nodes.
+ */
+struct ocoms_btree_node_t {
+    uint16_t num_keys;                  /**< number of keys in use */
+    uint16_t is_leaf;                   /**< whether this is a leaf */
+    void *keys[OCOMS_BTREE_NODE_KEYS];  /**< the sorted keys */
+};
+typedef struct ocoms_btree_node_t ocoms_btree_node_t;
+
+/**
+ * \internal
+ *
+ * A leaf: keys[i] maps to values[i].
+ */
+struct ocoms_btree_leaf_t {
+    ocoms_btree_node_t node;                /**< header and keys */
+    void *values[OCOMS_BTREE_NODE_KEYS];    /**< the values */
+    struct ocoms_btree_leaf_t *next;        /**< the next leaf in key order */
+};
+typedef struct ocoms_btree_leaf_t ocoms_btree_leaf_t;
+
+/**
+ * \internal
+ *
+ * An inner node: the keys of children[i] are not greater than
+ * keys[i], which is not greater than the keys of children[i+1].
+ */
+struct ocoms_btree_inner_t {
+    ocoms_btree_node_t node;                          /**< header and keys */
+    ocoms_btree_node_t *children[OCOMS_BTREE_NODE_KEYS + 1]; /**< the subtrees */
+};
+typedef struct ocoms_btree_inner_t ocoms_btree_inner_t;
+
+/**
+  * the compare function typedef, identical to ocoms_rb_tree_comp_fn_t
+  */
+typedef int (*ocoms_btree_comp_fn_t)(void *key1, void *key2);
+
+/**
+  * the function called on every entry by ocoms_btree_find_range.
+  * Returning anything but OCOMS_SUCCESS stops the lookup, and the value
+  * is returned to the caller.
+  */
+typedef int (*ocoms_btree_visit_fn_t)(void *key, void *value, void *context);
+
+/**
+  * the data structure that holds all the needed information about the tree.
+  */
+struct ocoms_btree_t {
+    ocoms_object_t super;           /**< the parent class */
+    ocoms_btree_node_t *root;       /**< the root, an empty leaf for an empty tree */
+    ocoms_btree_leaf_t *first_leaf; /**< the leftmost leaf */
+    ocoms_btree_comp_fn_t comp;     /**< the compare function */
+    int height;                     /**< number of inner levels above the leaves */
+    ocoms_btree_node_t *spare;      /**< nodes kept aside so that splits never fail */
+    int num_spare;                  /**< length of the spare chain */
+    size_t tree_size;               /**< the number of entries */
+};
+typedef struct ocoms_btree_t ocoms_btree_t;
+
+/** declare the tree as a class */
+OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_btree_t);
+
+/**
+ * Iterator over the entries of an ocoms_btree_t, in key order.  The
+ * tree must not be modified while an iterator is in use.
+ */
+struct ocoms_btree_iter_t {
+    ocoms_btree_leaf_t *leaf;
+    int index;
+};
+typedef struct ocoms_btree_iter_t ocoms_btree_iter_t;
+
+/**
+  * initializes the tree
+  *
+  * @param tree the tree, constructed
+  * @param comp the function to use for comparing 2 keys
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_OUT_OF_RESOURCE
+  */
+OCOMS_DECLSPEC int ocoms_btree_init(ocoms_btree_t *tree, ocoms_btree_comp_fn_t comp);
+
+/**
+  * inserts an entry into the tree.  An entry with an equal key is
+  * inserted after the existing ones.
+  *
+  * @param tree a pointer to the tree data structure
+  * @param key the key for the entry
+  * @param value the value for the entry
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_OUT_OF_RESOURCE if unsuccessful, the tree is unchanged
+  */
+OCOMS_DECLSPEC int ocoms_btree_insert(ocoms_btree_t *tree, void *key, void *value);
+
+/**
+  * fills an empty tree from sorted input.  This is much faster than
+  * inserting the entries one by one, and the leaves are left full.
+  *
+  * @param tree a pointer to the tree, which must be empty
+  * @param keys the keys, sorted according to the compare function
+  * @param values the values matching the keys
+  * @param count the number of entries
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_BAD_PARAM if the tree is not empty
+  * @retval OCOMS_ERR_OUT_OF_RESOURCE if unsuccessful, the tree is left empty
+  */
+OCOMS_DECLSPEC int ocoms_btree_bulk_load(ocoms_btree_t *tree, void **keys, void **values,
+                                         size_t count);
+
+/**
+  * finds a value in the tree based on the passed key using the passed
+  * compare function, which must order the keys as the tree's one does
+  *
+  * @retval pointer to the value if found
+  * @retval NULL if not found
+  */
+OCOMS_DECLSPEC void *ocoms_btree_find_with(ocoms_btree_t *tree, void *key,
+                                           ocoms_btree_comp_fn_t compfn);
+
+/**
+  * finds a value in the tree based on the passed key
+  *
+  * @retval pointer to the value if found
+  * @retval NULL if not found
+  */
+static inline void *ocoms_btree_find(ocoms_btree_t *tree, void *key)
+{
+    return ocoms_btree_find_with(tree, key, tree->comp);
+}
+
+/**
+  * finds the first entry whose key is not less than the passed key
+  *
+  * @param tree a pointer to the tree data structure
+  * @param key a pointer to the key
+  * @param found_key if not NULL, set to the key of the entry found
+  *
+  * @retval pointer to the value of the entry found
+  * @retval NULL if all the keys of the tree are less than key
+  */
+OCOMS_DECLSPEC void *ocoms_btree_lower_bound(ocoms_btree_t *tree, void *key, void **found_key);
+
+/**
+  * deletes the first entry with the passed key
+  *
+  * @retval OCOMS_SUCCESS if the entry is found and deleted
+  * @retval OCOMS_ERR_NOT_FOUND if the entry is not found
+  */
+OCOMS_DECLSPEC int ocoms_btree_delete(ocoms_btree_t *tree, void *key);
+
+/**
+  * calls a function, in key order, on all the entries whose key lies
+  * between two keys (both included)
+  *
+  * @retval OCOMS_SUCCESS if all the entries in the range were visited
+  * @retval the value returned by visit if it stopped the lookup
+  *
+  * The tree must not be modified from visit.
+  */
+OCOMS_DECLSPEC int ocoms_btree_find_range(ocoms_btree_t *tree, void *lo_key, void *hi_key,
+                                          ocoms_btree_visit_fn_t visit, void *context);
+
+/**
+  * positions an iterator on the first entry whose key is not less
+  * than the passed key
+  */
+OCOMS_DECLSPEC void ocoms_btree_iter_lower_bound(ocoms_btree_t *tree, void *key,
+                                                 ocoms_btree_iter_t *iter);
+
+/**
+  * positions an iterator on the first entry of the tree
+  */
+static inline void ocoms_btree_iter_first(ocoms_btree_t *tree, ocoms_btree_iter_t *iter)
+{
+    iter->leaf = tree->first_leaf;
+    iter->index = 0;
+}
+
+/**
+  * returns the entry under the iterator and advances it
+  *
+  * @param iter the iterator
+  * @param key if not NULL, set to the key of the entry
+  * @param value if not NULL, set to the value of the entry
+  *
+  * @retval true if an entry was returned
+  * @retval false once the end of the tree is reached
+  */
+static inline bool ocoms_btree_iter_next(ocoms_btree_iter_t *iter, void **key, void **value)
+{
+    while (NULL != iter->leaf && iter->index >= iter->leaf->node.num_keys) {
+        iter->leaf = iter->leaf->next;
+        iter->index = 0;
+    }
+    if (NULL == iter->leaf) {
+        return false;
+    }
+    if (NULL != key) {
+        *key = iter->leaf->node.keys[iter->index];
+    }
+    if (NULL != value) {
+        *value = iter->leaf->values[iter->index];
+    }
+    iter->index++;
+    return true;
+}
+
+/**
+  * removes all the entries of the tree, which remains usable
+  */
+OCOMS_DECLSPEC void ocoms_btree_clear(ocoms_btree_t *tree);
+
+/**
+  * returns the number of entries in the tree
+  */
+static inline size_t ocoms_btree_size(ocoms_btree_t *tree)
+{
+    return tree->tree_size;
+}
+
+END_C_DECLS
+
+#endif /* OCOMS_BTREE_H */
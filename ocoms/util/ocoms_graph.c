@@ -25,8 +25,31 @@
 #include "ocoms/platform/ocoms_constants.h"
 #include "ocoms/util/ocoms_graph.h"
 #include "ocoms/util/output.h"
+#include "ocoms/threads/threads.h"
+#include "ocoms/sys/atomic.h"
+#include "ocoms/mca/base/mca_base_pvar.h"
 
 static int compare_vertex_distance(const void *item1, const void *item2);
+static void graph_changed(ocoms_graph_t *graph);
+static int vertex_index_insert(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex);
+static void vertex_index_remove(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex);
+static void vertex_index_drop(ocoms_graph_t *graph);
+static ocoms_graph_csr_t *graph_build_csr(ocoms_graph_t *graph);
+static ocoms_graph_csr_t *graph_get_csr(ocoms_graph_t *graph, bool *temporary);
+static int csr_dijkstra(ocoms_graph_csr_t *csr, int source, uint32_t *distance, int *work);
+
+/* The spf cache statistics, exposed as performance variables */
+static unsigned long long spf_cache_hits = 0;
+static unsigned long long spf_cache_misses = 0;
+
+/* The maximum number of sources whose distances are cached per graph, 0 disables the cache */
+static int spf_cache_max = 16;
+
+#if OCOMS_ENABLE_MULTI_THREADS
+#define SPF_CACHE_COUNT(counter) ocoms_atomic_add(&(counter), 1)
+#else
+#define SPF_CACHE_COUNT(counter) (counter)++
+#endif
 
 /*
  *  Graph classes
@@ -93,6 +116,9 @@ static void ocoms_graph_vertex_construct(ocoms_graph_vertex_t *vertex)
     vertex->alloc_vertex_data = NULL;
     vertex->compare_vertex = NULL;
     vertex->print_vertex = NULL;
+    vertex->hash_vertex = NULL;
+    vertex->index_next = NULL;
+    vertex->index = -1;
 }
 
 static void ocoms_graph_vertex_destruct(ocoms_graph_vertex_t *vertex)
@@ -147,12 +173,21 @@ static void ocoms_graph_construct(ocoms_graph_t *graph)
     graph->adjacency_list = OBJ_NEW(ocoms_list_t);
     graph->number_of_vertices = 0;
     graph->number_of_edges = 0;
+    graph->csr = NULL;
+    graph->spf_cache = NULL;
+    graph->spf_cache_size = 0;
+    graph->spf_cache_used = 0;
+    OBJ_CONSTRUCT(&graph->spf_cache_lock, ocoms_mutex_t);
+    graph->vertex_index = NULL;
+    graph->index_hash = NULL;
 }
 
 static void ocoms_graph_destruct(ocoms_graph_t *graph)
 {
     ocoms_adjacency_list_t *aj_list;
 
+    graph_changed(graph);
+    vertex_index_drop(graph);
     while (false == ocoms_list_is_empty(graph->adjacency_list)) {
         aj_list = (ocoms_adjacency_list_t *)ocoms_list_remove_first(graph->adjacency_list);
         OBJ_RELEASE(aj_list);
@@ -160,6 +195,7 @@ static void ocoms_graph_destruct(ocoms_graph_t *graph)
     OBJ_RELEASE(graph->adjacency_list);
     graph->number_of_vertices = 0;
     graph->number_of_edges = 0;
+    OBJ_DESTRUCT(&graph->spf_cache_lock);
 }
 
 /*
@@ -253,6 +289,8 @@ void ocoms_graph_add_vertex(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex)
            return;
        }
    }
+   /* the CSR layout and the cached distances do not include the new vertex */
+   graph_changed(graph);
    /* Construct a new adjacency list */
    aj_list = OBJ_NEW(ocoms_adjacency_list_t);
    aj_list->vertex = vertex;
@@ -262,6 +300,20 @@ void ocoms_graph_add_vertex(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex)
    ocoms_list_append(graph->adjacency_list, (ocoms_list_item_t*)aj_list);
    /* point the vertex to the graph it belongs to (mostly for debug uses)*/
    vertex->in_graph = graph;
+   /**
+    * keep the vertex index up to date. An empty index takes the hash
+    * function of the first vertex; a vertex with another hash function
+    * can not be indexed, and find_vertex goes back to scanning.
+    */
+   if (NULL != graph->vertex_index) {
+       if (0 == ocoms_hash_table_get_size(graph->vertex_index)) {
+           graph->index_hash = vertex->hash_vertex;
+       }
+       if (vertex->hash_vertex != graph->index_hash ||
+           OCOMS_SUCCESS != vertex_index_insert(graph, vertex)) {
+           vertex_index_drop(graph);
+       }
+   }
    /* increase the number of vertices in the graph */
    graph->number_of_vertices++;
 }
@@ -308,6 +360,7 @@ int ocoms_graph_add_edge(ocoms_graph_t *graph, ocoms_graph_edge_t *edge)
     if (false == start_found && false == end_found) {
         return OCOMS_ERROR;
     }
+    graph_changed(graph);
     /* point the edge to the adjacency list of the start vertex (for easy search) */
     edge->in_adj_list=start_aj_list;
     /* append the edge to the adjacency list of the start vertex */
@@ -331,6 +384,7 @@ int ocoms_graph_add_edge(ocoms_graph_t *graph, ocoms_graph_edge_t *edge)
  */
 void ocoms_graph_remove_edge (ocoms_graph_t *graph, ocoms_graph_edge_t *edge)
 {
+    graph_changed(graph);
     /* remove the edge from the list it belongs to */
     ocoms_list_remove_item(edge->in_adj_list->edges, (ocoms_list_item_t*)edge);
     /* decrees the number of edges in the graph */
@@ -352,6 +406,7 @@ void ocoms_graph_remove_vertex(ocoms_graph_t *graph, ocoms_graph_vertex_t *verte
     ocoms_adjacency_list_t *adj_list;
     ocoms_graph_edge_t *edge;
 
+    graph_changed(graph);
     /**
      * remove all the edges of this vertex and destruct them.
      */
@@ -366,6 +421,10 @@ void ocoms_graph_remove_vertex(ocoms_graph_t *graph, ocoms_graph_vertex_t *verte
      */
     ocoms_list_remove_item(graph->adjacency_list, (ocoms_list_item_t*)adj_list);
     OBJ_RELEASE(adj_list);
+    /* remove the vertex from the vertex index */
+    if (NULL != graph->vertex_index) {
+        vertex_index_remove(graph, vertex);
+    }
     /**
      * delete all the edges that connected *to* the vertex.
      */
@@ -414,6 +473,21 @@ uint32_t ocoms_graph_adjacent(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex
     if (vertex1 == vertex2) {
         return 0;
     }
+    /**
+     * in a frozen graph, look for the second vertex in the contiguous
+     * edges of the first one.
+     */
+    if (NULL != graph->csr) {
+        ocoms_graph_csr_t *csr = graph->csr;
+        int e;
+
+        for (e = csr->offsets[vertex1->index]; e < csr->offsets[vertex1->index + 1]; e++) {
+            if (csr->targets[e] == vertex2->index) {
+                return csr->weights[e];
+            }
+        }
+        return DISTANCE_INFINITY;
+    }
     /**
      * find the second vertex in the adjacency list of the first
      * vertex.
@@ -471,7 +545,28 @@ ocoms_graph_vertex_t *ocoms_graph_find_vertex(ocoms_graph_t *graph, void *vertex
 {
     ocoms_adjacency_list_t *aj_list;
     ocoms_list_item_t *item;
+    ocoms_graph_vertex_t *vertex;
+    uint64_t key;
+    void *value;
 
+    /**
+     * Look the vertex data up in the vertex index, then walk the
+     * vertices with the same key.
+     */
+    if (NULL != graph->vertex_index) {
+        key = (NULL != graph->index_hash) ? graph->index_hash(vertex_data) : (uint64_t)(uintptr_t)vertex_data;
+        if (OCOMS_SUCCESS != ocoms_hash_table_get_value_uint64(graph->vertex_index, key, &value)) {
+            return NULL;
+        }
+        for (vertex = (ocoms_graph_vertex_t *)value; NULL != vertex; vertex = vertex->index_next) {
+            if (NULL != vertex->compare_vertex ?
+                0 == vertex->compare_vertex(vertex->vertex_data, vertex_data) :
+                vertex->vertex_data == vertex_data) {
+                return vertex;
+            }
+        }
+        return NULL;
+    }
     /**
      * Run on all the vertices of the graph
      */
@@ -492,6 +587,124 @@ ocoms_graph_vertex_t *ocoms_graph_find_vertex(ocoms_graph_t *graph, void *vertex
 }
 
 
+/**
+ * The key of a vertex in the vertex index.
+ */
+static inline uint64_t vertex_index_key(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex)
+{
+    return (NULL != graph->index_hash) ? graph->index_hash(vertex->vertex_data) :
+        (uint64_t)(uintptr_t)vertex->vertex_data;
+}
+
+/**
+ * Add a vertex to the vertex index, after the vertices which have
+ * the same key, so that find_vertex returns the first one added as
+ * the scan of the adjacency lists does.
+ */
+static int vertex_index_insert(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex)
+{
+    ocoms_graph_vertex_t *last;
+    uint64_t key = vertex_index_key(graph, vertex);
+    void *value;
+
+    vertex->index_next = NULL;
+    if (OCOMS_SUCCESS != ocoms_hash_table_get_value_uint64(graph->vertex_index, key, &value)) {
+        return ocoms_hash_table_set_value_uint64(graph->vertex_index, key, vertex);
+    }
+    for (last = (ocoms_graph_vertex_t *)value; NULL != last->index_next; last = last->index_next) {
+        continue;
+    }
+    last->index_next = vertex;
+    return OCOMS_SUCCESS;
+}
+
+/**
+ * Remove a vertex from the vertex index.
+ */
+static void vertex_index_remove(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex)
+{
+    ocoms_graph_vertex_t *prev;
+    uint64_t key = vertex_index_key(graph, vertex);
+    void *value;
+
+    if (OCOMS_SUCCESS != ocoms_hash_table_get_value_uint64(graph->vertex_index, key, &value)) {
+        return;
+    }
+    if (value == (void *)vertex) {
+        if (NULL == vertex->index_next) {
+            ocoms_hash_table_remove_value_uint64(graph->vertex_index, key);
+        } else {
+            ocoms_hash_table_set_value_uint64(graph->vertex_index, key, vertex->index_next);
+        }
+    } else {
+        for (prev = (ocoms_graph_vertex_t *)value; NULL != prev->index_next; prev = prev->index_next) {
+            if (prev->index_next == vertex) {
+                prev->index_next = vertex->index_next;
+                break;
+            }
+        }
+    }
+    vertex->index_next = NULL;
+}
+
+/**
+ * Drop the vertex index: find_vertex goes back to scanning.
+ */
+static void vertex_index_drop(ocoms_graph_t *graph)
+{
+    if (NULL != graph->vertex_index) {
+        OBJ_RELEASE(graph->vertex_index);
+        graph->vertex_index = NULL;
+        graph->index_hash = NULL;
+    }
+}
+
+/**
+ * This graph API builds a hash index of the vertices of the graph.
+ *
+ * @param graph
+ *
+ * @return int OCOMS_SUCCESS, OCOMS_ERR_BAD_PARAM or
+ *         OCOMS_ERR_OUT_OF_RESOURCE
+ */
+int ocoms_graph_index_vertices(ocoms_graph_t *graph)
+{
+    ocoms_adjacency_list_t *aj_list;
+    ocoms_list_item_t *item;
+    int rc;
+
+    vertex_index_drop(graph);
+    /* all the vertices must agree on the hash function */
+    item = ocoms_list_get_first(graph->adjacency_list);
+    if (item != ocoms_list_get_end(graph->adjacency_list)) {
+        graph->index_hash = ((ocoms_adjacency_list_t *) item)->vertex->hash_vertex;
+    }
+    for (; item != ocoms_list_get_end(graph->adjacency_list); item = ocoms_list_get_next(item)) {
+        aj_list = (ocoms_adjacency_list_t *) item;
+        if (aj_list->vertex->hash_vertex != graph->index_hash) {
+            graph->index_hash = NULL;
+            return OCOMS_ERR_BAD_PARAM;
+        }
+    }
+
+    graph->vertex_index = OBJ_NEW(ocoms_hash_table_t);
+    if (NULL == graph->vertex_index) {
+        graph->index_hash = NULL;
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    rc = ocoms_hash_table_init(graph->vertex_index, 2 * graph->number_of_vertices + 32);
+    for (item = ocoms_list_get_first(graph->adjacency_list);
+         OCOMS_SUCCESS == rc && item != ocoms_list_get_end(graph->adjacency_list);
+         item = ocoms_list_get_next(item)) {
+        aj_list = (ocoms_adjacency_list_t *) item;
+        rc = vertex_index_insert(graph, aj_list->vertex);
+    }
+    if (OCOMS_SUCCESS != rc) {
+        vertex_index_drop(graph);
+    }
+    return rc;
+}
+
 /**
  * This graph API returns an array of pointers of all the
  * vertices in the graph.
@@ -557,6 +770,20 @@ int ocoms_graph_get_adjacent_vertices(ocoms_graph_t *graph, ocoms_graph_vertex_t
         OCOMS_OUTPUT((0,"Vertex %p not in the graph %p\n", (void *)vertex, (void *)graph));
         return 0;
     }
+    /**
+     * in a frozen graph, copy the contiguous edges of the vertex.
+     */
+    if (NULL != graph->csr) {
+        ocoms_graph_csr_t *csr = graph->csr;
+        int e;
+
+        for (e = csr->offsets[vertex->index]; e < csr->offsets[vertex->index + 1]; e++) {
+            distance_from.vertex = csr->vertices[csr->targets[e]];
+            distance_from.weight = csr->weights[e];
+            ocoms_value_array_append_item(adjacents, &distance_from);
+        }
+        return csr->offsets[vertex->index + 1] - csr->offsets[vertex->index];
+    }
     /**
      * find the adjacency list that this vertex belongs to
      */
@@ -589,10 +816,9 @@ int ocoms_graph_get_adjacent_vertices(ocoms_graph_t *graph, ocoms_graph_vertex_t
 
 uint32_t ocoms_graph_spf(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex1, ocoms_graph_vertex_t *vertex2)
 {
-    ocoms_value_array_t *distance_array;
-    uint32_t items_in_distance_array, spf = DISTANCE_INFINITY;
-    vertex_distance_from_t *vertex_distance;
-    uint32_t i;
+    ocoms_graph_csr_t *csr;
+    uint32_t *distance, spf = DISTANCE_INFINITY;
+    bool temporary;
 
     /**
      * Verify that the first vertex belongs to the graph.
@@ -609,24 +835,51 @@ uint32_t ocoms_graph_spf(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex1, oc
         return DISTANCE_INFINITY;
     }
     /**
-     * Run Dijkstra algorithm on the graph from the start vertex.
+     * The vertices keep the indices they got from the last CSR layout
+     * until the graph is changed, which also empties the cache.
      */
-    distance_array = OBJ_NEW(ocoms_value_array_t);
-    ocoms_value_array_init(distance_array, sizeof(vertex_distance_from_t));
-    ocoms_value_array_reserve(distance_array,50);
-    items_in_distance_array = ocoms_graph_dijkstra(graph, vertex1, distance_array);
+    OCOMS_THREAD_LOCK(&graph->spf_cache_lock);
+    if (NULL != graph->spf_cache && NULL != graph->spf_cache[vertex1->index]) {
+        spf = graph->spf_cache[vertex1->index][vertex2->index];
+        OCOMS_THREAD_UNLOCK(&graph->spf_cache_lock);
+        SPF_CACHE_COUNT(spf_cache_hits);
+        return spf;
+    }
+    OCOMS_THREAD_UNLOCK(&graph->spf_cache_lock);
+    SPF_CACHE_COUNT(spf_cache_misses);
     /**
-     * find the end vertex in the distance array that Dijkstra
-     * algorithm returned.
+     * Run Dijkstra algorithm on the CSR layout of the graph from the
+     * start vertex, read the distance of the end vertex, and keep
+     * all the distances for the next searches from this vertex, up to
+     * spf_cache_max sources.
      */
-    for (i = 0; i < items_in_distance_array; i++) {
-        vertex_distance = ocoms_value_array_get_item(distance_array, i);
-        if (vertex_distance->vertex == vertex2) {
-            spf = vertex_distance->weight;
-            break;
+    csr = graph_get_csr(graph, &temporary);
+    if (NULL == csr) {
+        return DISTANCE_INFINITY;
+    }
+    distance = (uint32_t *)malloc(csr->number_of_vertices * sizeof(uint32_t));
+    if (NULL != distance) {
+        if (OCOMS_SUCCESS == csr_dijkstra(csr, vertex1->index, distance, NULL)) {
+            spf = distance[vertex2->index];
+            OCOMS_THREAD_LOCK(&graph->spf_cache_lock);
+            if (NULL == graph->spf_cache && 0 < spf_cache_max) {
+                graph->spf_cache = (uint32_t **)calloc(csr->number_of_vertices, sizeof(uint32_t *));
+                graph->spf_cache_size = (NULL != graph->spf_cache) ? csr->number_of_vertices : 0;
+            }
+            /* a concurrent search from the same source may have cached it already */
+            if (NULL != graph->spf_cache && NULL == graph->spf_cache[vertex1->index] &&
+                graph->spf_cache_used < spf_cache_max) {
+                graph->spf_cache[vertex1->index] = distance;
+                graph->spf_cache_used++;
+                distance = NULL;
+            }
+            OCOMS_THREAD_UNLOCK(&graph->spf_cache_lock);
         }
+        free(distance);
+    }
+    if (temporary) {
+        free(csr);
     }
-    OBJ_RELEASE(distance_array);
     /* return the distance (weight) to the end vertex */
     return spf;
 }
@@ -679,13 +932,11 @@ static int compare_vertex_distance(const void *item1, const void *item2)
  */
 uint32_t ocoms_graph_dijkstra(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex, ocoms_value_array_t *distance_array)
 {
-    int graph_order;
-    vertex_distance_from_t *Q, *q_start, *current_vertex;
-    ocoms_list_item_t *adj_list_item;
-    ocoms_adjacency_list_t *adj_list;
-    int number_of_items_in_q;
-    int i;
-    uint32_t weight;
+    ocoms_graph_csr_t *csr;
+    vertex_distance_from_t *distances;
+    uint32_t *distance;
+    bool temporary;
+    int i, count = 0;
 
 
     /**
@@ -695,65 +946,388 @@ uint32_t ocoms_graph_dijkstra(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex
         OCOMS_OUTPUT((0,"opal:graph:dijkstra: vertex %p not in the graph %p\n",(void *)vertex,(void *)graph));
         return 0;
     }
-    /* get the order of the graph and allocate a working queue accordingly */
-    graph_order = ocoms_graph_get_order(graph);
-    Q = (vertex_distance_from_t *)malloc(graph_order * sizeof(vertex_distance_from_t));
-    /* assign a pointer to the start of the queue */
-    q_start = Q;
-    /* run on all the vertices of the graph */
-    for (adj_list_item = ocoms_list_get_first(graph->adjacency_list), i=0;
-         adj_list_item != ocoms_list_get_end(graph->adjacency_list);
-         adj_list_item  = ocoms_list_get_next(adj_list_item), i++) {
-        adj_list = (ocoms_adjacency_list_t *)adj_list_item;
-        /* insert the vertices pointes to the working queue */
-        Q[i].vertex = adj_list->vertex;
-        /**
-         * assign an infinity distance to all the vertices in the queue
-         * except the reference vertex which its distance should be 0.
-         */
-        if (Q[i].vertex == vertex) {
-            Q[i].weight = 0;
+    csr = graph_get_csr(graph, &temporary);
+    if (NULL == csr) {
+        return 0;
+    }
+    distance = (uint32_t *)malloc(csr->number_of_vertices * sizeof(uint32_t));
+    distances = (vertex_distance_from_t *)malloc(csr->number_of_vertices * sizeof(vertex_distance_from_t));
+    if (NULL != distance && NULL != distances &&
+        OCOMS_SUCCESS == csr_dijkstra(csr, vertex->index, distance, NULL)) {
+        /* all the vertices but the reference one, sorted by distance */
+        for (i = 0; i < csr->number_of_vertices; i++) {
+            if (i != vertex->index) {
+                distances[count].vertex = csr->vertices[i];
+                distances[count].weight = distance[i];
+                count++;
+            }
         }
-        else {
-            Q[i].weight = DISTANCE_INFINITY;
+        qsort(distances, count, sizeof(vertex_distance_from_t), compare_vertex_distance);
+        ocoms_value_array_append_items(distance_array, distances, count);
+    }
+    free(distance);
+    free(distances);
+    if (temporary) {
+        free(csr);
+    }
+    /* assign the distance array size. */
+    return count;
+}
+
+/*
+ * The queue of Dijkstra algorithm is a binary min-heap of vertex
+ * indices, ordered by distance. position[] tells where each vertex is
+ * in the heap, or whether it was never queued or is already done, so
+ * that shortening the distance of a queued vertex is a sift up.
+ */
+#define HEAP_NEVER_QUEUED -1
+#define HEAP_DONE         -2
+
+static inline void heap_sift_up(int *heap, int *position, const uint32_t *distance, int i)
+{
+    int vertex = heap[i], parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (distance[heap[parent]] <= distance[vertex]) {
+            break;
         }
+        heap[i] = heap[parent];
+        position[heap[i]] = i;
+        i = parent;
     }
-    number_of_items_in_q = i;
-    /* sort the working queue according the distance from the reference vertex */
-    qsort(q_start, number_of_items_in_q, sizeof(vertex_distance_from_t), compare_vertex_distance);
-    /* while the working queue is not empty */
-    while (number_of_items_in_q > 0) {
-        /* start to work with the first vertex in the working queue */
-        current_vertex = q_start;
-        /* remove the first vertex from the queue */
-        q_start++;
-        /* decrees the number of vertices in the queue */
-        number_of_items_in_q--;
-        /* find the distance of all other vertices in the queue from the first vertex in the queue */
-        for (i = 0; i < number_of_items_in_q; i++) {
-            weight = ocoms_graph_adjacent(graph, current_vertex->vertex, q_start[i].vertex);
-            /**
-             * if the distance from the first vertex in the queue to the I
-             * vertex in the queue plus the distance of the first vertex in
-             * the queue from the referenced vertex is smaller than the
-             * distance of the I vertex from the referenced vertex, assign
-             * the lower distance to the I vertex.
-             */
-            if (current_vertex->weight + weight < q_start[i].weight) {
-                q_start[i].weight = weight + current_vertex->weight;
+    heap[i] = vertex;
+    position[vertex] = i;
+}
+
+static inline void heap_sift_down(int *heap, int *position, const uint32_t *distance,
+                                  int i, int size)
+{
+    int vertex = heap[i], child;
+
+    while ((child = 2 * i + 1) < size) {
+        if (child + 1 < size && distance[heap[child + 1]] < distance[heap[child]]) {
+            child++;
+        }
+        if (distance[vertex] <= distance[heap[child]]) {
+            break;
+        }
+        heap[i] = heap[child];
+        position[heap[i]] = i;
+        i = child;
+    }
+    heap[i] = vertex;
+    position[vertex] = i;
+}
+
+/**
+ * Dijkstra algorithm over a CSR layout: the distance from the source
+ * vertex to every vertex, by index, in O((V + E) log V).
+ *
+ * @param csr The layout.
+ * @param source The index of the source vertex.
+ * @param distance An array of csr->number_of_vertices distances.
+ * @param work 2 * csr->number_of_vertices integers of scratch space,
+ *             or NULL to allocate them.
+ *
+ * @return int OCOMS_SUCCESS or OCOMS_ERR_OUT_OF_RESOURCE
+ */
+static int csr_dijkstra(ocoms_graph_csr_t *csr, int source, uint32_t *distance, int *work)
+{
+    int *heap, *position;
+    int i, e, current, target, size, n = csr->number_of_vertices;
+    uint64_t weight;
+
+    heap = (NULL != work) ? work : (int *)malloc(2 * n * sizeof(int));
+    if (NULL == heap) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    position = heap + n;
+    for (i = 0; i < n; i++) {
+        distance[i] = DISTANCE_INFINITY;
+        position[i] = HEAP_NEVER_QUEUED;
+    }
+    distance[source] = 0;
+    heap[0] = source;
+    position[source] = 0;
+    size = 1;
+
+    while (size > 0) {
+        /* take the closest queued vertex */
+        current = heap[0];
+        position[current] = HEAP_DONE;
+        if (--size > 0) {
+            heap[0] = heap[size];
+            heap_sift_down(heap, position, distance, 0, size);
+        }
+        /* relax the edges starting at it */
+        for (e = csr->offsets[current]; e < csr->offsets[current + 1]; e++) {
+            target = csr->targets[e];
+            weight = (uint64_t)distance[current] + csr->weights[e];
+            if (HEAP_DONE == position[target] || weight >= distance[target]) {
+                continue;
             }
+            distance[target] = (uint32_t)weight;
+            if (HEAP_NEVER_QUEUED == position[target]) {
+                heap[size] = target;
+                position[target] = size++;
+            }
+            heap_sift_up(heap, position, distance, position[target]);
         }
-        /* sort again the working queue */
-        qsort(q_start, number_of_items_in_q, sizeof(vertex_distance_from_t), compare_vertex_distance);
     }
-    /* copy the working queue the the returned distance array */
-    for (i = 0; i < graph_order-1; i++) {
-        ocoms_value_array_append_item(distance_array, (void *)&(Q[i+1]));
+    if (NULL == work) {
+        free(heap);
+    }
+    return OCOMS_SUCCESS;
+}
+
+
+/**
+ * The state shared by the threads of ocoms_graph_all_pairs, which take
+ * the sources one at a time.
+ */
+struct all_pairs_t {
+    ocoms_graph_csr_t *csr;
+    uint32_t          *distances;
+    volatile int32_t   next_source;
+    volatile int32_t   rc;
+};
+
+static void all_pairs_run(struct all_pairs_t *all_pairs)
+{
+    int n = all_pairs->csr->number_of_vertices;
+    int *work;
+    int32_t source;
+
+    work = (int *)malloc(2 * n * sizeof(int));
+    if (NULL == work) {
+        all_pairs->rc = OCOMS_ERR_OUT_OF_RESOURCE;
+        return;
+    }
+    for (;;) {
+#if OCOMS_ENABLE_MULTI_THREADS
+        source = ocoms_atomic_add_32(&all_pairs->next_source, 1) - 1;
+#else
+        source = all_pairs->next_source++;
+#endif
+        if (source >= n) {
+            break;
+        }
+        csr_dijkstra(all_pairs->csr, source, all_pairs->distances + (size_t)source * n, work);
+    }
+    free(work);
+}
+
+static void *all_pairs_thread(ocoms_object_t *object)
+{
+    ocoms_thread_t *thread = (ocoms_thread_t *)object;
+
+    all_pairs_run((struct all_pairs_t *)thread->t_arg);
+    return NULL;
+}
+
+/**
+ * This graph API computes the distance between every two vertices.
+ *
+ * @param graph
+ * @param num_threads The number of threads to use, including the
+ *                    calling one.
+ * @param distances Set to the distance matrix.
+ *
+ * @return int OCOMS_SUCCESS or OCOMS_ERR_OUT_OF_RESOURCE
+ */
+int ocoms_graph_all_pairs(ocoms_graph_t *graph, int num_threads, uint32_t **distances)
+{
+    struct all_pairs_t all_pairs;
+    ocoms_thread_t *threads = NULL;
+    int i, n, started = 0;
+    bool temporary;
+
+    *distances = NULL;
+    all_pairs.csr = graph_get_csr(graph, &temporary);
+    if (NULL == all_pairs.csr) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    n = all_pairs.csr->number_of_vertices;
+    if (0 == n) {
+        if (temporary) {
+            free(all_pairs.csr);
+        }
+        return OCOMS_SUCCESS;
+    }
+    all_pairs.distances = (uint32_t *)malloc((size_t)n * n * sizeof(uint32_t));
+    all_pairs.next_source = 0;
+    all_pairs.rc = (NULL != all_pairs.distances) ? OCOMS_SUCCESS : OCOMS_ERR_OUT_OF_RESOURCE;
+
+#if OCOMS_ENABLE_MULTI_THREADS
+    /* the calling thread works too; when a thread can not be started,
+     * the others do its share */
+    if (num_threads > n) {
+        num_threads = n;
+    }
+    if (OCOMS_SUCCESS == all_pairs.rc && num_threads > 1) {
+        threads = (ocoms_thread_t *)malloc((num_threads - 1) * sizeof(ocoms_thread_t));
+        for (i = 0; NULL != threads && i < num_threads - 1; i++) {
+            OBJ_CONSTRUCT(&threads[i], ocoms_thread_t);
+            threads[i].t_run = all_pairs_thread;
+            threads[i].t_arg = &all_pairs;
+            if (OCOMS_SUCCESS != ocoms_thread_start(&threads[i])) {
+                OBJ_DESTRUCT(&threads[i]);
+                break;
+            }
+            started++;
+        }
+    }
+#endif
+    if (OCOMS_SUCCESS == all_pairs.rc) {
+        all_pairs_run(&all_pairs);
+    }
+    for (i = 0; i < started; i++) {
+        ocoms_thread_join(&threads[i], NULL);
+        OBJ_DESTRUCT(&threads[i]);
+    }
+    free(threads);
+    if (temporary) {
+        free(all_pairs.csr);
+    }
+
+    if (OCOMS_SUCCESS != all_pairs.rc) {
+        free(all_pairs.distances);
+        return all_pairs.rc;
+    }
+    *distances = all_pairs.distances;
+    return OCOMS_SUCCESS;
+}
+
+
+/**
+ * Compile the adjacency lists of a graph into a CSR layout, allocated
+ * as a single block. Edges to vertices which are not in the graph are
+ * left out.
+ *
+ * @param graph
+ *
+ * @return ocoms_graph_csr_t* The layout, or NULL if it could not be
+ *         allocated.
+ */
+static ocoms_graph_csr_t *graph_build_csr(ocoms_graph_t *graph)
+{
+    ocoms_graph_csr_t *csr;
+    ocoms_adjacency_list_t *aj_list;
+    ocoms_list_item_t *aj_list_item, *edge_item;
+    ocoms_graph_edge_t *edge;
+    size_t number_of_vertices, number_of_edges = 0;
+    int i, e;
+
+    /* count the edges actually in the lists */
+    number_of_vertices = ocoms_list_get_size(graph->adjacency_list);
+    for (aj_list_item = ocoms_list_get_first(graph->adjacency_list);
+         aj_list_item != ocoms_list_get_end(graph->adjacency_list);
+         aj_list_item  = ocoms_list_get_next(aj_list_item)) {
+        aj_list = (ocoms_adjacency_list_t *) aj_list_item;
+        number_of_edges += ocoms_list_get_size(aj_list->edges);
+    }
+    csr = (ocoms_graph_csr_t *)malloc(sizeof(ocoms_graph_csr_t) +
+                                      number_of_vertices * sizeof(ocoms_graph_vertex_t *) +
+                                      (number_of_vertices + 1) * sizeof(int) +
+                                      number_of_edges * (sizeof(int) + sizeof(uint32_t)));
+    if (NULL == csr) {
+        return NULL;
+    }
+    csr->vertices = (ocoms_graph_vertex_t **)(csr + 1);
+    csr->offsets = (int *)(csr->vertices + number_of_vertices);
+    csr->targets = csr->offsets + number_of_vertices + 1;
+    csr->weights = (uint32_t *)(csr->targets + number_of_edges);
+    csr->number_of_vertices = (int)number_of_vertices;
+
+    /* number the vertices */
+    for (aj_list_item = ocoms_list_get_first(graph->adjacency_list), i = 0;
+         aj_list_item != ocoms_list_get_end(graph->adjacency_list);
+         aj_list_item  = ocoms_list_get_next(aj_list_item), i++) {
+        aj_list = (ocoms_adjacency_list_t *) aj_list_item;
+        aj_list->vertex->index = i;
+        csr->vertices[i] = aj_list->vertex;
+    }
+    /* lay out the edges of each vertex, in list order */
+    for (aj_list_item = ocoms_list_get_first(graph->adjacency_list), i = 0, e = 0;
+         aj_list_item != ocoms_list_get_end(graph->adjacency_list);
+         aj_list_item  = ocoms_list_get_next(aj_list_item), i++) {
+        aj_list = (ocoms_adjacency_list_t *) aj_list_item;
+        csr->offsets[i] = e;
+        for (edge_item = ocoms_list_get_first(aj_list->edges);
+             edge_item != ocoms_list_get_end(aj_list->edges);
+             edge_item  = ocoms_list_get_next(edge_item)) {
+            edge = (ocoms_graph_edge_t *)edge_item;
+            if (graph != edge->end->in_graph) {
+                continue;
+            }
+            csr->targets[e] = edge->end->index;
+            csr->weights[e] = edge->weight;
+            e++;
+        }
+    }
+    csr->offsets[i] = e;
+    csr->number_of_edges = e;
+    return csr;
+}
+
+/**
+ * The CSR layout of a frozen graph, or a temporary one that the caller
+ * has to free.
+ */
+static ocoms_graph_csr_t *graph_get_csr(ocoms_graph_t *graph, bool *temporary)
+{
+    *temporary = (NULL == graph->csr);
+    return *temporary ? graph_build_csr(graph) : graph->csr;
+}
+
+/**
+ * This graph API compiles the graph into the CSR layout.
+ *
+ * @param graph
+ *
+ * @return int OCOMS_SUCCESS or OCOMS_ERR_OUT_OF_RESOURCE
+ */
+int ocoms_graph_freeze(ocoms_graph_t *graph)
+{
+    ocoms_graph_thaw(graph);
+    graph->csr = graph_build_csr(graph);
+    return (NULL != graph->csr) ? OCOMS_SUCCESS : OCOMS_ERR_OUT_OF_RESOURCE;
+}
+
+/**
+ * Called by all the APIs which change the graph: drop the CSR layout
+ * and the distances cached by ocoms_graph_spf.
+ */
+static void graph_changed(ocoms_graph_t *graph)
+{
+    int i;
+
+    ocoms_graph_thaw(graph);
+    OCOMS_THREAD_LOCK(&graph->spf_cache_lock);
+    if (NULL != graph->spf_cache) {
+        for (i = 0; i < graph->spf_cache_size; i++) {
+            free(graph->spf_cache[i]);
+        }
+        free(graph->spf_cache);
+        graph->spf_cache = NULL;
+        graph->spf_cache_size = 0;
+        graph->spf_cache_used = 0;
+    }
+    OCOMS_THREAD_UNLOCK(&graph->spf_cache_lock);
+}
+
+/**
+ * This graph API releases the CSR layout of a frozen graph.
+ *
+ * @param graph
+ */
+void ocoms_graph_thaw(ocoms_graph_t *graph)
+{
+    if (NULL != graph->csr) {
+        free(graph->csr);
+        graph->csr = NULL;
     }
-    /* free the working queue */
-    free(Q);
-    /* assign the distance array size. */
-    return graph_order - 1;
 }
 
 
@@ -799,6 +1373,7 @@ void ocoms_graph_duplicate(ocoms_graph_t **dest, ocoms_graph_t *src)
         vertex->free_vertex_data = aj_list->vertex->free_vertex_data;
         vertex->print_vertex = aj_list->vertex->print_vertex;
         vertex->compare_vertex = aj_list->vertex->compare_vertex;
+        vertex->hash_vertex = aj_list->vertex->hash_vertex;
         vertex->in_graph = *dest;
         /* add the new vertex to the new graph */
         ocoms_graph_add_vertex(*dest, vertex);
@@ -829,6 +1404,45 @@ void ocoms_graph_duplicate(ocoms_graph_t **dest, ocoms_graph_t *src)
     }
 }
 
+/**
+ * Register the parameters and the performance variables of the graphs.
+ */
+int ocoms_graph_register_params(void)
+{
+    int ret;
+
+    ret = ocoms_mca_base_var_register ("ocoms", "util", "graph", "spf_cache_max",
+                                       "Maximum number of source vertices whose distances ocoms_graph_spf "
+                                       "keeps per graph, each costing 4 bytes per vertex (0 disables the cache)",
+                                       MCA_BASE_VAR_TYPE_INT, NULL, 0, MCA_BASE_VAR_FLAG_SETTABLE, OCOMS_INFO_LVL_6,
+                                       MCA_BASE_VAR_SCOPE_LOCAL, &spf_cache_max);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_pvar_register ("ocoms", "util", "graph", "spf_cache_hits",
+                                        "Number of ocoms_graph_spf calls answered from the distances cached for the source vertex",
+                                        OCOMS_INFO_LVL_9, MCA_BASE_PVAR_CLASS_COUNTER,
+                                        MCA_BASE_VAR_TYPE_UNSIGNED_LONG_LONG, NULL, MCA_BASE_VAR_BIND_NO_OBJECT,
+                                        MCA_BASE_PVAR_FLAG_READONLY | MCA_BASE_PVAR_FLAG_CONTINUOUS,
+                                        NULL, NULL, NULL, &spf_cache_hits);
+    if (0 > ret) {
+        return ret;
+    }
+
+    ret = ocoms_mca_base_pvar_register ("ocoms", "util", "graph", "spf_cache_misses",
+                                        "Number of ocoms_graph_spf calls which had to search the graph",
+                                        OCOMS_INFO_LVL_9, MCA_BASE_PVAR_CLASS_COUNTER,
+                                        MCA_BASE_VAR_TYPE_UNSIGNED_LONG_LONG, NULL, MCA_BASE_VAR_BIND_NO_OBJECT,
+                                        MCA_BASE_PVAR_FLAG_READONLY | MCA_BASE_PVAR_FLAG_CONTINUOUS,
+                                        NULL, NULL, NULL, &spf_cache_misses);
+    if (0 > ret) {
+        return ret;
+    }
+
+    return OCOMS_SUCCESS;
+}
+
 /**
  * This graph API prints a graph - mostly for debug uses.
  * @param graph
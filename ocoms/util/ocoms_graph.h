@@ -25,6 +25,12 @@
  * The graph is a list of vertices. The graph is a weighted directional graph.
  * Each vertex contains a pointer to a vertex data. 
  * This pointer can point to the structure that this vertex belongs to.    
+ *
+ * A graph which is built once and queried often can be frozen: this
+ * compiles the adjacency lists into a compressed sparse row (CSR)
+ * layout, with the edges of all the vertices stored contiguously, on
+ * which the read-only queries then run. Any change to the graph thaws
+ * it again.
  */
 #ifndef OCOMS_GRAPH_H
 #define OCOMS_GRAPH_H
@@ -36,6 +42,8 @@
 #include "ocoms/util/ocoms_list.h"
 #include "ocoms/util/ocoms_pointer_array.h"
 #include "ocoms/util/ocoms_value_array.h"
+#include "ocoms/util/ocoms_hash_table.h"
+#include "ocoms/threads/mutex.h"
 
 BEGIN_C_DECLS
 
@@ -92,6 +100,14 @@ typedef void *(*ocoms_graph_alloc_vertex_data)(void);
  */
 typedef int  (*ocoms_graph_compare_vertex_data)(void *vertex_data1, void *vertex_data2);
 
+/**
+ * Hash a vertex data, for the vertex index of the graph. Vertices
+ * data which compare equal must have the same hash.
+ *
+ * @param vertex_data
+ */
+typedef uint64_t (*ocoms_graph_hash_vertex_data)(void *vertex_data);
+
 /**
  * print a vertex data.
  * 
@@ -117,6 +133,12 @@ struct ocoms_graph_vertex_t {
     ocoms_graph_alloc_vertex_data alloc_vertex_data;/* A function to allocate vertex data */
     ocoms_graph_compare_vertex_data compare_vertex; /* A function to compare between two vertices data */
     ocoms_graph_print_vertex        print_vertex;   /* A function to print vertex data */
+    ocoms_graph_hash_vertex_data    hash_vertex;    /* A function to hash vertex data, or NULL to index */
+                                                    /* the vertex by its vertex data pointer */
+    struct ocoms_graph_vertex_t   *index_next; /* The next vertex with the same key in the vertex index. */
+                                               /* This pointer is for internal uses. */
+    int                           index;    /* The position of the vertex in the CSR layout. */
+                                            /* This field is for internal uses. */
 };
 
 /**
@@ -161,6 +183,25 @@ struct ocoms_graph_edge_t {
 typedef struct ocoms_graph_edge_t ocoms_graph_edge_t;
 
 
+/**
+ * The compressed sparse row layout of a graph. The edges starting at
+ * vertices[i] are edges offsets[i] to offsets[i+1] - 1, each one given
+ * by the index of its end vertex and its weight.
+ */
+struct ocoms_graph_csr_t {
+    int                    number_of_vertices;
+    int                    number_of_edges;
+    ocoms_graph_vertex_t **vertices; /* The vertices, by index */
+    int                   *offsets;  /* number_of_vertices + 1 offsets into the edges */
+    int                   *targets;  /* The index of the end vertex of each edge */
+    uint32_t              *weights;  /* The weight of each edge */
+};
+
+/**
+ * A type for the CSR layout
+ */
+typedef struct ocoms_graph_csr_t ocoms_graph_csr_t;
+
 /**
  * A graph class.
  */
@@ -169,6 +210,14 @@ struct ocoms_graph_t {
     ocoms_list_t         *adjacency_list;
     int                 number_of_edges;
     int                 number_of_vertices;
+    ocoms_graph_csr_t   *csr;           /* The CSR layout while the graph is frozen, or NULL */
+    uint32_t           **spf_cache;     /* The distances from the sources already searched by */
+                                        /* ocoms_graph_spf, by vertex index, or NULL */
+    int                 spf_cache_size; /* The number of entries in spf_cache */
+    int                 spf_cache_used; /* The number of sources with cached distances */
+    ocoms_mutex_t       spf_cache_lock; /* Protects spf_cache against concurrent searches */
+    ocoms_hash_table_t  *vertex_index;  /* The vertices by the hash of their data, or NULL */
+    ocoms_graph_hash_vertex_data index_hash; /* The hash function of the indexed vertices */
 };
 
 /**
@@ -268,6 +317,25 @@ OCOMS_DECLSPEC int ocoms_graph_get_order(ocoms_graph_t *graph);
  */
 OCOMS_DECLSPEC int ocoms_graph_get_size(ocoms_graph_t *graph);
 
+/**
+ * This graph API builds a hash index of the vertices of the graph,
+ * which ocoms_graph_find_vertex then uses instead of scanning all the
+ * vertices. The index is kept up to date by ocoms_graph_add_vertex and
+ * ocoms_graph_remove_vertex.
+ *
+ * Each vertex is indexed by the hash_vertex function of its vertex
+ * data, and all the vertices of the graph must have the same one. A
+ * vertex without hash function is indexed by its vertex_data pointer,
+ * and is then only found when searching for that very pointer. Adding
+ * a vertex with another hash function drops the index.
+ *
+ * @param graph
+ *
+ * @return int OCOMS_SUCCESS, OCOMS_ERR_BAD_PARAM if the vertices do
+ *         not have the same hash function, or OCOMS_ERR_OUT_OF_RESOURCE
+ */
+OCOMS_DECLSPEC int ocoms_graph_index_vertices(ocoms_graph_t *graph);
+
 /**
  * This graph API finds a vertex in the graph according the
  * vertex data.
@@ -320,7 +388,9 @@ OCOMS_DECLSPEC int ocoms_graph_get_adjacent_vertices(ocoms_graph_t *graph, ocoms
 OCOMS_DECLSPEC void ocoms_graph_duplicate(ocoms_graph_t **dest, ocoms_graph_t *src);
 
 /**
- * This graph API finds the shortest path between two vertices.
+ * This graph API finds the shortest path between two vertices. The
+ * distances from each source vertex are kept until the graph is
+ * changed, so that later calls from the same source are lookups.
  * 
  * @param graph
  * @param vertex1 The start vertex.
@@ -344,6 +414,62 @@ OCOMS_DECLSPEC uint32_t ocoms_graph_spf(ocoms_graph_t *graph, ocoms_graph_vertex
  */
 OCOMS_DECLSPEC uint32_t ocoms_graph_dijkstra(ocoms_graph_t *graph, ocoms_graph_vertex_t *vertex, ocoms_value_array_t *distance_array);
 
+/**
+ * This graph API computes the distance between every two vertices of
+ * the graph, running Dijkstra algorithm from the different sources in
+ * parallel.
+ *
+ * @param graph
+ * @param num_threads The number of threads to use, including the
+ *                    calling one.
+ * @param distances Set to a newly allocated matrix of order * order
+ *                  distances, which the caller should free.
+ *                  distances[i * order + j] is the distance from
+ *                  vertex i to vertex j, the vertices being numbered
+ *                  in the order of ocoms_graph_get_graph_vertices.
+ *                  Set to NULL for an empty graph.
+ *
+ * @return int OCOMS_SUCCESS or OCOMS_ERR_OUT_OF_RESOURCE
+ */
+OCOMS_DECLSPEC int ocoms_graph_all_pairs(ocoms_graph_t *graph, int num_threads, uint32_t **distances);
+
+/**
+ * This graph API compiles the graph into the CSR layout, which the
+ * read-only APIs (adjacent, get_adjacent_vertices, spf, dijkstra) use
+ * until the graph is changed. Freezing a frozen graph rebuilds the
+ * layout.
+ *
+ * @param graph
+ *
+ * @return int OCOMS_SUCCESS or OCOMS_ERR_OUT_OF_RESOURCE, in which
+ *         case the graph is left thawed.
+ */
+OCOMS_DECLSPEC int ocoms_graph_freeze(ocoms_graph_t *graph);
+
+/**
+ * This graph API releases the CSR layout of a frozen graph. It is
+ * called by all the APIs which change the graph.
+ *
+ * @param graph
+ */
+OCOMS_DECLSPEC void ocoms_graph_thaw(ocoms_graph_t *graph);
+
+/**
+ * This graph API tells whether the graph is frozen.
+ *
+ * @param graph
+ */
+static inline bool ocoms_graph_is_frozen(ocoms_graph_t *graph)
+{
+    return NULL != graph->csr;
+}
+
+/**
+ * Register the parameters and performance variables of the graphs: the
+ * size bound of the spf cache, and its hits and misses.
+ */
+OCOMS_DECLSPEC int ocoms_graph_register_params(void);
+
 /**
  * This graph API prints a graph - mostly for debug uses.
  * @param graph
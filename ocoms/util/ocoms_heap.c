@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stdlib.h>
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_heap.h"
+
+#define PARENT(i)       (((i) - 1) / OCOMS_HEAP_ARITY)
+#define FIRST_CHILD(i)  ((i) * OCOMS_HEAP_ARITY + 1)
+
+/* initial number of slots allocated by the first insertion */
+#define HEAP_INITIAL_CAPACITY 16
+
+static void ocoms_heap_construct(ocoms_heap_t *heap);
+static void ocoms_heap_destruct(ocoms_heap_t *heap);
+
+OBJ_CLASS_INSTANCE(ocoms_heap_t, ocoms_object_t,
+                   ocoms_heap_construct, ocoms_heap_destruct);
+
+
+static void ocoms_heap_construct(ocoms_heap_t *heap)
+{
+    heap->items = NULL;
+    heap->size = 0;
+    heap->capacity = 0;
+    heap->min_key = OCOMS_HEAP_KEY_MAX;
+}
+
+static void ocoms_heap_destruct(ocoms_heap_t *heap)
+{
+    ocoms_heap_clear(heap);
+    if (NULL != heap->items) {
+        free(heap->items);
+        heap->items = NULL;
+    }
+    heap->capacity = 0;
+}
+
+/* publish the smallest key for the lock-free readers */
+static inline void update_min_key(ocoms_heap_t *heap)
+{
+    heap->min_key = (0 == heap->size) ? OCOMS_HEAP_KEY_MAX : heap->items[0]->key;
+}
+
+/* moves the item at index up until its parent is not greater, and
+ * stores it at its final place */
+static void sift_up(ocoms_heap_t *heap, size_t index)
+{
+    ocoms_heap_item_t **items = heap->items;
+    ocoms_heap_item_t *item = items[index];
+    size_t parent;
+
+    while (index > 0) {
+        parent = PARENT(index);
+        if (items[parent]->key <= item->key) {
+            break;
+        }
+        items[index] = items[parent];
+        items[index]->index = index;
+        index = parent;
+    }
+    items[index] = item;
+    item->index = index;
+}
+
+/* moves the item at index down until none of its children is smaller,
+ * and stores it at its final place */
+static void sift_down(ocoms_heap_t *heap, size_t index)
+{
+    ocoms_heap_item_t **items = heap->items;
+    ocoms_heap_item_t *item = items[index];
+    size_t size = heap->size;
+    size_t child, last, smallest;
+
+    for (;;) {
+        child = FIRST_CHILD(index);
+        if (child >= size) {
+            break;
+        }
+        last = child + OCOMS_HEAP_ARITY;
+        if (last > size) {
+            last = size;
+        }
+        smallest = child;
+        for (++child; child < last; ++child) {
+            if (items[child]->key < items[smallest]->key) {
+                smallest = child;
+            }
+        }
+        if (items[smallest]->key >= item->key) {
+            break;
+        }
+        items[index] = items[smallest];
+        items[index]->index = index;
+        index = smallest;
+    }
+    items[index] = item;
+    item->index = index;
+}
+
+/* restores the heap order around an item whose key changed */
+static void sift(ocoms_heap_t *heap, size_t index)
+{
+    if (index > 0 && heap->items[index]->key < heap->items[PARENT(index)]->key) {
+        sift_up(heap, index);
+    } else {
+        sift_down(heap, index);
+    }
+}
+
+int ocoms_heap_reserve(ocoms_heap_t *heap, size_t capacity)
+{
+    ocoms_heap_item_t **items;
+
+    if (capacity <= heap->capacity) {
+        return OCOMS_SUCCESS;
+    }
+    items = (ocoms_heap_item_t **) realloc(heap->items, capacity * sizeof(*items));
+    if (NULL == items) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    heap->items = items;
+    heap->capacity = capacity;
+    return OCOMS_SUCCESS;
+}
+
+int ocoms_heap_insert(ocoms_heap_t *heap, ocoms_heap_item_t *item)
+{
+    int rc;
+
+    if (ocoms_heap_item_is_queued(item)) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+    if (heap->size == heap->capacity) {
+        rc = ocoms_heap_reserve(heap, (0 == heap->capacity) ?
+                                HEAP_INITIAL_CAPACITY : 2 * heap->capacity);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+    }
+
+    heap->items[heap->size] = item;
+    sift_up(heap, heap->size++);
+    update_min_key(heap);
+    return OCOMS_SUCCESS;
+}
+
+/* takes out the item at index, filling the hole with the last item */
+static void remove_at(ocoms_heap_t *heap, size_t index)
+{
+    ocoms_heap_item_t *item = heap->items[index];
+    size_t last = --heap->size;
+
+    item->index = OCOMS_HEAP_NOT_QUEUED;
+    if (index != last) {
+        heap->items[index] = heap->items[last];
+        sift(heap, index);
+    }
+    update_min_key(heap);
+}
+
+ocoms_heap_item_t *ocoms_heap_remove_min(ocoms_heap_t *heap)
+{
+    ocoms_heap_item_t *item;
+
+    if (0 == heap->size) {
+        return NULL;
+    }
+    item = heap->items[0];
+    remove_at(heap, 0);
+    return item;
+}
+
+/* whether the item is queued in this very heap */
+static inline bool heap_owns(ocoms_heap_t *heap, ocoms_heap_item_t *item)
+{
+    return item->index < heap->size && heap->items[item->index] == item;
+}
+
+int ocoms_heap_remove(ocoms_heap_t *heap, ocoms_heap_item_t *item)
+{
+    if (!heap_owns(heap, item)) {
+        return OCOMS_ERR_NOT_FOUND;
+    }
+    remove_at(heap, item->index);
+    return OCOMS_SUCCESS;
+}
+
+int ocoms_heap_update_key(ocoms_heap_t *heap, ocoms_heap_item_t *item, uint64_t key)
+{
+    if (!heap_owns(heap, item)) {
+        return OCOMS_ERR_NOT_FOUND;
+    }
+    item->key = key;
+    sift(heap, item->index);
+    update_min_key(heap);
+    return OCOMS_SUCCESS;
+}
+
+void ocoms_heap_clear(ocoms_heap_t *heap)
+{
+    size_t i;
+
+    for (i = 0; i < heap->size; i++) {
+        heap->items[i]->index = OCOMS_HEAP_NOT_QUEUED;
+    }
+    heap->size = 0;
+    update_min_key(heap);
+}
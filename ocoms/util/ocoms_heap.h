@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/** @file
+ *
+ *     A priority queue stored as an intrusive d-ary min-heap
+ *
+ *     The items are ocoms_heap_item_t structures embedded in the
+ *     caller's own objects; each one carries its 64 bit key and its
+ *     current position in the heap, so that an item can be re-keyed or
+ *     removed from the middle of the heap in O(log n) without a search.
+ *     Several items may share the same key; their relative order is
+ *     unspecified.
+ *
+ *     The heap is not thread safe: callers serialize the modifications
+ *     themselves.  The smallest key is however mirrored in a separate
+ *     word, so ocoms_heap_peek_min_key can be called without the lock,
+ *     e.g. from a progress function checking whether any timer is due.
+ */
+
+#ifndef OCOMS_HEAP_H
+#define OCOMS_HEAP_H
+
+#include "ocoms/platform/ocoms_config.h"
+#include <stdlib.h>
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_object.h"
+
+BEGIN_C_DECLS
+
+/**
+ * Number of children of each node.  Four children keep the heap
+ * shallow while the children of a node still share a cache line.
+ */
+#define OCOMS_HEAP_ARITY 4
+
+/**
+ * Position of an item that is not in any heap
+ */
+#define OCOMS_HEAP_NOT_QUEUED ((size_t) -1)
+
+/**
+ * Key reported by ocoms_heap_peek_min_key for an empty heap
+ */
+#define OCOMS_HEAP_KEY_MAX UINT64_MAX
+
+/**
+ * An item of the heap, to be embedded in the caller's structure
+ */
+struct ocoms_heap_item_t {
+    uint64_t key;       /**< the priority, smaller keys come out first */
+    size_t index;       /**< position in the heap, or OCOMS_HEAP_NOT_QUEUED */
+};
+typedef struct ocoms_heap_item_t ocoms_heap_item_t;
+
+/**
+ * the data structure that holds all the needed information about the heap.
+ */
+struct ocoms_heap_t {
+    ocoms_object_t super;           /**< the parent class */
+    ocoms_heap_item_t **items;      /**< the items, in heap order */
+    size_t size;                    /**< the number of items */
+    size_t capacity;                /**< the number of allocated slots */
+    volatile uint64_t min_key;      /**< the key of items[0], or OCOMS_HEAP_KEY_MAX */
+};
+typedef struct ocoms_heap_t ocoms_heap_t;
+
+/** declare the heap as a class */
+OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_heap_t);
+
+/**
+  * initializes an item before it is first inserted
+  */
+static inline void ocoms_heap_item_init(ocoms_heap_item_t *item, uint64_t key)
+{
+    item->key = key;
+    item->index = OCOMS_HEAP_NOT_QUEUED;
+}
+
+/**
+  * returns whether the item currently belongs to a heap
+  */
+static inline bool ocoms_heap_item_is_queued(ocoms_heap_item_t *item)
+{
+    return OCOMS_HEAP_NOT_QUEUED != item->index;
+}
+
+/**
+  * reserves room for a number of items, so that inserting up to that
+  * many items does not allocate
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_OUT_OF_RESOURCE
+  */
+OCOMS_DECLSPEC int ocoms_heap_reserve(ocoms_heap_t *heap, size_t capacity);
+
+/**
+  * inserts an item, using its current key
+  *
+  * @param heap a pointer to the heap
+  * @param item an item which is not queued in any heap
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_BAD_PARAM if the item is already queued
+  * @retval OCOMS_ERR_OUT_OF_RESOURCE if unsuccessful, the heap is unchanged
+  */
+OCOMS_DECLSPEC int ocoms_heap_insert(ocoms_heap_t *heap, ocoms_heap_item_t *item);
+
+/**
+  * removes and returns the item with the smallest key
+  *
+  * @retval the item, which is no longer queued
+  * @retval NULL if the heap is empty
+  */
+OCOMS_DECLSPEC ocoms_heap_item_t *ocoms_heap_remove_min(ocoms_heap_t *heap);
+
+/**
+  * removes an arbitrary item from the heap
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_NOT_FOUND if the item is not queued in this heap
+  */
+OCOMS_DECLSPEC int ocoms_heap_remove(ocoms_heap_t *heap, ocoms_heap_item_t *item);
+
+/**
+  * changes the key of a queued item and restores the heap order.  The
+  * key may move in either direction, decreasing it being the usual
+  * case (e.g. Dijkstra's decrease-key).
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_NOT_FOUND if the item is not queued in this heap
+  */
+OCOMS_DECLSPEC int ocoms_heap_update_key(ocoms_heap_t *heap, ocoms_heap_item_t *item,
+                                         uint64_t key);
+
+/**
+  * removes all the items from the heap, marking them as not queued
+  */
+OCOMS_DECLSPEC void ocoms_heap_clear(ocoms_heap_t *heap);
+
+/**
+  * returns the item with the smallest key without removing it, or NULL
+  * if the heap is empty.  Must be called under the same serialization
+  * as the modifications.
+  */
+static inline ocoms_heap_item_t *ocoms_heap_peek(ocoms_heap_t *heap)
+{
+    return (0 == heap->size) ? NULL : heap->items[0];
+}
+
+/**
+  * returns the smallest key of the heap, or OCOMS_HEAP_KEY_MAX if it is
+  * empty.  This may be called concurrently with the modifications; the
+  * value is then a snapshot which may already be stale, which is enough
+  * to decide whether it is worth taking the lock.  On platforms without
+  * atomic 64 bit loads the snapshot may also be torn.
+  */
+static inline uint64_t ocoms_heap_peek_min_key(ocoms_heap_t *heap)
+{
+    return heap->min_key;
+}
+
+/**
+  * returns the number of items in the heap
+  */
+static inline size_t ocoms_heap_size(ocoms_heap_t *heap)
+{
+    return heap->size;
+}
+
+/**
+  * returns whether the heap is empty
+  */
+static inline bool ocoms_heap_is_empty(ocoms_heap_t *heap)
+{
+    return 0 == heap->size;
+}
+
+END_C_DECLS
+
+#endif /* OCOMS_HEAP_H */
@@ -230,31 +230,126 @@ ocoms_list_splice(ocoms_list_t *thislist, ocoms_list_item_t *pos,
 }
 
 
+/*
+ * Merge the two sorted, NULL terminated chains a and b (linked
+ * through ocoms_list_next only).  Ties are resolved in favor of a,
+ * which keeps the sort stable.  Returns the tail of the merged chain
+ * through *tail.
+ */
+static ocoms_list_item_t *
+ocoms_list_merge(ocoms_list_item_t *a, ocoms_list_item_t *b,
+                 ocoms_list_item_compare_fn_t compare,
+                 ocoms_list_item_t **tail)
+{
+    ocoms_list_item_t head, *last = &head;
+
+    while (NULL != a && NULL != b) {
+        if (compare(&a, &b) <= 0) {
+            last->ocoms_list_next = a;
+            last = a;
+            a = (ocoms_list_item_t *) a->ocoms_list_next;
+        } else {
+            last->ocoms_list_next = b;
+            last = b;
+            b = (ocoms_list_item_t *) b->ocoms_list_next;
+        }
+    }
+    last->ocoms_list_next = (NULL != a) ? a : b;
+    while (NULL != last->ocoms_list_next) {
+        last = (ocoms_list_item_t *) last->ocoms_list_next;
+    }
+    *tail = last;
+    return (ocoms_list_item_t *) head.ocoms_list_next;
+}
+
+
+/*
+ * Cut the NULL terminated chain after its first n items and return
+ * the remainder (NULL if the chain holds n items or less).
+ */
+static ocoms_list_item_t *
+ocoms_list_cut(ocoms_list_item_t *chain, size_t n)
+{
+    ocoms_list_item_t *rest;
+
+    while (--n > 0 && NULL != chain->ocoms_list_next) {
+        chain = (ocoms_list_item_t *) chain->ocoms_list_next;
+    }
+    rest = (ocoms_list_item_t *) chain->ocoms_list_next;
+    chain->ocoms_list_next = NULL;
+    return rest;
+}
+
+
+/*
+ * Bottom-up merge sort: runs of 1, 2, 4, ... items are merged in
+ * place, relinking the items without any extra storage.  The prev
+ * pointers are only rebuilt once, at the very end.
+ */
 int ocoms_list_sort(ocoms_list_t* list, ocoms_list_item_compare_fn_t compare)
 {
-    ocoms_list_item_t* item;
-    ocoms_list_item_t** items;
-    size_t i, index=0;
+    ocoms_list_item_t *sentinel = &(list->ocoms_list_sentinel);
+    ocoms_list_item_t *chain, *item, *prev, *a, *b, *rest, *tail;
+    size_t run;
 
-    if (0 == list->ocoms_list_length) {
+    if (list->ocoms_list_length < 2) {
         return OCOMS_SUCCESS;
     }
-    items = (ocoms_list_item_t**)malloc(sizeof(ocoms_list_item_t*) * 
-                                       list->ocoms_list_length);
 
-    if (NULL == items) {
-        return OCOMS_ERR_OUT_OF_RESOURCE;
+    /* detach the items as a NULL terminated singly linked chain */
+    chain = (ocoms_list_item_t *) sentinel->ocoms_list_next;
+    sentinel->ocoms_list_prev->ocoms_list_next = NULL;
+
+    for (run = 1; run < list->ocoms_list_length; run <<= 1) {
+        a = chain;
+        chain = tail = NULL;
+        while (NULL != a) {
+            b = ocoms_list_cut(a, run);
+            rest = (NULL == b) ? NULL : ocoms_list_cut(b, run);
+            item = ocoms_list_merge(a, b, compare, &prev);
+            if (NULL == chain) {
+                chain = item;
+            } else {
+                tail->ocoms_list_next = item;
+            }
+            tail = prev;
+            a = rest;
+        }
     }
 
-    while(NULL != (item = ocoms_list_remove_first(list))) {
-        items[index++] = item;
-    }
-    
-    qsort(items, index, sizeof(ocoms_list_item_t*), 
-          (int(*)(const void*,const void*))compare);
-    for (i=0; i<index; i++) {
-        ocoms_list_append(list,items[i]);
+    /* rebuild the prev pointers and hook the chain back on the sentinel */
+    prev = sentinel;
+    for (item = chain; NULL != item; item = (ocoms_list_item_t *) item->ocoms_list_next) {
+        item->ocoms_list_prev = prev;
+        prev->ocoms_list_next = item;
+        prev = item;
     }
-    free(items);
+    prev->ocoms_list_next = sentinel;
+    sentinel->ocoms_list_prev = prev;
+
     return OCOMS_SUCCESS;
 }
+
+
+ocoms_list_item_t *
+ocoms_list_find_sorted_pos(ocoms_list_t *list, ocoms_list_item_t *hint,
+                           ocoms_list_item_t *item,
+                           ocoms_list_item_compare_fn_t compare)
+{
+    ocoms_list_item_t *end = ocoms_list_get_end(list);
+    ocoms_list_item_t *pos, *prev;
+
+    pos = (NULL == hint) ? end : hint;
+
+    /* walk forward while pos sorts before or equal to item ... */
+    while (pos != end && compare(&pos, &item) <= 0) {
+        pos = (ocoms_list_item_t *) pos->ocoms_list_next;
+    }
+    /* ... and backward while the element before pos sorts after it */
+    prev = (ocoms_list_item_t *) pos->ocoms_list_prev;
+    while (prev != end && compare(&prev, &item) > 0) {
+        pos = prev;
+        prev = (ocoms_list_item_t *) pos->ocoms_list_prev;
+    }
+    return pos;
+}
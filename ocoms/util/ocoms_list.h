@@ -871,12 +871,9 @@ static inline void ocoms_list_insert_pos(ocoms_list_t *list, ocoms_list_item_t *
      * @retval 0 if \em a is equal to \em b
      * @retval 11 if \em a is less than \em b
      *
-     * This function is invoked by qsort(3) from within
-     * ocoms_list_sort().  It is important to understand what
-     * ocoms_list_sort() does before invoking qsort, so go read that
-     * documentation first.
-     *
-     * The important thing to realize here is that a and b will be \em
+     * This function is invoked by ocoms_list_sort() and the sorted
+     * insertion functions below.  For historical reasons (the sort
+     * used to be implemented on top of qsort(3)) a and b are \em
      * double pointers to the items that you need to compare.  Here's
      * a sample compare function to illustrate this point:
      */
@@ -889,22 +886,63 @@ static inline void ocoms_list_insert_pos(ocoms_list_t *list, ocoms_list_item_t *
      * @param list The list to sort
      * @param compare Compare function
      *
-     * Put crassly, this function's complexity is O(N) + O(log(N)).
-     * Its algorithm is:
-     *
-     * - remove every item from the list and put the corresponding
-     *    (ocoms_list_item_t*)'s in an array
-     * - call qsort(3) with that array and your compare function
-     * - re-add every element of the now-sorted array to the list
-     *
-     * The resulting list is now ordered.  Note, however, that since
-     * an array of pointers is sorted, the comparison function must do
-     * a double de-reference to get to the actual ocoms_list_item_t (or
-     * whatever the underlying type is).  See the documentation of
+     * The items are sorted in place by a bottom-up merge sort that
+     * only relinks them: the complexity is O(N log(N)), no memory is
+     * allocated, and the sort is stable (items comparing equal keep
+     * their relative order).  Note that the comparison function must
+     * do a double de-reference to get to the actual ocoms_list_item_t
+     * (or whatever the underlying type is).  See the documentation of
      * ocoms_list_item_compare_fn_t for an example).
+     *
+     * @retval OCOMS_SUCCESS This function cannot fail.
      */
     OCOMS_DECLSPEC int ocoms_list_sort(ocoms_list_t* list, ocoms_list_item_compare_fn_t compare);
 
+    /**
+     * Find where an item belongs in a sorted list.
+     *
+     * @param list A list sorted according to \c compare
+     * @param hint An item of \c list to start the search from, or
+     *             NULL to start from the end of the list
+     * @param item The item to place (not on the list)
+     * @param compare Compare function
+     *
+     * @returns The list element before which \c item must be
+     * inserted (possibly the end of the list) so that the list stays
+     * sorted.  \c item is placed after all the elements comparing
+     * equal to it.
+     *
+     * The search walks from \c hint in the direction of the final
+     * position, so its cost is proportional to the distance between
+     * the hint and the result.  Keeping the last insertion position
+     * as the hint makes bursts of nearby keys O(1) each, and the
+     * default (NULL) is O(1) for keys arriving in increasing order.
+     */
+    OCOMS_DECLSPEC ocoms_list_item_t *
+    ocoms_list_find_sorted_pos(ocoms_list_t *list, ocoms_list_item_t *hint,
+                               ocoms_list_item_t *item,
+                               ocoms_list_item_compare_fn_t compare);
+
+    /**
+     * Insert an item in a sorted list, keeping it sorted.
+     *
+     * @param list A list sorted according to \c compare
+     * @param item The item to insert
+     * @param compare Compare function
+     *
+     * The position is searched backward from the end of the list (see
+     * ocoms_list_find_sorted_pos()), which is O(1) for the common
+     * case of pending lists ordered by increasing sequence number or
+     * deadline, and O(N) in the worst case.
+     */
+    static inline void ocoms_list_insert_sorted(ocoms_list_t *list,
+                                                ocoms_list_item_t *item,
+                                                ocoms_list_item_compare_fn_t compare)
+    {
+        ocoms_list_insert_pos(list, ocoms_list_find_sorted_pos(list, NULL, item, compare),
+                              item);
+    }
+
 END_C_DECLS
 
 #endif /* OCOMS_LIST_H */
@@ -19,18 +19,32 @@
  * $HEADER$
  */
 
+
 #include "ocoms/platform/ocoms_config.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "ocoms/platform/ocoms_constants.h"
 #include "ocoms/util/ocoms_pointer_array.h"
 #include "ocoms/util/output.h"
+#include "ocoms/primitives/bit_ops.h"
 
 enum { TABLE_INIT = 1, TABLE_GROW = 2 };
 
+/* number of 32 bits words in the usage bitmap of a segment */
+#define SEGMENT_WORDS (OCOMS_POINTER_ARRAY_SEGMENT_SIZE / 32)
+
+#define SEGMENT_OF(table, index) \
+    ((table)->segments[(index) >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT])
+#define SEGMENT_COUNT(size) \
+    ((int) (((unsigned int) (size) + OCOMS_POINTER_ARRAY_SEGMENT_MASK) >> \
+            OCOMS_POINTER_ARRAY_SEGMENT_SHIFT))
+/* number of 32 bits words in the full segments summary */
+#define SUMMARY_WORDS(count) (((count) + 31) / 32)
+
 static void ocoms_pointer_array_construct(ocoms_pointer_array_t *);
 static void ocoms_pointer_array_destruct(ocoms_pointer_array_t *);
 static bool grow_table(ocoms_pointer_array_t *table, int soft, int hard);
@@ -39,6 +53,198 @@ OBJ_CLASS_INSTANCE(ocoms_pointer_array_t, ocoms_object_t,
                    ocoms_pointer_array_construct,
                    ocoms_pointer_array_destruct);
 
+/*
+ * Atomic helpers for the usage bitmaps and the free counter.  Without
+ * thread support they degrade to plain memory accesses.
+ */
+static inline bool word_cmpset(volatile uint32_t *word, uint32_t oldval, uint32_t newval)
+{
+#if OCOMS_ENABLE_MULTI_THREADS
+    return 0 != ocoms_atomic_cmpset_32((volatile int32_t *) word,
+                                       (int32_t) oldval, (int32_t) newval);
+#else
+    *word = newval;
+    return true;
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+}
+
+static inline void counter_add(volatile int *counter, int delta)
+{
+#if OCOMS_ENABLE_MULTI_THREADS
+    ocoms_atomic_add_32((volatile int32_t *) counter, delta);
+#else
+    *counter += delta;
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+}
+
+/*
+ * Set or clear the bit of an element in its segment bitmap.  Returns
+ * whether the bit was set before the update.
+ */
+static inline bool update_used_bit(ocoms_pointer_array_segment_t *segment,
+                                   int offset, bool set)
+{
+    volatile uint32_t *word = &segment->used[offset / 32];
+    uint32_t bit = 1U << (offset % 32);
+    uint32_t oldval, newval;
+
+    do {
+        oldval = *word;
+        newval = set ? (oldval | bit) : (oldval & ~bit);
+    } while (oldval != newval && !word_cmpset(word, oldval, newval));
+
+    return 0 != (oldval & bit);
+}
+
+/*
+ * Elements of the last segment past max_size do not exist: mark them
+ * as permanently used so that they are never handed out.
+ */
+static void mark_tail_used(ocoms_pointer_array_segment_t *segment, int first)
+{
+    int offset;
+
+    for (offset = first; offset < OCOMS_POINTER_ARRAY_SEGMENT_SIZE; offset++) {
+        segment->used[offset / 32] |= 1U << (offset % 32);
+    }
+}
+
+static inline bool segment_is_full(ocoms_pointer_array_segment_t *segment)
+{
+    int w;
+
+    for (w = 0; w < SEGMENT_WORDS; w++) {
+        if (0xffffffffU != segment->used[w]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Bring the summary bit of a segment in line with its usage bitmap.
+ * Updaters may race on the summary word, so the segment is checked
+ * again after the update: whoever writes the bit last also sees the
+ * final state of the segment.  The summary is only a search hint --
+ * claim_free_element() falls back to a full scan -- so a directory
+ * swapped under our feet costs at worst a slower search.
+ */
+static void sync_full_bit(ocoms_pointer_array_t *table, int segment_index)
+{
+    ocoms_pointer_array_segment_t *segment = table->segments[segment_index];
+    volatile uint32_t *word = &table->full_segments[segment_index / 32];
+    uint32_t bit = 1U << (segment_index % 32);
+    uint32_t oldval, newval;
+    bool full;
+
+    do {
+        full = segment_is_full(segment);
+        do {
+            oldval = *word;
+            newval = full ? (oldval | bit) : (oldval & ~bit);
+        } while (oldval != newval && !word_cmpset(word, oldval, newval));
+    } while (full != segment_is_full(segment));
+}
+
+/*
+ * Called after a usage bit of the segment changed.
+ */
+static inline void update_full_bit(ocoms_pointer_array_t *table, int segment_index)
+{
+    bool flagged = 0 != (table->full_segments[segment_index / 32] &
+                         (1U << (segment_index % 32)));
+
+    if (flagged != segment_is_full(table->segments[segment_index])) {
+        sync_full_bit(table, segment_index);
+    }
+}
+
+/*
+ * Claim a free element of one segment.
+ *
+ * @return the claimed offset in the segment, or -1 if it is full
+ */
+static int claim_in_segment(ocoms_pointer_array_t *table, int segment_index)
+{
+    ocoms_pointer_array_segment_t *segment = table->segments[segment_index];
+    volatile uint32_t *word;
+    uint32_t oldval;
+    int w, bit;
+
+    for (w = 0; w < SEGMENT_WORDS; w++) {
+        word = &segment->used[w];
+        while (0xffffffffU != (oldval = *word)) {
+            bit = ocoms_ctz32(~oldval);
+            if (word_cmpset(word, oldval, oldval | (1U << bit))) {
+                if (0xffffffffU == (oldval | (1U << bit))) {
+                    sync_full_bit(table, segment_index);
+                }
+                return w * 32 + bit;
+            }
+        }
+    }
+    /* the segment is full but was not flagged so */
+    sync_full_bit(table, segment_index);
+    return -1;
+}
+
+/*
+ * Claim a free element by atomically setting its bit.  The search
+ * starts at the segment holding the hint, wraps around, and only
+ * visits segments which the summary does not flag as full.  Should
+ * that fail, all the segments are scanned, so a stale lowest_free or
+ * summary can only cost time, never a free element.
+ *
+ * @return the claimed index, or -1 if the table is full
+ */
+static int claim_free_element(ocoms_pointer_array_t *table, int hint)
+{
+    volatile uint32_t *full_segments;
+    uint32_t candidates;
+    int size = table->size;
+    int num_segments = SEGMENT_COUNT(size);
+    int num_words = SUMMARY_WORDS(num_segments);
+    int i, w, first, segment_index, offset;
+
+    if (0 == num_segments) {
+        return -1;
+    }
+#if OCOMS_ENABLE_MULTI_THREADS
+    ocoms_atomic_rmb();
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+    full_segments = table->full_segments;
+    first = ((hint >= 0 && hint < size) ? hint : 0) >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT;
+
+    /* the word holding the first segment is visited twice: its upper
+       part first, its lower part once we have wrapped around */
+    for (i = 0, w = first / 32; i <= num_words; i++, w = (w + 1 == num_words) ? 0 : w + 1) {
+        candidates = ~full_segments[w];
+        if (0 == i) {
+            candidates &= 0xffffffffU << (first % 32);
+        } else if (num_words == i) {
+            candidates &= ~(0xffffffffU << (first % 32));
+        }
+        if (w == num_words - 1 && 0 != num_segments % 32) {
+            candidates &= ~(0xffffffffU << (num_segments % 32));
+        }
+        while (0 != candidates) {
+            segment_index = w * 32 + ocoms_ctz32(candidates);
+            candidates &= candidates - 1;
+            if (0 <= (offset = claim_in_segment(table, segment_index))) {
+                return (segment_index << OCOMS_POINTER_ARRAY_SEGMENT_SHIFT) + offset;
+            }
+        }
+    }
+
+    /* the summary may be stale: look at every segment */
+    for (segment_index = 0; segment_index < num_segments; segment_index++) {
+        if (0 <= (offset = claim_in_segment(table, segment_index))) {
+            return (segment_index << OCOMS_POINTER_ARRAY_SEGMENT_SHIFT) + offset;
+        }
+    }
+    return -1;
+}
+
 /*
  * ocoms_pointer_array constructor
  */
@@ -50,7 +256,9 @@ static void ocoms_pointer_array_construct(ocoms_pointer_array_t *array)
     array->size = 0;
     array->max_size = INT_MAX;
     array->block_size = 0;
-    array->addr = 0;
+    array->num_segments = 0;
+    array->segments = NULL;
+    array->full_segments = NULL;
 }
 
 /*
@@ -58,13 +266,23 @@ static void ocoms_pointer_array_construct(ocoms_pointer_array_t *array)
  */
 static void ocoms_pointer_array_destruct(ocoms_pointer_array_t *array)
 {
-    /* free table */
-    if( NULL != array->addr) {
-        free(array->addr);
-        array->addr = NULL;
+    ocoms_pointer_array_segment_t **directory, **retired;
+    int i;
+
+    /* free the segments, then the current and all the retired directories */
+    if( NULL != array->segments ) {
+        for( i = 0; i < SEGMENT_COUNT(array->size); i++ ) {
+            free(array->segments[i]);
+        }
+        for( directory = array->segments - 1; NULL != directory; directory = retired ) {
+            retired = (ocoms_pointer_array_segment_t **) directory[0];
+            free(directory);
+        }
+        array->segments = NULL;
     }
 
     array->size = 0;
+    array->num_segments = 0;
 
     OBJ_DESTRUCT(&array->lock);
 }
@@ -76,8 +294,8 @@ int ocoms_pointer_array_init(ocoms_pointer_array_t* array,
                             int initial_allocation,
                             int max_size, int block_size)
 {
-    size_t num_bytes;
-    
+    int num_elements;
+
     /* check for errors */
     if (NULL == array || max_size < block_size) {
         return OCOMS_ERR_BAD_PARAM;
@@ -86,14 +304,11 @@ int ocoms_pointer_array_init(ocoms_pointer_array_t* array,
     array->max_size = max_size;
     array->block_size = block_size;
    
-    num_bytes = (0 < initial_allocation ? initial_allocation : block_size);
-    array->number_free = num_bytes;
-    array->size = num_bytes;
-    num_bytes *= sizeof(void*);
-
-    /* Allocate and set the array to NULL */   
-    array->addr = (void **)calloc(num_bytes, 1);
-    if (NULL == array->addr) { /* out of memory */
+    num_elements = (0 < initial_allocation ? initial_allocation : block_size);
+    if (num_elements > max_size) {
+        num_elements = max_size;
+    }
+    if (0 < num_elements && !grow_table(array, num_elements, num_elements)) {
         return OCOMS_ERR_OUT_OF_RESOURCE;
     }
 
@@ -110,45 +325,39 @@ int ocoms_pointer_array_init(ocoms_pointer_array_t* array,
  */
 int ocoms_pointer_array_add(ocoms_pointer_array_t *table, void *ptr)
 {
-    int i, index;
-
-    OCOMS_THREAD_LOCK(&(table->lock));
-
-    if (table->number_free == 0) {
-        /* need to grow table */
-        if (!grow_table(table, 
-                        (NULL == table->addr ? TABLE_INIT : table->size * TABLE_GROW), 
-                        OCOMS_FORTRAN_HANDLE_MAX)) {
-            OCOMS_THREAD_UNLOCK(&(table->lock));
-            return OCOMS_ERR_OUT_OF_RESOURCE;
+    int index;
+
+    if (0 > (index = claim_free_element(table, table->lowest_free))) {
+        /*
+         * Grow the table under the lock, unless another thread just did.
+         * number_free is not looked at: it lags behind the claims in
+         * flight, and waiting for it would spin.  Every failed claim
+         * grows the table, so the loop ends at the latest when the
+         * table reaches its maximum size.
+         */
+        OCOMS_THREAD_LOCK(&(table->lock));
+        while (0 > (index = claim_free_element(table, table->lowest_free))) {
+            if (!grow_table(table, 
+                            (NULL == table->segments ? TABLE_INIT : table->size * TABLE_GROW), 
+                            OCOMS_FORTRAN_HANDLE_MAX)) {
+                OCOMS_THREAD_UNLOCK(&(table->lock));
+                return OCOMS_ERR_OUT_OF_RESOURCE;
+            }
         }
+        OCOMS_THREAD_UNLOCK(&(table->lock));
     }
 
-    assert( (table->addr != NULL) && (table->size > 0) );
-    assert( (table->lowest_free >= 0) && (table->lowest_free < table->size) );
-    assert( (table->number_free > 0) && (table->number_free <= table->size) );
-
     /*
-     * add pointer to table, and return the index
+     * the slot is ours: store the pointer and update the counters
      */
 
-    index = table->lowest_free;
-    assert(table->addr[index] == NULL);
-    table->addr[index] = ptr;
-    table->number_free--;
-    if (table->number_free > 0) {
-        for (i = table->lowest_free + 1; i < table->size; i++) {
-            if (table->addr[i] == NULL) {
-                table->lowest_free = i;
-                break;
-            }
-        }
-    }
-    else {
-        table->lowest_free = table->size;
+    assert(NULL == SEGMENT_OF(table, index)->items[index & OCOMS_POINTER_ARRAY_SEGMENT_MASK]);
+    SEGMENT_OF(table, index)->items[index & OCOMS_POINTER_ARRAY_SEGMENT_MASK] = ptr;
+    counter_add(&table->number_free, -1);
+    if (index == table->lowest_free) {
+        table->lowest_free = index + 1;
     }
 
-    OCOMS_THREAD_UNLOCK(&(table->lock));
     return index;
 }
 
@@ -166,55 +375,61 @@ int ocoms_pointer_array_add(ocoms_pointer_array_t *table, void *ptr)
 int ocoms_pointer_array_set_item(ocoms_pointer_array_t *table, int index,
                                 void * value)
 {
+    ocoms_pointer_array_segment_t *segment;
+    int offset;
+
     assert(table != NULL);
 
+    if (index < 0) {
+        return OCOMS_ERROR;
+    }
+
     /* expand table if required to set a specific index */
 
-    OCOMS_THREAD_LOCK(&(table->lock));
     if (table->size <= index) {
-        if (!grow_table(table, ((index / TABLE_GROW) + 1) * TABLE_GROW,
-                        index)) {
+        OCOMS_THREAD_LOCK(&(table->lock));
+        if (table->size <= index &&
+            !grow_table(table, ((index / TABLE_GROW) + 1) * TABLE_GROW,
+                        index + 1)) {
             OCOMS_THREAD_UNLOCK(&(table->lock));
             return OCOMS_ERROR;
         }
+        OCOMS_THREAD_UNLOCK(&(table->lock));
     }
 
+    segment = SEGMENT_OF(table, index);
+    offset = index & OCOMS_POINTER_ARRAY_SEGMENT_MASK;
+
     /* mark element as free, if NULL element */
     if( NULL == value ) {
+        segment->items[offset] = NULL;
+        if (update_used_bit(segment, offset, false)) {
+            counter_add(&table->number_free, 1);
+            update_full_bit(table, index >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT);
+        }
         if (index < table->lowest_free) {
             table->lowest_free = index;
         }
-        if( NULL != table->addr[index] ) {
-            table->number_free++;
-        }
     } else {
-        if (NULL == table->addr[index]) {
-            table->number_free--;
-        }
-        /* Reset lowest_free if required */
-        if ( index == table->lowest_free ) {
-            int i;
-            
-            table->lowest_free = table->size;
-            for ( i=index + 1; i<table->size; i++) {
-                if ( NULL == table->addr[i] ){
-                    table->lowest_free = i;
-                    break;
-                }                    
+        segment->items[offset] = value;
+        if (!update_used_bit(segment, offset, true)) {
+            counter_add(&table->number_free, -1);
+            update_full_bit(table, index >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT);
+            /* Reset lowest_free if required */
+            if ( index == table->lowest_free ) {
+                table->lowest_free = index + 1;
             }
         }
     }
-    table->addr[index] = value;	
 
 #if 0
     ocoms_output(0,"ocoms_pointer_array_set_item: OUT: "
                 " table %p (size %ld, lowest free %ld, number free %ld)"
                 " addr[%d] = %p\n",
                 table, table->size, table->lowest_free, table->number_free,
-                index, table->addr[index]);
+                index, value);
 #endif
 
-    OCOMS_THREAD_UNLOCK(&(table->lock));
     return OCOMS_SUCCESS;
 }
 
@@ -235,51 +450,48 @@ int ocoms_pointer_array_set_item(ocoms_pointer_array_t *table, int index,
 bool ocoms_pointer_array_test_and_set_item (ocoms_pointer_array_t *table, 
                                            int index, void *value)
 {
+    ocoms_pointer_array_segment_t *segment;
+    volatile uint32_t *word;
+    uint32_t bit, oldval;
+    int offset;
+
     assert(table != NULL);
     assert(index >= 0);
 
-#if 0
-    ocoms_output(0,"ocoms_pointer_array_test_and_set_item: IN:  "
-               " table %p (size %ld, lowest free %ld, number free %ld)"
-               " addr[%d] = %p\n",
-               table, table->size, table->lowest_free, table->number_free,
-               index, table->addr[index]);
-#endif
-
-    /* expand table if required to set a specific index */
-    OCOMS_THREAD_LOCK(&(table->lock));
-    if ( index < table->size && table->addr[index] != NULL ) {
-        /* This element is already in use */
-        OCOMS_THREAD_UNLOCK(&(table->lock));
-        return false;
-    }
-
     /* Do we need to grow the table? */
 
     if (table->size <= index) {
-        if (!grow_table(table, (((index / TABLE_GROW) + 1) * TABLE_GROW),
-                        index)) {
+        OCOMS_THREAD_LOCK(&(table->lock));
+        if (table->size <= index &&
+            !grow_table(table, (((index / TABLE_GROW) + 1) * TABLE_GROW),
+                        index + 1)) {
             OCOMS_THREAD_UNLOCK(&(table->lock));
             return false;
         }
+        OCOMS_THREAD_UNLOCK(&(table->lock));
     }
 
     /* 
-     * allow a specific index to be changed.
+     * claim the element: this fails if its bit is already set
      */
-    table->addr[index] = value;
-    table->number_free--;
+    segment = SEGMENT_OF(table, index);
+    offset = index & OCOMS_POINTER_ARRAY_SEGMENT_MASK;
+    word = &segment->used[offset / 32];
+    bit = 1U << (offset % 32);
+    do {
+        oldval = *word;
+        if (oldval & bit) {
+            /* This element is already in use */
+            return false;
+        }
+    } while (!word_cmpset(word, oldval, oldval | bit));
+
+    segment->items[offset] = value;
+    counter_add(&table->number_free, -1);
+    update_full_bit(table, index >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT);
     /* Reset lowest_free if required */
     if ( index == table->lowest_free ) {
-        int i;
-
-	table->lowest_free = table->size;
-        for ( i=index; i<table->size; i++) {
-            if ( NULL == table->addr[i] ){
-                table->lowest_free = i;
-                break;
-            }                    
-        }
+        table->lowest_free = index + 1;
     }
 
 #if 0
@@ -287,10 +499,9 @@ bool ocoms_pointer_array_test_and_set_item (ocoms_pointer_array_t *table,
                " table %p (size %ld, lowest free %ld, number free %ld)"
                " addr[%d] = %p\n",
                table, table->size, table->lowest_free, table->number_free,
-               index, table->addr[index]);
+               index, value);
 #endif
 
-    OCOMS_THREAD_UNLOCK(&(table->lock));
     return true;
 }
 
@@ -307,40 +518,113 @@ int ocoms_pointer_array_set_size(ocoms_pointer_array_t *array, int new_size)
     return OCOMS_SUCCESS;
 }
 
+void ocoms_pointer_array_remove_all(ocoms_pointer_array_t *array)
+{
+    ocoms_pointer_array_segment_t *segment;
+    int i;
+
+    if( array->number_free == array->size )
+        return;  /* nothing to do here this time (the array is already empty) */
+ 
+    OCOMS_THREAD_LOCK(&array->lock);
+    for( i = 0; i < SEGMENT_COUNT(array->size); i++ ) {
+        segment = array->segments[i];
+        memset((void *) segment, 0, sizeof(ocoms_pointer_array_segment_t));
+        if( (i + 1) * OCOMS_POINTER_ARRAY_SEGMENT_SIZE > array->size ) {
+            mark_tail_used(segment, array->size & OCOMS_POINTER_ARRAY_SEGMENT_MASK);
+        }
+    }
+    memset((void *) array->full_segments, 0,
+           SUMMARY_WORDS(SEGMENT_COUNT(array->size)) * sizeof(uint32_t));
+    array->lowest_free = 0;
+    array->number_free = array->size;
+    OCOMS_THREAD_UNLOCK(&array->lock);
+}
+
+/*
+ * Grow the table to hold at least soft elements (or hard, if soft is
+ * beyond max_size), rounded up to whole segments.  Existing segments
+ * never move: new ones are added to the directory, and when the
+ * directory itself has to be reallocated the old one is kept on a
+ * chain (in its first slot) until destruction, as lock-free readers
+ * may still be looking at it.  The full segments summary is stored
+ * right after the directory entries.  The caller holds the lock.
+ */
 static bool grow_table(ocoms_pointer_array_t *table, int soft, int hard)
 {
-    int new_size;
-    int i, new_size_int;
-    void *p;
+    ocoms_pointer_array_segment_t **directory;
+    uint32_t *full_segments;
+    int new_size, old_count, new_count, capacity, i;
 
-    /* new_size = ((table->size + num_needed + table->block_size - 1) /
-       table->block_size) * table->block_size; */
     new_size = soft;
-    if( soft > table->max_size ) {
+    if( soft < 0 || soft > table->max_size ) {
         if( hard > table->max_size ) {
             return false;
         }
         new_size = hard;
     }
-    if( new_size >= table->max_size ) {
+    if( new_size <= table->size ) {
+        /* already at max_size */
         return false;
     }
+    if( new_size > table->max_size - OCOMS_POINTER_ARRAY_SEGMENT_MASK ) {
+        new_size = table->max_size;
+    } else {
+        new_size = SEGMENT_COUNT(new_size) << OCOMS_POINTER_ARRAY_SEGMENT_SHIFT;
+    }
 
-    p = (void **) realloc(table->addr, new_size * sizeof(void *));
-    if (p == NULL) {
-        return false;
+    old_count = SEGMENT_COUNT(table->size);
+    new_count = SEGMENT_COUNT(new_size);
+
+    if( new_count > table->num_segments ) {
+        capacity = 2 * table->num_segments;
+        if( capacity < new_count ) {
+            capacity = new_count;
+        }
+        directory = (ocoms_pointer_array_segment_t **)
+            calloc(1, (capacity + 1) * sizeof(ocoms_pointer_array_segment_t *) +
+                   SUMMARY_WORDS(capacity) * sizeof(uint32_t));
+        if( NULL == directory ) {
+            return false;
+        }
+        full_segments = (uint32_t *) (directory + capacity + 1);
+        if( NULL != table->segments ) {
+            directory[0] = (ocoms_pointer_array_segment_t *) (table->segments - 1);
+            memcpy(directory + 1, table->segments,
+                   old_count * sizeof(ocoms_pointer_array_segment_t *));
+            memcpy(full_segments, (void *) table->full_segments,
+                   SUMMARY_WORDS(old_count) * sizeof(uint32_t));
+        }
+#if OCOMS_ENABLE_MULTI_THREADS
+        ocoms_atomic_wmb();
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+        table->full_segments = full_segments;
+        table->segments = directory + 1;
+        table->num_segments = capacity;
     }
-    
-    /* We've already established (above) that the arithmetic
-       below will be less than OCOMS_FORTRAN_HANDLE_MAX */
-    
-    new_size_int = (int) new_size;
-    table->number_free += new_size_int - table->size;
-    table->addr = (void**)p;
-    for (i = table->size; i < new_size_int; ++i) {
-        table->addr[i] = NULL;
+
+    for( i = old_count; i < new_count; i++ ) {
+        table->segments[i] = (ocoms_pointer_array_segment_t *)
+            calloc(1, sizeof(ocoms_pointer_array_segment_t));
+        if( NULL == table->segments[i] ) {
+            while( --i >= old_count ) {
+                free(table->segments[i]);
+                table->segments[i] = NULL;
+            }
+            return false;
+        }
     }
-    table->size = new_size_int;
+    if( ((unsigned int) new_count << OCOMS_POINTER_ARRAY_SEGMENT_SHIFT) > (unsigned int) new_size ) {
+        mark_tail_used(table->segments[new_count - 1],
+                       new_size & OCOMS_POINTER_ARRAY_SEGMENT_MASK);
+    }
+
+    /* publish the new segments before the new size */
+#if OCOMS_ENABLE_MULTI_THREADS
+    ocoms_atomic_wmb();
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+    counter_add(&table->number_free, new_size - table->size);
+    table->size = new_size;
 
     return true;
 }
@@ -29,6 +29,20 @@
  * normally expect size_t.  There's some code that makes sure indices
  * don't go above FORTRAN_HANDLE_MAX (which is min(INT_MAX, fortran
  * INTEGER max)), just to be sure.
+ *
+ * The array is stored as a directory of fixed size segments.  Once
+ * allocated a segment never moves, and a directory replaced during
+ * growth is kept alive until the array is destructed, so
+ * ocoms_pointer_array_get_item() never has to take the lock: it is a
+ * wait-free directory / segment / item lookup.  Every segment carries
+ * a bitmap of the slots in use; ocoms_pointer_array_add() and
+ * ocoms_pointer_array_test_and_set_item() claim slots with an atomic
+ * compare-and-swap on that bitmap.  The lock only serializes growth
+ * and ocoms_pointer_array_remove_all().
+ *
+ * Next to the directory the array keeps a summary with one bit per
+ * segment, set when every slot of the segment is in use, so that the
+ * search for a free slot skips full segments 32 at a time.
  */
 
 #ifndef OCOMS_POINTER_ARRAY_H
@@ -38,32 +52,60 @@
 
 #include "ocoms/threads/mutex.h"
 #include "ocoms/util/ocoms_object.h"
+#if OCOMS_ENABLE_MULTI_THREADS
+#include "ocoms/sys/atomic.h"
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
 
 BEGIN_C_DECLS
 
+/** log2 of the number of elements in a segment */
+#define OCOMS_POINTER_ARRAY_SEGMENT_SHIFT 7
+/** number of elements in a segment */
+#define OCOMS_POINTER_ARRAY_SEGMENT_SIZE  (1 << OCOMS_POINTER_ARRAY_SEGMENT_SHIFT)
+/** mask extracting the index of an element inside its segment */
+#define OCOMS_POINTER_ARRAY_SEGMENT_MASK  (OCOMS_POINTER_ARRAY_SEGMENT_SIZE - 1)
+
+/**
+ * A segment of the pointer array.
+ */
+struct ocoms_pointer_array_segment_t {
+    /** one bit per element, set when the element is in use */
+    volatile uint32_t used[OCOMS_POINTER_ARRAY_SEGMENT_SIZE / 32];
+    /** the elements */
+    void * volatile items[OCOMS_POINTER_ARRAY_SEGMENT_SIZE];
+};
+typedef struct ocoms_pointer_array_segment_t ocoms_pointer_array_segment_t;
+
 /**
  * dynamic pointer array
  */
 struct ocoms_pointer_array_t {
     /** base class */
     ocoms_object_t super;
-    /** synchronization object */
+    /** synchronization object, only taken to grow or reset the array */
     ocoms_mutex_t lock;
     /** Index of lowest free element.  NOTE: This is only an
         optimization to know where to search for the first free slot.
         It does \em not necessarily imply indices all above this index
         are not taken! */
-    int lowest_free;
+    volatile int lowest_free;
     /** number of free elements in the list */
-    int number_free;
-    /** size of list, i.e. number of elements in addr */
-    int size;
+    volatile int number_free;
+    /** size of list, i.e. number of elements reachable through segments */
+    volatile int size;
     /** maximum size of the array */
     int max_size;
     /** block size for each allocation */
     int block_size;
-    /** pointer to array of pointers */
-    void **addr;
+    /** number of entries of the segments directory */
+    int num_segments;
+    /** directory of segments, which replaces the former contiguous
+        addr array: use ocoms_pointer_array_get_item() or
+        ocoms_pointer_array_get_item_addr() instead of addr[i] */
+    ocoms_pointer_array_segment_t ** volatile segments;
+    /** one bit per segment, set when all its slots are in use.  Lives
+        in the same allocation as the directory. */
+    volatile uint32_t * volatile full_segments;
 };
 /**
  * Convenience typedef
@@ -127,15 +169,44 @@ OCOMS_DECLSPEC int ocoms_pointer_array_set_item(ocoms_pointer_array_t *array,
 static inline void *ocoms_pointer_array_get_item(ocoms_pointer_array_t *table, 
                                                 int element_index)
 {
-    void *p;
+    ocoms_pointer_array_segment_t *segment;
+
+    if( (element_index < 0) || (table->size <= element_index) ) {
+        return NULL;
+    }
+#if OCOMS_ENABLE_MULTI_THREADS
+    /* pairs with the write barrier issued before the size is grown */
+    ocoms_atomic_rmb();
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+    segment = table->segments[element_index >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT];
+    return segment->items[element_index & OCOMS_POINTER_ARRAY_SEGMENT_MASK];
+}
+
+/**
+ * Get the address of an element in array
+ *
+ * @param array          Pointer to array (IN)
+ * @param element_index  Index of element (IN)
+ *
+ * @return Address of the element.  NULL indicates an error.
+ *
+ * Replaces &array->addr[element_index]: the elements are stored in
+ * segments, so the address is only valid for this element, and the
+ * element must still be changed through ocoms_pointer_array_set_item.
+ */
+static inline void * volatile *ocoms_pointer_array_get_item_addr(ocoms_pointer_array_t *table,
+                                                                int element_index)
+{
+    ocoms_pointer_array_segment_t *segment;
 
-    if( table->size <= element_index ) {
+    if( (element_index < 0) || (table->size <= element_index) ) {
         return NULL;
     }
-    OCOMS_THREAD_LOCK(&(table->lock));
-    p = table->addr[element_index];
-    OCOMS_THREAD_UNLOCK(&(table->lock));
-    return p;
+#if OCOMS_ENABLE_MULTI_THREADS
+    ocoms_atomic_rmb();
+#endif  /* OCOMS_ENABLE_MULTI_THREADS */
+    segment = table->segments[element_index >> OCOMS_POINTER_ARRAY_SEGMENT_SHIFT];
+    return &segment->items[element_index & OCOMS_POINTER_ARRAY_SEGMENT_MASK];
 }
 
 
@@ -189,21 +260,10 @@ OCOMS_DECLSPEC bool ocoms_pointer_array_test_and_set_item (ocoms_pointer_array_t
  *
  * @param array Pointer to array (IN)
  *
+ * Must not be called concurrently with other modifications of the
+ * array.
  */
-static inline void ocoms_pointer_array_remove_all(ocoms_pointer_array_t *array)
-{
-    int i;
-    if( array->number_free == array->size )
-        return;  /* nothing to do here this time (the array is already empty) */
- 
-    OCOMS_THREAD_LOCK(&array->lock);
-    array->lowest_free = 0;
-    array->number_free = array->size;
-    for(i=0; i<array->size; i++) {
-        array->addr[i] = NULL;
-    }
-    OCOMS_THREAD_UNLOCK(&array->lock);
-}
+OCOMS_DECLSPEC void ocoms_pointer_array_remove_all(ocoms_pointer_array_t *array);
 
 END_C_DECLS
 
@@ -22,27 +22,66 @@
  */
 
 #include "ocoms/platform/ocoms_config.h"
-#include "arch.h"
+#include <string.h>
 #include "ocoms/util/ocoms_rb_tree.h"
 
 /* declare the instance of the classes  */
-OBJ_CLASS_INSTANCE(ocoms_rb_tree_node_t, ocoms_free_list_item_t, NULL, NULL);
 OBJ_CLASS_INSTANCE(ocoms_rb_tree_t, ocoms_object_t, ocoms_rb_tree_construct,
                    ocoms_rb_tree_destruct);
 
+/* a chunk of the node arena, followed by the nodes themselves */
+struct ocoms_rb_tree_chunk_t {
+    struct ocoms_rb_tree_chunk_t *next;
+    union {
+        void *ptr;
+        double dbl;
+    } align;
+};
+
+/* access to the color packed in the parent pointer */
+#define RB_PARENT(node) ocoms_rb_tree_node_parent(node)
+#define RB_COLOR(node)  ocoms_rb_tree_node_color(node)
+
+/* access to the interval part of the nodes of an interval tree */
+#define RB_IS_INTERVAL(tree) ((tree)->node_size == sizeof(ocoms_rb_tree_interval_node_t))
+#define RB_INTERVAL(node)    ((ocoms_rb_tree_interval_node_t *) (node))
+
+static inline void rb_set_parent(ocoms_rb_tree_node_t *node, ocoms_rb_tree_node_t *parent)
+{
+    node->parent_color = (uintptr_t) parent | (node->parent_color & 1);
+}
+
+static inline void rb_set_color(ocoms_rb_tree_node_t *node, ocoms_rb_tree_nodecolor_t color)
+{
+    node->parent_color = (node->parent_color & ~((uintptr_t) 1)) | (uintptr_t) color;
+}
+
 /* Private functions */
+static ocoms_rb_tree_node_t * node_alloc(ocoms_rb_tree_t *tree);
+static void node_free(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t *node);
+static int rb_tree_setup(ocoms_rb_tree_t * tree, ocoms_rb_tree_comp_fn_t comp,
+                         size_t node_size);
+static int rb_tree_insert(ocoms_rb_tree_t *tree, void *key, void *end, void *value);
+static void rb_tree_delete_node(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t *p);
+static void update_max_end(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t *node);
 static void btree_insert(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * node);
 static void btree_delete_fixup(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x);
 static ocoms_rb_tree_node_t * btree_successor(ocoms_rb_tree_t * tree,
                                              ocoms_rb_tree_node_t * node);
 static ocoms_rb_tree_node_t * ocoms_rb_tree_find_node(ocoms_rb_tree_t *tree, void *key);
+static ocoms_rb_tree_node_t * lower_bound_node(ocoms_rb_tree_t *tree, void *key);
 static void left_rotate(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x);
 static void right_rotate(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x);
-static void inorder_destroy(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * node);
 static void inorder_traversal(ocoms_rb_tree_t *tree,
                               ocoms_rb_tree_condition_fn_t cond,
                               ocoms_rb_tree_action_fn_t action,
                               ocoms_rb_tree_node_t * node);
+static int inorder_range(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                         ocoms_rb_tree_visit_fn_t visit, void *context,
+                         ocoms_rb_tree_node_t * node);
+static int interval_search(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                           ocoms_rb_tree_visit_fn_t visit, void *context,
+                           ocoms_rb_tree_node_t * node);
 
 
 
@@ -50,22 +89,21 @@ static void inorder_traversal(ocoms_rb_tree_t *tree,
 void ocoms_rb_tree_construct(ocoms_object_t * object)
 {
     ocoms_rb_tree_t * tree = (ocoms_rb_tree_t *) object;
-    allocator_handle_t handle = {NULL, 0};
     tree->root_ptr = NULL;
-    OBJ_CONSTRUCT(&(tree->free_list), ocoms_free_list_t);
-    ocoms_free_list_init_new(&(tree->free_list), sizeof(ocoms_rb_tree_node_t),
-            ocoms_cache_line_size, OBJ_CLASS(ocoms_rb_tree_node_t),
-            0,ocoms_cache_line_size,
-            0, -1 , 128, NULL, NULL, handle, NULL);
+    tree->nill = NULL;
+    tree->comp = NULL;
+    tree->chunks = NULL;
+    tree->arena_next = NULL;
+    tree->arena_end = NULL;
+    tree->node_size = sizeof(ocoms_rb_tree_node_t);
+    tree->free_nodes = NULL;
+    tree->tree_size = 0;
 }
 
 /* the destructor function */
 void ocoms_rb_tree_destruct(ocoms_object_t * object)
 {
-    if(NULL != ((ocoms_rb_tree_t *)object)->root_ptr) {
-        ocoms_rb_tree_destroy((ocoms_rb_tree_t *) object);
-    }
-    OBJ_DESTRUCT(&(((ocoms_rb_tree_t *)object)->free_list));
+    ocoms_rb_tree_destroy((ocoms_rb_tree_t *) object);
     return;
 }
 
@@ -73,32 +111,42 @@ void ocoms_rb_tree_destruct(ocoms_object_t * object)
 int ocoms_rb_tree_init(ocoms_rb_tree_t * tree,
                       ocoms_rb_tree_comp_fn_t comp)
 {
-    int rc;
+    return rb_tree_setup(tree, comp, sizeof(ocoms_rb_tree_node_t));
+}
 
-    ocoms_free_list_item_t * node;
-    /* we need to get memory for the root pointer from the free list */
-    OCOMS_FREE_LIST_GET(&(tree->free_list), node, rc);
-    tree->root_ptr = (ocoms_rb_tree_node_t *) node;
-    if (OCOMS_SUCCESS != rc) {
-        return rc;
-    }
+/* Create an interval tree */
+int ocoms_rb_tree_init_interval(ocoms_rb_tree_t * tree,
+                                ocoms_rb_tree_comp_fn_t comp)
+{
+    return rb_tree_setup(tree, comp, sizeof(ocoms_rb_tree_interval_node_t));
+}
 
-    OCOMS_FREE_LIST_GET(&(tree->free_list), node, rc);
-    if (OCOMS_SUCCESS != rc) {
-        return rc;
+static int rb_tree_setup(ocoms_rb_tree_t * tree, ocoms_rb_tree_comp_fn_t comp,
+                         size_t node_size)
+{
+    /* the released nodes and the rest of the current chunk were cut
+     * for the previous node size */
+    if (tree->node_size != node_size) {
+        tree->node_size = node_size;
+        tree->free_nodes = NULL;
+        tree->arena_next = tree->arena_end;
     }
-    tree->nill = (ocoms_rb_tree_node_t *) node;
+
+    /* the sentinels live in the tree itself */
+    tree->root_ptr = &tree->sentinels[0];
+    tree->nill = &tree->sentinels[1];
+
     /* initialize tree->nill */
-    tree->nill->color = BLACK;
+    tree->nill->parent_color = (uintptr_t) tree->nill;
+    rb_set_color(tree->nill, BLACK);
     tree->nill->left = tree->nill;
     tree->nill->right = tree->nill;
-    tree->nill->parent = tree->nill;
 
     /* initialize the 'root' pointer */
+    tree->root_ptr->parent_color = (uintptr_t) tree->nill;
+    rb_set_color(tree->root_ptr, BLACK);
     tree->root_ptr->left = tree->nill;
     tree->root_ptr->right = tree->nill;
-    tree->root_ptr->parent = tree->nill;
-    tree->root_ptr->color = BLACK;
 
     tree->comp = comp;
 
@@ -109,23 +157,74 @@ int ocoms_rb_tree_init(ocoms_rb_tree_t * tree,
 }
 
 
+/* Get a node: first from the released ones, then from the current
+ * arena chunk, allocating a new chunk when it is exhausted */
+static ocoms_rb_tree_node_t * node_alloc(ocoms_rb_tree_t *tree)
+{
+    ocoms_rb_tree_node_t * node = tree->free_nodes;
+    struct ocoms_rb_tree_chunk_t * chunk;
+
+    if (NULL != node) {
+        tree->free_nodes = node->right;
+        return node;
+    }
+    if (tree->arena_next == tree->arena_end) {
+        chunk = (struct ocoms_rb_tree_chunk_t *)
+            malloc(sizeof(struct ocoms_rb_tree_chunk_t) +
+                   OCOMS_RB_TREE_CHUNK_NODES * tree->node_size);
+        if (NULL == chunk) {
+            return NULL;
+        }
+        chunk->next = tree->chunks;
+        tree->chunks = chunk;
+        tree->arena_next = (unsigned char *) (chunk + 1);
+        tree->arena_end = tree->arena_next + OCOMS_RB_TREE_CHUNK_NODES * tree->node_size;
+    }
+    node = (ocoms_rb_tree_node_t *) tree->arena_next;
+    tree->arena_next += tree->node_size;
+    return node;
+}
+
+static void node_free(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t *node)
+{
+    node->right = tree->free_nodes;
+    tree->free_nodes = node;
+}
+
+
 /* This inserts a node into the tree based on the passed values. */
 int ocoms_rb_tree_insert(ocoms_rb_tree_t *tree, void * key, void * value)
+{
+    return rb_tree_insert(tree, key, key, value);
+}
+
+int ocoms_rb_tree_insert_interval(ocoms_rb_tree_t *tree, void *key, void *end, void *value)
+{
+    if (!RB_IS_INTERVAL(tree) || tree->comp(key, end) > 0) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+    return rb_tree_insert(tree, key, end, value);
+}
+
+static int rb_tree_insert(ocoms_rb_tree_t *tree, void *key, void *end, void *value)
 {
     ocoms_rb_tree_node_t * y;
     ocoms_rb_tree_node_t * node;
-    ocoms_free_list_item_t * item;
-    int rc;
+    ocoms_rb_tree_node_t * parent;
+    ocoms_rb_tree_node_t * grandparent;
 
     /* get the memory for a node */
-    OCOMS_FREE_LIST_GET(&(tree->free_list), item, rc);
-    if (OCOMS_SUCCESS != rc) {
-        return rc;
+    node = node_alloc(tree);
+    if (NULL == node) {
+        return OCOMS_ERR_TEMP_OUT_OF_RESOURCE;
     }
-    node = (ocoms_rb_tree_node_t *) item;
     /* insert the data into the node */
     node->key = key;
     node->value = value;
+    if (RB_IS_INTERVAL(tree)) {
+        RB_INTERVAL(node)->end = end;
+        RB_INTERVAL(node)->max_end = end;
+    }
 
     /* insert the node into the tree */
     btree_insert(tree, node);
@@ -133,43 +232,46 @@ int ocoms_rb_tree_insert(ocoms_rb_tree_t *tree, void * key, void * value)
     /*do the rotations */
     /* usually one would have to check for NULL, but because of the sentinal,
      * we don't have to   */
-    while (node->parent->color == RED) {
-        if (node->parent == node->parent->parent->left) {
-            y = node->parent->parent->right;
-            if (y->color == RED) {
-                node->parent->color = BLACK;
-                y->color = BLACK;
-                node->parent->parent->color = RED;
-                node = node->parent->parent;
+    while (RB_COLOR(parent = RB_PARENT(node)) == RED) {
+        grandparent = RB_PARENT(parent);
+        if (parent == grandparent->left) {
+            y = grandparent->right;
+            if (RB_COLOR(y) == RED) {
+                rb_set_color(parent, BLACK);
+                rb_set_color(y, BLACK);
+                rb_set_color(grandparent, RED);
+                node = grandparent;
             } else {
-                if (node == node->parent->right) {
-                    node = node->parent;
+                if (node == parent->right) {
+                    node = parent;
                     left_rotate(tree, node);
+                    parent = RB_PARENT(node);
                 }
-                node->parent->color = BLACK;
-                node->parent->parent->color = RED;
-                right_rotate(tree, node->parent->parent);
+                rb_set_color(parent, BLACK);
+                rb_set_color(grandparent, RED);
+                right_rotate(tree, grandparent);
             }
         } else {
-            y = node->parent->parent->left;
-            if (y->color == RED) {
-                node->parent->color = BLACK;
-                y->color = BLACK;
-                node->parent->parent->color = RED;
-                node = node->parent->parent;
+            y = grandparent->left;
+            if (RB_COLOR(y) == RED) {
+                rb_set_color(parent, BLACK);
+                rb_set_color(y, BLACK);
+                rb_set_color(grandparent, RED);
+                node = grandparent;
             } else {
-                if (node == node->parent->left) {
-                    node = node->parent;
+                if (node == parent->left) {
+                    node = parent;
                     right_rotate(tree, node);
+                    parent = RB_PARENT(node);
                 }
-                node->parent->color = BLACK;
-                node->parent->parent->color = RED;
-                left_rotate(tree, node->parent->parent);
+                rb_set_color(parent, BLACK);
+                rb_set_color(grandparent, RED);
+                left_rotate(tree, grandparent);
             }
         }
     }
     /* after the rotations the root is black */
-    tree->root_ptr->left->color = BLACK;
+    rb_set_color(tree->root_ptr->left, BLACK);
     return OCOMS_SUCCESS;
 }
 
@@ -216,18 +318,98 @@ static ocoms_rb_tree_node_t * ocoms_rb_tree_find_node(ocoms_rb_tree_t *tree, voi
     return(NULL);
 }
 
+/* Finds the leftmost node whose key is not less than the passed key */
+static ocoms_rb_tree_node_t * lower_bound_node(ocoms_rb_tree_t *tree, void *key)
+{
+    ocoms_rb_tree_node_t * node;
+    ocoms_rb_tree_node_t * bound = NULL;
+
+    node = tree->root_ptr->left;
+    while (node != tree->nill) {
+        /* equal keys may sit in both subtrees: keep going left */
+        if (tree->comp(key, node->key) <= 0) {
+            bound = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return bound;
+}
+
+void * ocoms_rb_tree_lower_bound(ocoms_rb_tree_t *tree, void *key, void **found_key)
+{
+    ocoms_rb_tree_node_t * bound = lower_bound_node(tree, key);
+
+    if (NULL == bound) {
+        return(NULL);
+    }
+    if (NULL != found_key) {
+        *found_key = bound->key;
+    }
+    return(bound->value);
+}
+
+/* Visit in order the nodes whose key lies in [lo_key, hi_key] */
+int ocoms_rb_tree_find_range(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                             ocoms_rb_tree_visit_fn_t visit, void *context)
+{
+    if (NULL == visit) {
+        return(OCOMS_ERR_BAD_PARAM);
+    }
+    return inorder_range(tree, lo_key, hi_key, visit, context, tree->root_ptr->left);
+}
+
+/* Visit in order the entries which overlap [lo_key, hi_key] */
+int ocoms_rb_tree_find_overlapping(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                                   ocoms_rb_tree_visit_fn_t visit, void *context)
+{
+    if (NULL == visit) {
+        return(OCOMS_ERR_BAD_PARAM);
+    }
+    /* without intervals, overlapping means lying in the range */
+    if (!RB_IS_INTERVAL(tree)) {
+        return inorder_range(tree, lo_key, hi_key, visit, context, tree->root_ptr->left);
+    }
+    return interval_search(tree, lo_key, hi_key, visit, context, tree->root_ptr->left);
+}
+
 /* Delete a node from the tree based on the key */
 int ocoms_rb_tree_delete(ocoms_rb_tree_t *tree, void *key)
 {
     ocoms_rb_tree_node_t * p;
-    ocoms_rb_tree_node_t * todelete;
-    ocoms_rb_tree_node_t * y;
-    ocoms_free_list_item_t * item;
 
     p = ocoms_rb_tree_find_node(tree, key);
     if (NULL == p) {
         return(OCOMS_ERR_NOT_FOUND);
     }
+    rb_tree_delete_node(tree, p);
+    return(OCOMS_SUCCESS);
+}
+
+/* Delete the node with the passed key and value, walking the nodes
+ * with an equal key in order */
+int ocoms_rb_tree_delete_entry(ocoms_rb_tree_t *tree, void *key, void *value)
+{
+    ocoms_rb_tree_node_t * p = lower_bound_node(tree, key);
+
+    while (NULL != p && p != tree->nill && 0 == tree->comp(key, p->key)) {
+        if (p->value == value) {
+            rb_tree_delete_node(tree, p);
+            return(OCOMS_SUCCESS);
+        }
+        p = btree_successor(tree, p);
+    }
+    return(OCOMS_ERR_NOT_FOUND);
+}
+
+static void rb_tree_delete_node(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t *p)
+{
+    ocoms_rb_tree_node_t * todelete;
+    ocoms_rb_tree_node_t * y;
+    ocoms_rb_tree_node_t * parent;
+    ocoms_rb_tree_node_t * n;
+
     if ((p->left == tree->nill) || (p->right == tree->nill)) {
         todelete = p;
     } else {
@@ -240,48 +422,59 @@ int ocoms_rb_tree_delete(ocoms_rb_tree_t *tree, void *key)
         y = todelete->left;
     }
 
-    y->parent = todelete->parent;
+    parent = RB_PARENT(todelete);
+    rb_set_parent(y, parent);
 
-    if (y->parent == tree->root_ptr) {
+    if (parent == tree->root_ptr) {
         tree->root_ptr->left = y;
     } else {
-        if (todelete == todelete->parent->left) {
-         todelete->parent->left = y;
+        if (todelete == parent->left) {
+            parent->left = y;
         } else {
-            todelete->parent->right = y;
+            parent->right = y;
         }
     }
 
     if (todelete != p) {
         p->key = todelete->key;
         p->value = todelete->value;
+        if (RB_IS_INTERVAL(tree)) {
+            RB_INTERVAL(p)->end = RB_INTERVAL(todelete)->end;
+        }
     }
 
-    if (todelete->color == BLACK) {
+    /* p lies on the path from the spliced out node to the root: fix
+     * the greatest ends along it before the rotations of the fixup */
+    if (RB_IS_INTERVAL(tree)) {
+        for (n = parent; n != tree->root_ptr; n = RB_PARENT(n)) {
+            update_max_end(tree, n);
+        }
+    }
+
+    if (RB_COLOR(todelete) == BLACK) {
         btree_delete_fixup(tree, y);
     }
-    item = (ocoms_free_list_item_t *) todelete;
-    OCOMS_FREE_LIST_RETURN(&(tree->free_list), item);
+    node_free(tree, todelete);
     --tree->tree_size;
-    return(OCOMS_SUCCESS);
 }
 
 
 /* Destroy the hashmap    */
 int ocoms_rb_tree_destroy(ocoms_rb_tree_t *tree)
 {
-    ocoms_free_list_item_t * item;
-    /* Recursive inorder traversal for delete    */
+    struct ocoms_rb_tree_chunk_t * chunk;
 
-    inorder_destroy(tree, tree->root_ptr);
-    /* Now free the root -- root does not get free'd in the above
-     * inorder destroy    */
-    item = (ocoms_free_list_item_t *) tree->root_ptr;
-    OCOMS_FREE_LIST_RETURN(&(tree->free_list), item);
-
-    /* free the tree->nill node */
-    item = (ocoms_free_list_item_t *) tree->nill;
-    OCOMS_FREE_LIST_RETURN(&(tree->free_list), item);
+    /* all the nodes come from the arena: no need to walk the tree */
+    while (NULL != (chunk = tree->chunks)) {
+        tree->chunks = chunk->next;
+        free(chunk);
+    }
+    tree->arena_next = NULL;
+    tree->arena_end = NULL;
+    tree->free_nodes = NULL;
+    tree->root_ptr = NULL;
+    tree->nill = NULL;
+    tree->tree_size = 0;
     return(OCOMS_SUCCESS);
 }
 
@@ -293,10 +486,10 @@ static ocoms_rb_tree_node_t * btree_successor(ocoms_rb_tree_t * tree, ocoms_rb_t
     ocoms_rb_tree_node_t * p;
 
     if (node->right == tree->nill) {
-        p = node->parent;
+        p = RB_PARENT(node);
         while (node == p->right) {
             node = p;
-            p = p->parent;
+            p = RB_PARENT(p);
         }
         if(p == tree->root_ptr) {
             return(tree->nill);
@@ -320,14 +513,13 @@ static void btree_insert(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * node)
     ocoms_rb_tree_node_t * parent = tree->root_ptr;
     ocoms_rb_tree_node_t * n = parent->left; /* the real root of the tree */
 
-    /* set up initial values for the node */
-    node->color = RED;
-    node->parent = NULL;
-    node->left = tree->nill;
-    node->right = tree->nill;
-
-    /* find the leaf where we will insert the node */
+    /* find the leaf where we will insert the node, the new interval
+     * will be part of the subtrees of all the nodes on the way */
     while (n != tree->nill) {
+        if (RB_IS_INTERVAL(tree) &&
+            tree->comp(RB_INTERVAL(node)->end, RB_INTERVAL(n)->max_end) > 0) {
+            RB_INTERVAL(n)->max_end = RB_INTERVAL(node)->end;
+        }
         parent = n;
         n = ((tree->comp(node->key, n->key) <= 0) ? n->left : n->right);
     }
@@ -339,8 +531,9 @@ static void btree_insert(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * node)
         parent->right = node;
     }
 
-    /* set its parent and children */
-    node->parent = parent;
+    /* set its parent, color and children */
+    node->parent_color = (uintptr_t) parent;
+    rb_set_color(node, RED);
     node->left = tree->nill;
     node->right = tree->nill;
     ++(tree->tree_size);
@@ -351,92 +544,67 @@ static void btree_insert(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * node)
 static void btree_delete_fixup(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x)
 {
     ocoms_rb_tree_node_t * w;
+    ocoms_rb_tree_node_t * parent;
     ocoms_rb_tree_node_t * root = tree->root_ptr->left;
-    while ((x != root) && (x->color == BLACK)) {
-        if (x == x->parent->left) {
-            w = x->parent->right;
-            if (w->color == RED) {
-                w->color = BLACK;
-                x->parent->color = RED;
-                left_rotate(tree, x->parent);
-                w = x->parent->right;
+    while ((x != root) && (RB_COLOR(x) == BLACK)) {
+        parent = RB_PARENT(x);
+        if (x == parent->left) {
+            w = parent->right;
+            if (RB_COLOR(w) == RED) {
+                rb_set_color(w, BLACK);
+                rb_set_color(parent, RED);
+                left_rotate(tree, parent);
+                w = parent->right;
             }
-            if ((w->left->color == BLACK) && (w->right->color == BLACK)) {
-                w->color = RED;
-                x = x->parent;
+            if ((RB_COLOR(w->left) == BLACK) && (RB_COLOR(w->right) == BLACK)) {
+                rb_set_color(w, RED);
+                x = parent;
             } else {
-                if (w->right->color == BLACK) {
-                    w->left->color = BLACK;
-                    w->color = RED;
+                if (RB_COLOR(w->right) == BLACK) {
+                    rb_set_color(w->left, BLACK);
+                    rb_set_color(w, RED);
                     right_rotate(tree, w);
-                    w = x->parent->right;
+                    w = parent->right;
                 }
-                w->color = x->parent->color;
-                x->parent->color = BLACK;
-                w->right->color = BLACK;
-                left_rotate(tree, x->parent);
+                rb_set_color(w, RB_COLOR(parent));
+                rb_set_color(parent, BLACK);
+                rb_set_color(w->right, BLACK);
+                left_rotate(tree, parent);
                 x = root;
             }
         } else { /* right    */
 
-            w = x->parent->left;
-            if (w->color == RED) {
-                w->color = BLACK;
-                x->parent->color = RED;
-                right_rotate(tree, x->parent);
-                w = x->parent->left;
+            w = parent->left;
+            if (RB_COLOR(w) == RED) {
+                rb_set_color(w, BLACK);
+                rb_set_color(parent, RED);
+                right_rotate(tree, parent);
+                w = parent->left;
             }
-            if ((w->right->color == BLACK) && (w->left->color == BLACK)) {
-                w->color = RED;
-                x = x->parent;
+            if ((RB_COLOR(w->right) == BLACK) && (RB_COLOR(w->left) == BLACK)) {
+                rb_set_color(w, RED);
+                x = parent;
             } else {
-                if (w->left->color == BLACK) {
-                    w->right->color = BLACK;
-                    w->color = RED;
+                if (RB_COLOR(w->left) == BLACK) {
+                    rb_set_color(w->right, BLACK);
+                    rb_set_color(w, RED);
                     left_rotate(tree, w);
-                    w = x->parent->left;
+                    w = parent->left;
                 }
-                w->color = x->parent->color;
-                x->parent->color = BLACK;
-                w->left->color = BLACK;
-                right_rotate(tree, x->parent);
+                rb_set_color(w, RB_COLOR(parent));
+                rb_set_color(parent, BLACK);
+                rb_set_color(w->left, BLACK);
+                right_rotate(tree, parent);
                 x = root;
             }
         }
     }
 
-    x->color = BLACK;
+    rb_set_color(x, BLACK);
     return;
 }
 
 
-/* Free the nodes in inorder fashion    */
-
-static void
-inorder_destroy(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * node)
-{
-    ocoms_free_list_item_t * item;
-
-    if (node == tree->nill) {
-        return;
-    }
-
-    inorder_destroy(tree, node->left);
-
-    if (node->left != tree->nill) {
-        item = (ocoms_free_list_item_t *) node->left;
-        --tree->tree_size;
-        OCOMS_FREE_LIST_RETURN(&(tree->free_list), item);
-    }
-
-    inorder_destroy(tree, node->right);
-    if (node->right != tree->nill) {
-        item = (ocoms_free_list_item_t *) node->right;
-        --tree->tree_size;
-        OCOMS_FREE_LIST_RETURN(&(tree->free_list), item);
-    }
-}
-
 /* Try to access all the elements of the hashmap conditionally */
 
 int ocoms_rb_tree_traverse(ocoms_rb_tree_t *tree,
@@ -471,33 +639,120 @@ static void inorder_traversal(ocoms_rb_tree_t *tree,
     inorder_traversal(tree, cond, action, node->right);
 }
 
+/* In order traversal restricted to the subtrees which may hold keys
+ * in [lo_key, hi_key]    */
+static int inorder_range(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                         ocoms_rb_tree_visit_fn_t visit, void *context,
+                         ocoms_rb_tree_node_t * node)
+{
+    int lo_comp, hi_comp, rc;
+
+    while (node != tree->nill) {
+        lo_comp = tree->comp(lo_key, node->key);
+        hi_comp = tree->comp(hi_key, node->key);
+
+        if (lo_comp <= 0) {
+            rc = inorder_range(tree, lo_key, hi_key, visit, context, node->left);
+            if (OCOMS_SUCCESS != rc) {
+                return rc;
+            }
+            if (hi_comp >= 0) {
+                rc = visit(node->key, node->value, context);
+                if (OCOMS_SUCCESS != rc) {
+                    return rc;
+                }
+            }
+        }
+        if (hi_comp < 0) {
+            break;
+        }
+        /* iterate, rather than recurse, on the right subtree */
+        node = node->right;
+    }
+    return OCOMS_SUCCESS;
+}
+
+/* In order traversal of an interval tree, skipping the subtrees whose
+ * intervals all end before lo_key or start after hi_key    */
+static int interval_search(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                           ocoms_rb_tree_visit_fn_t visit, void *context,
+                           ocoms_rb_tree_node_t * node)
+{
+    int rc;
+
+    while (node != tree->nill) {
+        if (tree->comp(lo_key, RB_INTERVAL(node)->max_end) > 0) {
+            break;
+        }
+        rc = interval_search(tree, lo_key, hi_key, visit, context, node->left);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+        if (tree->comp(hi_key, node->key) < 0) {
+            break;
+        }
+        if (tree->comp(lo_key, RB_INTERVAL(node)->end) <= 0) {
+            rc = visit(node->key, node->value, context);
+            if (OCOMS_SUCCESS != rc) {
+                return rc;
+            }
+        }
+        node = node->right;
+    }
+    return OCOMS_SUCCESS;
+}
+
+/* Recompute the greatest end of the subtree rooted at node from its
+ * children    */
+static void update_max_end(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t *node)
+{
+    void *max_end = RB_INTERVAL(node)->end;
+
+    /* the nill sentinel has no interval part */
+    if (node->left != tree->nill &&
+        tree->comp(RB_INTERVAL(node->left)->max_end, max_end) > 0) {
+        max_end = RB_INTERVAL(node->left)->max_end;
+    }
+    if (node->right != tree->nill &&
+        tree->comp(RB_INTERVAL(node->right)->max_end, max_end) > 0) {
+        max_end = RB_INTERVAL(node->right)->max_end;
+    }
+    RB_INTERVAL(node)->max_end = max_end;
+}
+
 /* Left rotate the tree    */
 /* basically what we want to do is to make x be the left child
  * of its right child    */
 static void left_rotate(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x)
 {
     ocoms_rb_tree_node_t * y;
+    ocoms_rb_tree_node_t * parent = RB_PARENT(x);
 
     y = x->right;
     /* make the left child of y's parent be x if it is not the sentinal node*/
     if (y->left != tree->nill) {
-        y->left->parent=x;
+        rb_set_parent(y->left, x);
     }
 
     /* normlly we would have to check to see if we are at the root.
      * however, the root sentinal takes care of it for us */
-    if (x == x->parent->left) {
-        x->parent->left = y;
+    if (x == parent->left) {
+        parent->left = y;
     } else {
-        x->parent->right = y;
+        parent->right = y;
     }
     /* the old parent of x is now y's parent */
-    y->parent = x->parent;
+    rb_set_parent(y, parent);
     /* x's parent is y */
-    x->parent = y;
+    rb_set_parent(x, y);
     x->right = y->left;
     y->left = x;
 
+    /* y now roots the former subtree of x */
+    if (RB_IS_INTERVAL(tree)) {
+        RB_INTERVAL(y)->max_end = RB_INTERVAL(x)->max_end;
+        update_max_end(tree, x);
+    }
     return;
 }
 
@@ -508,24 +763,29 @@ static void left_rotate(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x)
 static void right_rotate(ocoms_rb_tree_t *tree, ocoms_rb_tree_node_t * x)
 {
     ocoms_rb_tree_node_t * y;
+    ocoms_rb_tree_node_t * parent = RB_PARENT(x);
 
     y = x->left;
 
     if(y->right != tree->nill) {
-        y->right->parent = x;
+        rb_set_parent(y->right, x);
     }
 
-    if (x == x->parent->left) {
-        x->parent->left = y;
+    if (x == parent->left) {
+        parent->left = y;
     } else {
-        x->parent->right = y;
+        parent->right = y;
     }
 
-    y->parent = x->parent;
-    x->parent = y;
+    rb_set_parent(y, parent);
+    rb_set_parent(x, y);
     x->left = y->right;
     y->right = x;
 
+    if (RB_IS_INTERVAL(tree)) {
+        RB_INTERVAL(y)->max_end = RB_INTERVAL(x)->max_end;
+        update_max_end(tree, x);
+    }
     return;
 }
 
@@ -22,6 +22,20 @@
 /** @file
  *
  *     A red black tree
+ *
+ *     The nodes are kept compact (five words, with the color packed in
+ *     the low bit of the parent pointer) and are carved out of large
+ *     contiguous chunks owned by the tree, so that a lookup touches as
+ *     few cache lines as possible.  Released nodes are recycled by the
+ *     same tree; the chunks are only returned to the system when the
+ *     tree is destroyed.
+ *
+ *     A tree initialized with ocoms_rb_tree_init_interval is an interval
+ *     tree: each entry covers the keys [key, end], and every node also
+ *     records the greatest end found in its subtree, so that the entries
+ *     overlapping a range are found in O(log n + k).  This is what the
+ *     registration caches need to invalidate the ranges passed to the
+ *     memory release hooks.
  */
 
 #ifndef OMPI_RB_TREE_H
@@ -32,6 +46,7 @@
 #include "ocoms/platform/ocoms_constants.h"
 #include "ocoms/util/ocoms_object.h"
 #include "ocoms/util/ocoms_free_list.h"
+#include "ocoms/threads/condition.h"
 
 BEGIN_C_DECLS
 /*
@@ -39,7 +54,8 @@ BEGIN_C_DECLS
  */
 
 /**
-  * red and black enum
+  * red and black enum.  The value is stored in the low bit of the
+  * parent pointer of each node.
   */
 typedef enum {RED, BLACK} ocoms_rb_tree_nodecolor_t;
 
@@ -48,9 +64,7 @@ typedef enum {RED, BLACK} ocoms_rb_tree_nodecolor_t;
   */
 struct ocoms_rb_tree_node_t
 {
-    ocoms_free_list_item_t super;             /**< the parent class */
-    ocoms_rb_tree_nodecolor_t color;     /**< the node color */
-    struct ocoms_rb_tree_node_t * parent;/**< the parent node, can be NULL */
+    uintptr_t parent_color;              /**< the parent node, with the color in bit 0 */
     struct ocoms_rb_tree_node_t * left;  /**< the left child - can be nill */
     struct ocoms_rb_tree_node_t * right; /**< the right child - can be nill */
     void *key;                          /**< a pointer to the key */
@@ -58,6 +72,50 @@ struct ocoms_rb_tree_node_t
 };
 typedef struct ocoms_rb_tree_node_t ocoms_rb_tree_node_t;
 
+/*
+ * The nodes used to be ocoms_free_list_item_t objects with color and
+ * parent fields.  They are now plain structures carved out of the arena
+ * of their tree: ocoms_rb_tree_node_t is no longer a class, and the
+ * color and the parent are read with the accessors below.
+ */
+
+/**
+  * the color of a node
+  */
+static inline ocoms_rb_tree_nodecolor_t
+ocoms_rb_tree_node_color(const ocoms_rb_tree_node_t *node)
+{
+    return (ocoms_rb_tree_nodecolor_t) (node->parent_color & 1);
+}
+
+/**
+  * the parent of a node
+  */
+static inline ocoms_rb_tree_node_t *
+ocoms_rb_tree_node_parent(const ocoms_rb_tree_node_t *node)
+{
+    return (ocoms_rb_tree_node_t *) (node->parent_color & ~((uintptr_t) 1));
+}
+
+/**
+  * node data structure of an interval tree: the nodes of the arena are
+  * extended with the end of the interval, and the greatest end of the
+  * subtree rooted at the node
+  */
+struct ocoms_rb_tree_interval_node_t
+{
+    ocoms_rb_tree_node_t node;          /**< the plain node, key is the start */
+    void *end;                          /**< the last key covered by the entry */
+    void *max_end;                      /**< the greatest end in the subtree */
+};
+typedef struct ocoms_rb_tree_interval_node_t ocoms_rb_tree_interval_node_t;
+
+/** number of nodes carved out of each arena chunk */
+#define OCOMS_RB_TREE_CHUNK_NODES 256
+
+/** \internal a chunk of the node arena */
+struct ocoms_rb_tree_chunk_t;
+
 /**
   * the compare function typedef. This function is used to compare 2 nodes.
   */
@@ -74,13 +132,17 @@ struct ocoms_rb_tree_t {
     ocoms_rb_tree_node_t * root_ptr;/**< a pointer to the root of the tree */
     ocoms_rb_tree_node_t * nill;     /**< the nill sentinal node */
     ocoms_rb_tree_comp_fn_t comp;    /**< the compare function */
-    ocoms_free_list_t free_list;   /**< the free list to get the memory from */
+    ocoms_rb_tree_node_t sentinels[2]; /**< storage for *root_ptr and *nill */
+    struct ocoms_rb_tree_chunk_t *chunks; /**< the arena chunks, most recent first */
+    unsigned char *arena_next;       /**< next unused node of the current chunk */
+    unsigned char *arena_end;        /**< end of the current chunk */
+    size_t node_size;                /**< the size of a node in the arena, larger
+                                          for an interval tree */
+    ocoms_rb_tree_node_t *free_nodes;/**< released nodes, chained through right */
     size_t tree_size;                  /**< the size of the tree */
 };
 typedef struct ocoms_rb_tree_t ocoms_rb_tree_t;
 
-/** declare the tree node as a class */
-OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_rb_tree_node_t);
 /** declare the tree as a class */
 OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_rb_tree_t);
 
@@ -98,6 +160,13 @@ typedef int (*ocoms_rb_tree_condition_fn_t)(void *);
   * mess up the tree.
   */
 typedef void (*ocoms_rb_tree_action_fn_t)(void *, void *);
+/**
+  * this function is used by the range lookups. It is passed the key
+  * and the value of each node in the range, in order, together with the
+  * user supplied context. Returning anything but OCOMS_SUCCESS stops
+  * the lookup, and the value is returned to the caller.
+  */
+typedef int (*ocoms_rb_tree_visit_fn_t)(void *key, void *value, void *context);
 
 /*
  * Public function protoypes
@@ -131,6 +200,20 @@ OCOMS_DECLSPEC void ocoms_rb_tree_destruct(ocoms_object_t * object);
   */
 OCOMS_DECLSPEC int ocoms_rb_tree_init(ocoms_rb_tree_t * tree, ocoms_rb_tree_comp_fn_t comp);
 
+/**
+  * the function creates a new interval tree. Entries inserted with
+  * ocoms_rb_tree_insert cover a single key.
+  *
+  * @param tree a pointer to an allocated area of memory for the main
+  *  tree data structure.
+  * @param comp a pointer to the function to use for comaparing 2 keys,
+  *  which is also used on the ends of the intervals
+  *
+  * @retval OCOMS_SUCCESS if it is successful
+  */
+OCOMS_DECLSPEC int ocoms_rb_tree_init_interval(ocoms_rb_tree_t * tree,
+                                               ocoms_rb_tree_comp_fn_t comp);
+
 
 /**
   * inserts a node into the tree
@@ -144,6 +227,23 @@ OCOMS_DECLSPEC int ocoms_rb_tree_init(ocoms_rb_tree_t * tree, ocoms_rb_tree_comp
   */
 OCOMS_DECLSPEC int ocoms_rb_tree_insert(ocoms_rb_tree_t *tree, void * key, void * value);
 
+/**
+  * inserts an interval into an interval tree
+  *
+  * @param tree a pointer to the tree data structure
+  * @param key the first key covered by the interval, used as the key
+  *  of the entry
+  * @param end the last key covered by the interval
+  * @param value the value for the entry
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_BAD_PARAM if the tree is not an interval tree or
+  *  end is less than key
+  * @retval OCOMS_ERR_TEMP_OUT_OF_RESOURCE if unsuccessful
+  */
+OCOMS_DECLSPEC int ocoms_rb_tree_insert_interval(ocoms_rb_tree_t *tree, void *key, void *end,
+                                                 void *value);
+
 /**
   * finds a value in the tree based on the passed key using passed
   * compare function
@@ -171,6 +271,57 @@ static inline void * ocoms_rb_tree_find(ocoms_rb_tree_t *tree, void *key)
         return ocoms_rb_tree_find_with(tree, key, tree->comp);
 }
 
+/**
+  * finds the first node whose key is not less than the passed key
+  *
+  * @param tree a pointer to the tree data structure
+  * @param key a pointer to the key
+  * @param found_key if not NULL, set to the key of the node found
+  *
+  * @retval pointer to the value of the node found
+  * @retval NULL if all the keys of the tree are less than key
+  */
+OCOMS_DECLSPEC void * ocoms_rb_tree_lower_bound(ocoms_rb_tree_t *tree, void *key,
+                                                void **found_key);
+
+/**
+  * calls a function, in order, on all the nodes whose key lies
+  * between two keys (both included)
+  *
+  * @param tree a pointer to the tree data structure
+  * @param lo_key a pointer to the lowest key of the range
+  * @param hi_key a pointer to the highest key of the range
+  * @param visit the function to call on each node of the range
+  * @param context passed to visit
+  *
+  * @retval OCOMS_SUCCESS if all the nodes in the range were visited
+  * @retval the value returned by visit if it stopped the lookup
+  *
+  * The tree must not be modified from visit.
+  */
+OCOMS_DECLSPEC int ocoms_rb_tree_find_range(ocoms_rb_tree_t *tree, void *lo_key, void *hi_key,
+                                            ocoms_rb_tree_visit_fn_t visit, void *context);
+
+/**
+  * calls a function, in key order, on all the entries of an interval
+  * tree which overlap the interval [lo_key, hi_key]. The entries of a
+  * tree which is not an interval tree cover a single key.
+  *
+  * @param tree a pointer to the tree data structure
+  * @param lo_key a pointer to the lowest key of the range
+  * @param hi_key a pointer to the highest key of the range
+  * @param visit the function to call on each overlapping entry
+  * @param context passed to visit
+  *
+  * @retval OCOMS_SUCCESS if all the overlapping entries were visited
+  * @retval the value returned by visit if it stopped the lookup
+  *
+  * The tree must not be modified from visit.
+  */
+OCOMS_DECLSPEC int ocoms_rb_tree_find_overlapping(ocoms_rb_tree_t *tree, void *lo_key,
+                                                  void *hi_key, ocoms_rb_tree_visit_fn_t visit,
+                                                  void *context);
+
 /**
   * deletes a node based on its key
   *
@@ -183,7 +334,22 @@ static inline void * ocoms_rb_tree_find(ocoms_rb_tree_t *tree, void *key)
 OCOMS_DECLSPEC int ocoms_rb_tree_delete(ocoms_rb_tree_t *tree, void *key);
 
 /**
-  * frees all the nodes on the tree
+  * deletes the node with both the passed key and the passed value,
+  * when several nodes may share the same key
+  *
+  * @param tree a pointer to the tree data structure
+  * @param key a pointer to the key
+  * @param value the value of the node
+  *
+  * @retval OCOMS_SUCCESS if the node is found and deleted
+  * @retval OCOMS_ERR_NOT_FOUND if the node is not found
+  */
+OCOMS_DECLSPEC int ocoms_rb_tree_delete_entry(ocoms_rb_tree_t *tree, void *key, void *value);
+
+/**
+  * frees all the nodes on the tree, and the arena they come from.
+  * ocoms_rb_tree_init has to be called again before the tree can be
+  * reused.
   *
   * @param tree a pointer to the tree data structure
   *
@@ -215,18 +381,23 @@ OCOMS_DECLSPEC int ocoms_rb_tree_traverse(ocoms_rb_tree_t *tree,
   */
 OCOMS_DECLSPEC int ocoms_rb_tree_size(ocoms_rb_tree_t *tree);
 
+/*
+ * The progress function used to be called while waiting on the node
+ * free list. Node allocation from the arena never waits, so it is
+ * ignored; the argument is kept for source compatibility.
+ */
 #define CONSTRUCT_RB_TREE(object, progress) do {\
     OBJ_CONSTRUCT(object, ocoms_rb_tree_t);\
-    ((ocoms_rb_tree_t *)object)->free_list.fl_condition.ocoms_progress_fn = progress;\
+    (void) (progress);\
     }\
     while(0);
 
 static inline int ocoms_rb_tree_new(ocoms_rb_tree_t **rb_tree, ocoms_progress_fn_t progress)
 {
     ocoms_rb_tree_t *rbt = OBJ_NEW(ocoms_rb_tree_t);
-    rbt->free_list.fl_condition.ocoms_progress_fn = progress;
+    (void) progress;
     *rb_tree = rbt;
-    return OCOMS_SUCCESS;
+    return (NULL != rbt) ? OCOMS_SUCCESS : OCOMS_ERR_OUT_OF_RESOURCE;
 }
 END_C_DECLS
 #endif /* OMPI_RB_TREE_H */
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/primitives/bit_ops.h"
+#include "ocoms/util/ocoms_timer_wheel.h"
+
+#define SLOT_MASK ((uint64_t) OCOMS_TIMER_WHEEL_SLOTS - 1)
+
+/* slot of the passed tick at the passed level */
+#define SLOT_INDEX(tick, level) \
+    (((tick) >> ((level) * OCOMS_TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK)
+
+/* number of ticks spanned by the whole wheel */
+#define WHEEL_SPAN ((uint64_t) 1 << (OCOMS_TIMER_WHEEL_LEVELS * OCOMS_TIMER_WHEEL_SLOT_BITS))
+
+static void ocoms_timer_wheel_event_construct(ocoms_timer_wheel_event_t *event);
+static void ocoms_timer_wheel_construct(ocoms_timer_wheel_t *wheel);
+static void ocoms_timer_wheel_destruct(ocoms_timer_wheel_t *wheel);
+
+OBJ_CLASS_INSTANCE(ocoms_timer_wheel_event_t, ocoms_list_item_t,
+                   ocoms_timer_wheel_event_construct, NULL);
+
+OBJ_CLASS_INSTANCE(ocoms_timer_wheel_t, ocoms_object_t,
+                   ocoms_timer_wheel_construct, ocoms_timer_wheel_destruct);
+
+
+static void ocoms_timer_wheel_event_construct(ocoms_timer_wheel_event_t *event)
+{
+    event->expire_tick = 0;
+    event->slot = NULL;
+    event->cbfunc = NULL;
+    event->cbdata = NULL;
+}
+
+static void ocoms_timer_wheel_construct(ocoms_timer_wheel_t *wheel)
+{
+    int level, slot;
+
+    wheel->origin = 0;
+    wheel->tick_cycles = 1;
+    wheel->next_cycles = 0;
+    wheel->now_tick = 0;
+    wheel->num_events = 0;
+    wheel->slot_mask = 0;
+    OBJ_CONSTRUCT(&wheel->expired, ocoms_list_t);
+    for (level = 0; level < OCOMS_TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < OCOMS_TIMER_WHEEL_SLOTS; slot++) {
+            OBJ_CONSTRUCT(&wheel->slots[level][slot], ocoms_list_t);
+        }
+    }
+}
+
+/* unlinks all the events of a list, leaving them unscheduled */
+static void orphan_events(ocoms_list_t *list)
+{
+    ocoms_timer_wheel_event_t *event;
+
+    while (NULL != (event = (ocoms_timer_wheel_event_t *) ocoms_list_remove_first(list))) {
+        event->slot = NULL;
+    }
+}
+
+static void ocoms_timer_wheel_destruct(ocoms_timer_wheel_t *wheel)
+{
+    int level, slot;
+
+    orphan_events(&wheel->expired);
+    OBJ_DESTRUCT(&wheel->expired);
+    for (level = 0; level < OCOMS_TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < OCOMS_TIMER_WHEEL_SLOTS; slot++) {
+            orphan_events(&wheel->slots[level][slot]);
+            OBJ_DESTRUCT(&wheel->slots[level][slot]);
+        }
+    }
+    wheel->num_events = 0;
+}
+
+/* moves now_tick forward, keeping next_cycles in sync */
+static inline void set_now_tick(ocoms_timer_wheel_t *wheel, uint64_t tick)
+{
+    wheel->now_tick = tick;
+    wheel->next_cycles = wheel->origin + tick * wheel->tick_cycles;
+}
+
+/* the first tick at or after the passed time */
+static inline uint64_t tick_of(ocoms_timer_wheel_t *wheel, uint64_t cycles)
+{
+    if (cycles <= wheel->origin) {
+        return 0;
+    }
+    return (cycles - wheel->origin + wheel->tick_cycles - 1) / wheel->tick_cycles;
+}
+
+int ocoms_timer_wheel_init(ocoms_timer_wheel_t *wheel, uint64_t tick_cycles)
+{
+    if (0 == tick_cycles) {
+        return OCOMS_ERR_BAD_PARAM;
+    }
+    wheel->origin = ocoms_timer_wheel_get_cycles();
+    wheel->tick_cycles = tick_cycles;
+    set_now_tick(wheel, 0);
+    return OCOMS_SUCCESS;
+}
+
+/* links an event into the slot matching its expiry tick */
+static void link_event(ocoms_timer_wheel_t *wheel, ocoms_timer_wheel_event_t *event)
+{
+    uint64_t expire = event->expire_tick;
+    uint64_t delta;
+    int level;
+
+    if (expire < wheel->now_tick) {
+        expire = wheel->now_tick;
+    }
+    delta = expire - wheel->now_tick;
+    if (delta >= WHEEL_SPAN) {
+        /* out of range: park it in the top level, it is linked again
+         * when that slot is cascaded */
+        delta = WHEEL_SPAN - 1;
+        expire = wheel->now_tick + delta;
+    }
+
+    for (level = 0; level < OCOMS_TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < ((uint64_t) 1 << ((level + 1) * OCOMS_TIMER_WHEEL_SLOT_BITS))) {
+            break;
+        }
+    }
+    event->slot = &wheel->slots[level][SLOT_INDEX(expire, level)];
+    ocoms_list_append(event->slot, &event->super);
+    if (0 == level) {
+        wheel->slot_mask |= (uint64_t) 1 << SLOT_INDEX(expire, 0);
+    }
+}
+
+static void unlink_event(ocoms_timer_wheel_t *wheel, ocoms_timer_wheel_event_t *event)
+{
+    ocoms_list_t *slot = event->slot;
+
+    ocoms_list_remove_item(slot, &event->super);
+    event->slot = NULL;
+    if (slot >= &wheel->slots[0][0] && slot < &wheel->slots[0][OCOMS_TIMER_WHEEL_SLOTS] &&
+        ocoms_list_is_empty(slot)) {
+        wheel->slot_mask &= ~((uint64_t) 1 << (slot - &wheel->slots[0][0]));
+    }
+}
+
+void ocoms_timer_wheel_add(ocoms_timer_wheel_t *wheel, ocoms_timer_wheel_event_t *event,
+                           uint64_t deadline)
+{
+    if (NULL != event->slot) {
+        unlink_event(wheel, event);
+    } else {
+        if (0 == wheel->num_events) {
+            /* the wheel does not turn while it is empty, catch up with
+             * the current time so the new event is placed relative to it */
+            uint64_t now = ocoms_timer_wheel_get_cycles();
+            if (now >= wheel->next_cycles) {
+                set_now_tick(wheel, (now - wheel->origin) / wheel->tick_cycles);
+            }
+        }
+        wheel->num_events++;
+    }
+    event->expire_tick = tick_of(wheel, deadline);
+    link_event(wheel, event);
+}
+
+int ocoms_timer_wheel_cancel(ocoms_timer_wheel_t *wheel, ocoms_timer_wheel_event_t *event)
+{
+    if (NULL == event->slot) {
+        return OCOMS_ERR_NOT_FOUND;
+    }
+    unlink_event(wheel, event);
+    wheel->num_events--;
+    return OCOMS_SUCCESS;
+}
+
+/* links again the events of a slot of an upper level, which now fall
+ * in lower levels.  Returns the index of the slot. */
+static int cascade(ocoms_timer_wheel_t *wheel, int level)
+{
+    int index = (int) SLOT_INDEX(wheel->now_tick, level);
+    ocoms_list_t *slot = &wheel->slots[level][index];
+    size_t count = ocoms_list_get_size(slot);
+    ocoms_timer_wheel_event_t *event;
+
+    /* parked events may land in the same slot again, so only the
+     * events present on entry are moved */
+    while (count-- > 0) {
+        event = (ocoms_timer_wheel_event_t *) ocoms_list_remove_first(slot);
+        link_event(wheel, event);
+    }
+    return index;
+}
+
+/* moves the events of the current lowest level slot to the batch */
+static void collect_slot(ocoms_timer_wheel_t *wheel)
+{
+    int index = (int) SLOT_INDEX(wheel->now_tick, 0);
+    ocoms_list_t *slot = &wheel->slots[0][index];
+    ocoms_timer_wheel_event_t *event;
+
+    if (!(wheel->slot_mask & ((uint64_t) 1 << index))) {
+        return;
+    }
+    while (NULL != (event = (ocoms_timer_wheel_event_t *) ocoms_list_remove_first(slot))) {
+        event->slot = &wheel->expired;
+        ocoms_list_append(&wheel->expired, &event->super);
+    }
+    wheel->slot_mask &= ~((uint64_t) 1 << index);
+}
+
+int ocoms_timer_wheel_expire(ocoms_timer_wheel_t *wheel, uint64_t now)
+{
+    ocoms_timer_wheel_event_t *event;
+    uint64_t target, pending;
+    int level, fired = 0;
+
+    if (now < wheel->next_cycles) {
+        return 0;
+    }
+    /* process every tick up to and including the current one */
+    target = (now - wheel->origin) / wheel->tick_cycles + 1;
+
+    while (wheel->now_tick < target) {
+        if (0 == wheel->num_events) {
+            set_now_tick(wheel, target);
+            break;
+        }
+        if (0 == SLOT_INDEX(wheel->now_tick, 0)) {
+            for (level = 1; level < OCOMS_TIMER_WHEEL_LEVELS; level++) {
+                if (0 != cascade(wheel, level)) {
+                    break;
+                }
+            }
+        }
+        collect_slot(wheel);
+        wheel->now_tick++;
+
+        /* skip to the next lowest level revolution when no slot is
+         * left in the current one */
+        if (0 != SLOT_INDEX(wheel->now_tick, 0)) {
+            pending = wheel->slot_mask >> SLOT_INDEX(wheel->now_tick, 0);
+            if (0 != pending) {
+                wheel->now_tick += ocoms_ctz64(pending);
+            } else {
+                wheel->now_tick = (wheel->now_tick | SLOT_MASK) + 1;
+            }
+            if (wheel->now_tick > target) {
+                wheel->now_tick = target;
+            }
+        }
+    }
+    set_now_tick(wheel, wheel->now_tick);
+
+    /* run the batch; callbacks may schedule or cancel events, including
+     * the ones of the batch which have not run yet */
+    while (NULL != (event = (ocoms_timer_wheel_event_t *)
+                    ocoms_list_remove_first(&wheel->expired))) {
+        event->slot = NULL;
+        wheel->num_events--;
+        fired++;
+        event->cbfunc(event, event->cbdata);
+    }
+    return fired;
+}
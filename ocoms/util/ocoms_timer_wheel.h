@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/** @file
+ *
+ *     A hierarchical timing wheel driven by the cycle counter
+ *
+ *     Time is cut into ticks of a fixed number of cycles, chosen when
+ *     the wheel is initialized.  Each of the OCOMS_TIMER_WHEEL_LEVELS
+ *     levels has OCOMS_TIMER_WHEEL_SLOTS slots, every slot covering
+ *     OCOMS_TIMER_WHEEL_SLOTS times more ticks than a slot of the level
+ *     below.  Scheduling and cancelling an event are O(1): the event is
+ *     linked into the slot matching its deadline.  Events of the upper
+ *     levels are moved down ("cascaded") as the wheel turns, and events
+ *     due further than the whole wheel wait in the top level until they
+ *     come in range.
+ *
+ *     ocoms_timer_wheel_progress reads the cycle counter, advances the
+ *     wheel, collects every event due into one batch and then runs
+ *     their callbacks.  An idle wheel returns after a single compare, so
+ *     the call is cheap enough to sit in a progress function:
+ *
+ *     static int my_progress(void)
+ *     {
+ *         return ocoms_timer_wheel_progress(&my_wheel);
+ *     }
+ *
+ *     Events fire at the first progress call after their deadline, at
+ *     most one tick late.  The wheel is not thread safe: callers
+ *     serialize the calls themselves.
+ */
+
+#ifndef OCOMS_TIMER_WHEEL_H
+#define OCOMS_TIMER_WHEEL_H
+
+#include "ocoms/platform/ocoms_config.h"
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_list.h"
+#include "ocoms/sys/timer.h"
+#if !OCOMS_HAVE_SYS_TIMER_GET_CYCLES && defined(HAVE_SYS_TIME_H)
+#include <sys/time.h>
+#endif
+
+BEGIN_C_DECLS
+
+/** number of bits of the tick count resolved by each level */
+#define OCOMS_TIMER_WHEEL_SLOT_BITS 6
+
+/** number of slots per level */
+#define OCOMS_TIMER_WHEEL_SLOTS (1 << OCOMS_TIMER_WHEEL_SLOT_BITS)
+
+/** number of levels, the wheel spans 2^30 ticks */
+#define OCOMS_TIMER_WHEEL_LEVELS 5
+
+struct ocoms_timer_wheel_event_t;
+
+/**
+  * the function called when an event expires.  The event is no longer
+  * scheduled and may be scheduled again from the callback.
+  */
+typedef void (*ocoms_timer_wheel_cb_fn_t)(struct ocoms_timer_wheel_event_t *event,
+                                          void *cbdata);
+
+/**
+ * An event of the wheel.  It may be embedded in a larger object, or
+ * allocated with OBJ_NEW.
+ */
+struct ocoms_timer_wheel_event_t {
+    ocoms_list_item_t super;            /**< link in its slot */
+    uint64_t expire_tick;               /**< the tick the event is due at */
+    ocoms_list_t *slot;                 /**< the slot holding the event, NULL if not scheduled */
+    ocoms_timer_wheel_cb_fn_t cbfunc;   /**< the function called at expiry */
+    void *cbdata;                       /**< the argument passed to cbfunc */
+};
+typedef struct ocoms_timer_wheel_event_t ocoms_timer_wheel_event_t;
+
+OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_timer_wheel_event_t);
+
+/**
+ * the data structure that holds all the needed information about the wheel.
+ */
+struct ocoms_timer_wheel_t {
+    ocoms_object_t super;               /**< the parent class */
+    uint64_t origin;                    /**< the cycle count of tick 0 */
+    uint64_t tick_cycles;               /**< the length of a tick in cycles */
+    uint64_t next_cycles;               /**< the cycle count at which now_tick starts */
+    uint64_t now_tick;                  /**< the next tick to process */
+    size_t num_events;                  /**< the number of scheduled events */
+    uint64_t slot_mask;                 /**< the non-empty slots of the lowest level */
+    ocoms_list_t expired;               /**< the events of the batch being run */
+    ocoms_list_t slots[OCOMS_TIMER_WHEEL_LEVELS][OCOMS_TIMER_WHEEL_SLOTS];
+    /**< the events, by level and slot */
+};
+typedef struct ocoms_timer_wheel_t ocoms_timer_wheel_t;
+
+/** declare the wheel as a class */
+OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_timer_wheel_t);
+
+/**
+  * returns the current time in the unit of the wheel: the cycle
+  * counter when the platform has one, microseconds otherwise
+  */
+static inline uint64_t ocoms_timer_wheel_get_cycles(void)
+{
+#if OCOMS_HAVE_SYS_TIMER_GET_CYCLES
+    return (uint64_t) ocoms_sys_timer_get_cycles();
+#elif defined(HAVE_SYS_TIME_H)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+#error "no time source for ocoms_timer_wheel"
+#endif
+}
+
+/**
+  * sets the callback of an event
+  */
+static inline void ocoms_timer_wheel_event_set(ocoms_timer_wheel_event_t *event,
+                                               ocoms_timer_wheel_cb_fn_t cbfunc,
+                                               void *cbdata)
+{
+    event->cbfunc = cbfunc;
+    event->cbdata = cbdata;
+}
+
+/**
+  * returns whether the event is scheduled
+  */
+static inline bool ocoms_timer_wheel_event_is_scheduled(ocoms_timer_wheel_event_t *event)
+{
+    return NULL != event->slot;
+}
+
+/**
+  * initializes the wheel, whose tick 0 starts now
+  *
+  * @param wheel the wheel, constructed and without events
+  * @param tick_cycles the length of a tick, in ocoms_timer_wheel_get_cycles units
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_BAD_PARAM if tick_cycles is 0
+  */
+OCOMS_DECLSPEC int ocoms_timer_wheel_init(ocoms_timer_wheel_t *wheel, uint64_t tick_cycles);
+
+/**
+  * schedules an event.  An event which is already scheduled is moved
+  * to the new deadline; a deadline in the past fires at the next tick.
+  *
+  * @param wheel the wheel
+  * @param event the event, whose callback is set
+  * @param deadline the expiry time, in ocoms_timer_wheel_get_cycles units
+  */
+OCOMS_DECLSPEC void ocoms_timer_wheel_add(ocoms_timer_wheel_t *wheel,
+                                          ocoms_timer_wheel_event_t *event,
+                                          uint64_t deadline);
+
+/**
+  * cancels a scheduled event
+  *
+  * @retval OCOMS_SUCCESS
+  * @retval OCOMS_ERR_NOT_FOUND if the event is not scheduled
+  */
+OCOMS_DECLSPEC int ocoms_timer_wheel_cancel(ocoms_timer_wheel_t *wheel,
+                                            ocoms_timer_wheel_event_t *event);
+
+/**
+  * advances the wheel to the passed time and runs the callbacks of all
+  * the events due by then
+  *
+  * @retval the number of callbacks run
+  */
+OCOMS_DECLSPEC int ocoms_timer_wheel_expire(ocoms_timer_wheel_t *wheel, uint64_t now);
+
+/**
+  * advances the wheel to the current time, see ocoms_timer_wheel_expire
+  */
+static inline int ocoms_timer_wheel_progress(ocoms_timer_wheel_t *wheel)
+{
+    uint64_t now;
+
+    if (0 == wheel->num_events) {
+        return 0;
+    }
+    now = ocoms_timer_wheel_get_cycles();
+    if (now < wheel->next_cycles) {
+        return 0;
+    }
+    return ocoms_timer_wheel_expire(wheel, now);
+}
+
+/**
+  * returns the number of scheduled events
+  */
+static inline size_t ocoms_timer_wheel_size(ocoms_timer_wheel_t *wheel)
+{
+    return wheel->num_events;
+}
+
+END_C_DECLS
+
+#endif /* OCOMS_TIMER_WHEEL_H */
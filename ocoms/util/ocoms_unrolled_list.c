@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "ocoms/platform/ocoms_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_unrolled_list.h"
+
+static void ocoms_unrolled_list_construct(ocoms_unrolled_list_t *list);
+static void ocoms_unrolled_list_destruct(ocoms_unrolled_list_t *list);
+
+OBJ_CLASS_INSTANCE(
+    ocoms_unrolled_list_t,
+    ocoms_object_t,
+    ocoms_unrolled_list_construct,
+    ocoms_unrolled_list_destruct
+);
+
+
+static void ocoms_unrolled_list_construct(ocoms_unrolled_list_t *list)
+{
+    list->head = NULL;
+    list->tail = NULL;
+    list->spare = NULL;
+    list->length = 0;
+}
+
+/*
+ * Free the blocks -- the items themselves are orphaned, exactly as
+ * for ocoms_list_t.
+ */
+static void ocoms_unrolled_list_destruct(ocoms_unrolled_list_t *list)
+{
+    ocoms_unrolled_list_block_t *block, *next;
+
+    for (block = list->head; NULL != block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    if (NULL != list->spare) {
+        free(list->spare);
+    }
+    ocoms_unrolled_list_construct(list);
+}
+
+
+static ocoms_unrolled_list_block_t *block_alloc(ocoms_unrolled_list_t *list)
+{
+    ocoms_unrolled_list_block_t *block = list->spare;
+
+    if (NULL != block) {
+        list->spare = NULL;
+    } else {
+#if HAVE_POSIX_MEMALIGN
+        void *ptr;
+        if (0 != posix_memalign(&ptr, OCOMS_UNROLLED_LIST_BLOCK_BYTES,
+                                sizeof(ocoms_unrolled_list_block_t))) {
+            return NULL;
+        }
+        block = (ocoms_unrolled_list_block_t *) ptr;
+#else
+        block = (ocoms_unrolled_list_block_t *) malloc(sizeof(ocoms_unrolled_list_block_t));
+        if (NULL == block) {
+            return NULL;
+        }
+#endif  /* HAVE_POSIX_MEMALIGN */
+    }
+    block->next = NULL;
+    block->first = 0;
+    block->last = 0;
+    return block;
+}
+
+static void block_free(ocoms_unrolled_list_t *list, ocoms_unrolled_list_block_t *block)
+{
+    if (NULL == list->spare) {
+        list->spare = block;
+    } else {
+        free(block);
+    }
+}
+
+
+/*
+ * The tail block is full (or there is no tail at all): link a fresh
+ * block at the end of the chain.
+ */
+int ocoms_unrolled_list_append_block(ocoms_unrolled_list_t *list)
+{
+    ocoms_unrolled_list_block_t *block = block_alloc(list);
+
+    if (NULL == block) {
+        return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    if (NULL == list->tail) {
+        list->head = block;
+    } else {
+        list->tail->next = block;
+    }
+    list->tail = block;
+    return OCOMS_SUCCESS;
+}
+
+
+/*
+ * The head block has been drained by remove_first: unlink it.  When
+ * it is also the tail, simply rewind it so that the next append does
+ * not have to go through the allocator.
+ */
+void ocoms_unrolled_list_retire_head(ocoms_unrolled_list_t *list)
+{
+    ocoms_unrolled_list_block_t *head = list->head;
+
+    if (head == list->tail) {
+        head->first = head->last = 0;
+        return;
+    }
+    list->head = head->next;
+    block_free(list, head);
+}
+
+
+bool ocoms_unrolled_list_remove_item(ocoms_unrolled_list_t *list, void *item)
+{
+    ocoms_unrolled_list_block_t *block, *prev = NULL;
+    int i;
+
+    for (block = list->head; NULL != block; prev = block, block = block->next) {
+        for (i = block->first; i < block->last; i++) {
+            if (block->items[i] != item) {
+                continue;
+            }
+            /* close the hole by shifting the shorter side of the block */
+            if (i - block->first < block->last - i - 1) {
+                memmove(&block->items[block->first + 1], &block->items[block->first],
+                        (i - block->first) * sizeof(void*));
+                block->first++;
+            } else {
+                memmove(&block->items[i], &block->items[i + 1],
+                        (block->last - i - 1) * sizeof(void*));
+                block->last--;
+            }
+            list->length--;
+
+            if (block->first == block->last) {
+                if (block == list->head) {
+                    ocoms_unrolled_list_retire_head(list);
+                } else {
+                    prev->next = block->next;
+                    if (block == list->tail) {
+                        list->tail = prev;
+                    }
+                    block_free(list, block);
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2013      Mellanox Technologies Ltd. All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+/**
+ * @file
+ *
+ * The ocoms_unrolled_list_t interface provides a FIFO-ordered container
+ * of item pointers that is laid out as a singly linked chain of
+ * cache-line aligned blocks.  Every block stores up to
+ * OCOMS_UNROLLED_LIST_BLOCK_ITEMS pointers contiguously, so walking the
+ * list touches one cache line per several items instead of one per item
+ * as ocoms_list_t does.
+ *
+ * Unlike ocoms_list_t the items are not intrusive: any non-NULL pointer
+ * can be stored, and the same pointer may live on several unrolled lists
+ * at once.  As with ocoms_list_t, destroying the container orphans the
+ * items -- they are \em not released.
+ *
+ * The interface mirrors the most common ocoms_list_t operations
+ * (append, remove_first, get_first, get_size and a FOREACH loop) so
+ * that queue-like users can switch between the two containers with
+ * minimal changes.
+ */
+
+#ifndef OCOMS_UNROLLED_LIST_H
+#define OCOMS_UNROLLED_LIST_H
+
+#include "ocoms/platform/ocoms_config.h"
+#include <stdlib.h>
+#include "ocoms/platform/ocoms_constants.h"
+#include "ocoms/util/ocoms_object.h"
+#include "ocoms/primitives/prefetch.h"
+
+BEGIN_C_DECLS
+
+/**
+ * Size in bytes of a single block, header included.  Blocks are
+ * allocated on this boundary, so it should be a multiple of the cache
+ * line size.
+ */
+#define OCOMS_UNROLLED_LIST_BLOCK_BYTES 128
+
+/**
+ * Number of item pointers stored in each block.  The block header is
+ * exactly two pointers wide on both 32 and 64 bit platforms.
+ */
+#define OCOMS_UNROLLED_LIST_BLOCK_ITEMS \
+    ((OCOMS_UNROLLED_LIST_BLOCK_BYTES / sizeof(void*)) - 2)
+
+/**
+ * \internal
+ *
+ * A block of the unrolled list.  Live items are stored in
+ * items[first .. last-1].
+ */
+struct ocoms_unrolled_list_block_t {
+    struct ocoms_unrolled_list_block_t *next;
+    /**< Next block in the list, NULL for the tail */
+    uint16_t first;
+    /**< Index of the first live item */
+    uint16_t last;
+    /**< Index one past the last live item */
+    void *items[OCOMS_UNROLLED_LIST_BLOCK_ITEMS];
+    /**< Item storage */
+};
+typedef struct ocoms_unrolled_list_block_t ocoms_unrolled_list_block_t;
+
+/**
+ * \internal
+ *
+ * Struct of an ocoms_unrolled_list_t
+ */
+struct ocoms_unrolled_list_t {
+    ocoms_object_t super;
+    /**< Generic parent class for all objects */
+    ocoms_unrolled_list_block_t *head;
+    /**< First block, NULL if the list is empty */
+    ocoms_unrolled_list_block_t *tail;
+    /**< Last block, NULL if the list is empty */
+    ocoms_unrolled_list_block_t *spare;
+    /**< One cached empty block, to avoid malloc/free ping-pong when
+         the list oscillates around a block boundary */
+    size_t length;
+    /**< Number of items on the list */
+};
+typedef struct ocoms_unrolled_list_t ocoms_unrolled_list_t;
+
+OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_unrolled_list_t);
+
+/**
+ * Iterator over an ocoms_unrolled_list_t.  Only used through
+ * OCOMS_UNROLLED_LIST_FOREACH or the ocoms_unrolled_list_iter_*
+ * functions.
+ */
+struct ocoms_unrolled_list_iter_t {
+    ocoms_unrolled_list_block_t *block;
+    int index;
+};
+typedef struct ocoms_unrolled_list_iter_t ocoms_unrolled_list_iter_t;
+
+/**
+ * \internal
+ *
+ * Slow paths of append and remove_first: allocate a fresh tail block,
+ * and retire a drained head block.
+ */
+OCOMS_DECLSPEC int ocoms_unrolled_list_append_block(ocoms_unrolled_list_t *list);
+OCOMS_DECLSPEC void ocoms_unrolled_list_retire_head(ocoms_unrolled_list_t *list);
+
+/**
+ * Return the number of items in a list
+ *
+ * @param list The list container
+ *
+ * @returns The size of the list (size_t)
+ *
+ * This is an O(1) operation.
+ */
+static inline size_t ocoms_unrolled_list_get_size(ocoms_unrolled_list_t *list)
+{
+    return list->length;
+}
+
+/**
+ * Check for empty list
+ *
+ * @param list The list container
+ *
+ * @returns true if list's size is 0, false otherwise
+ */
+static inline bool ocoms_unrolled_list_is_empty(ocoms_unrolled_list_t *list)
+{
+    return (0 == list->length);
+}
+
+/**
+ * Return the first item on the list (does not remove it).
+ *
+ * @param list The list container
+ *
+ * @returns The first item, or NULL if the list is empty
+ */
+static inline void *ocoms_unrolled_list_get_first(ocoms_unrolled_list_t *list)
+{
+    if (0 == list->length) {
+        return NULL;
+    }
+    return list->head->items[list->head->first];
+}
+
+/**
+ * Append an item to the end of the list.
+ *
+ * @param list The list container
+ * @param item The item to append, must not be NULL
+ *
+ * @retval OCOMS_SUCCESS
+ * @retval OCOMS_ERR_OUT_OF_RESOURCE if a new block could not be allocated
+ *
+ * This is an O(1) operation.  Only one in OCOMS_UNROLLED_LIST_BLOCK_ITEMS
+ * appends leaves the inline fast path.
+ */
+static inline int ocoms_unrolled_list_append(ocoms_unrolled_list_t *list, void *item)
+{
+    ocoms_unrolled_list_block_t *tail = list->tail;
+
+    if (OCOMS_UNLIKELY(NULL == tail || OCOMS_UNROLLED_LIST_BLOCK_ITEMS == tail->last)) {
+        int rc = ocoms_unrolled_list_append_block(list);
+        if (OCOMS_SUCCESS != rc) {
+            return rc;
+        }
+        tail = list->tail;
+    }
+    tail->items[tail->last++] = item;
+    list->length++;
+    return OCOMS_SUCCESS;
+}
+
+/**
+ * Remove the first item from the list and return it.
+ *
+ * @param list The list container
+ *
+ * @returns The first item on the list, or NULL if the list is empty
+ *
+ * This is an O(1) operation.
+ */
+static inline void *ocoms_unrolled_list_remove_first(ocoms_unrolled_list_t *list)
+{
+    ocoms_unrolled_list_block_t *head = list->head;
+    void *item;
+
+    if (0 == list->length) {
+        return NULL;
+    }
+    item = head->items[head->first++];
+    list->length--;
+    if (head->first == head->last) {
+        ocoms_unrolled_list_retire_head(list);
+    }
+    return item;
+}
+
+/**
+ * Remove a specific item from the list.
+ *
+ * @param list The list container
+ * @param item The item to remove
+ *
+ * @returns true if the item was found and removed, false otherwise
+ *
+ * This is an O(N) operation: the list is searched for the first
+ * occurrence of \c item, which is then removed by shifting the
+ * remaining items of its block only.
+ */
+OCOMS_DECLSPEC bool ocoms_unrolled_list_remove_item(ocoms_unrolled_list_t *list, void *item);
+
+/**
+ * Initialize an iterator on the first item of a list.
+ */
+static inline void ocoms_unrolled_list_iter_init(ocoms_unrolled_list_iter_t *iter,
+                                                 ocoms_unrolled_list_t *list)
+{
+    iter->block = list->head;
+    iter->index = (NULL == list->head) ? 0 : list->head->first;
+}
+
+/**
+ * Return the item under the iterator and advance it.
+ *
+ * @returns The next item, or NULL once the end of the list is reached
+ */
+static inline void *ocoms_unrolled_list_iter_next(ocoms_unrolled_list_iter_t *iter)
+{
+    ocoms_unrolled_list_block_t *block = iter->block;
+
+    while (NULL != block && iter->index >= block->last) {
+        block = iter->block = block->next;
+        iter->index = (NULL == block) ? 0 : block->first;
+    }
+    return (NULL == block) ? NULL : block->items[iter->index++];
+}
+
+/**
+ * Loop over an unrolled list.
+ *
+ * @param[in] item Storage for each item
+ * @param[in] iter An ocoms_unrolled_list_iter_t used as loop state
+ * @param[in] list List to iterate over
+ * @param[in] type Type of each list item
+ *
+ * It is not safe to modify the list from within the loop.
+ *
+ * Example Usage:
+ *
+ * class_foo_t *foo;
+ * ocoms_unrolled_list_iter_t iter;
+ * OCOMS_UNROLLED_LIST_FOREACH(foo, iter, list, class_foo_t) {
+ *    do something;
+ * }
+ */
+#define OCOMS_UNROLLED_LIST_FOREACH(item, iter, list, type)              \
+    for (ocoms_unrolled_list_iter_init(&(iter), (list));                  \
+         NULL != ((item) = (type *) ocoms_unrolled_list_iter_next(&(iter))); )
+
+END_C_DECLS
+
+#endif /* OCOMS_UNROLLED_LIST_H */
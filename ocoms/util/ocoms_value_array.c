@@ -25,7 +25,7 @@
 
 static void ocoms_value_array_construct(ocoms_value_array_t* array)
 {
-    array->array_items = NULL;
+    array->array_items = array->array_inline.bytes;
     array->array_size = 0;
     array->array_item_sizeof = 0;
     array->array_alloc_size = 0;
@@ -33,7 +33,7 @@ static void ocoms_value_array_construct(ocoms_value_array_t* array)
 
 static void ocoms_value_array_destruct(ocoms_value_array_t* array)
 {
-    if (NULL != array->array_items)
+    if (array->array_inline.bytes != array->array_items)
         free(array->array_items);
 }
 
@@ -55,14 +55,37 @@ int ocoms_value_array_set_size(ocoms_value_array_t* array, size_t size)
 #endif
 
     if(size > array->array_alloc_size) {
-        while(array->array_alloc_size < size)
-            array->array_alloc_size <<= 1;
-        array->array_items = (unsigned char *)realloc(array->array_items,
-            array->array_alloc_size * array->array_item_sizeof);
-        if (NULL == array->array_items)
-            return OCOMS_ERR_OUT_OF_RESOURCE;
+        int rc = ocoms_value_array_grow(array, size, false);
+        if (OCOMS_SUCCESS != rc)
+            return rc;
     }
     array->array_size = size;
     return OCOMS_SUCCESS;
 }
 
+
+int ocoms_value_array_grow(ocoms_value_array_t* array, size_t size, bool exact)
+{
+    size_t alloc_size = size;
+    unsigned char *items;
+
+    if (!exact && alloc_size < 2 * array->array_alloc_size)
+        alloc_size = 2 * array->array_alloc_size;
+
+    if (array->array_inline.bytes == array->array_items) {
+        /* leave the embedded storage: it can not be realloc'ed */
+        items = (unsigned char *)malloc(alloc_size * array->array_item_sizeof);
+        if (NULL == items)
+            return OCOMS_ERR_OUT_OF_RESOURCE;
+        memcpy(items, array->array_items, array->array_size * array->array_item_sizeof);
+    } else {
+        items = (unsigned char *)realloc(array->array_items,
+                                         alloc_size * array->array_item_sizeof);
+        if (NULL == items)
+            return OCOMS_ERR_OUT_OF_RESOURCE;
+    }
+    array->array_items = items;
+    array->array_alloc_size = alloc_size;
+    return OCOMS_SUCCESS;
+}
+
@@ -35,8 +35,18 @@ BEGIN_C_DECLS
 
 /*
  *  @file  Array of elements maintained by value.
+ *
+ *  The first OCOMS_VALUE_ARRAY_INLINE_BYTES bytes of items are stored
+ *  inside the object itself, so that short arrays never touch the
+ *  heap.  Past that the storage is moved to the heap and grows
+ *  geometrically.  Pointers into the array (including
+ *  OCOMS_VALUE_ARRAY_GET_BASE) are therefore invalidated whenever the
+ *  array grows.
  */
 
+/** Size in bytes of the storage embedded in each value array */
+#define OCOMS_VALUE_ARRAY_INLINE_BYTES 64
+
 struct ocoms_value_array_t
 {
     ocoms_object_t    super;
@@ -44,6 +54,12 @@ struct ocoms_value_array_t
     size_t          array_item_sizeof;
     size_t          array_size;
     size_t          array_alloc_size;
+    union {
+        unsigned char bytes[OCOMS_VALUE_ARRAY_INLINE_BYTES];
+        double        align_double;
+        int64_t       align_int64;
+        void         *align_ptr;
+    } array_inline;  /**< embedded storage for short arrays */
 };
 typedef struct ocoms_value_array_t ocoms_value_array_t;
 
@@ -65,13 +81,34 @@ OCOMS_DECLSPEC OBJ_CLASS_DECLARATION(ocoms_value_array_t);
 static inline int ocoms_value_array_init(ocoms_value_array_t *array, size_t item_sizeof)
 {
     array->array_item_sizeof = item_sizeof;
-    array->array_alloc_size = 1; 
     array->array_size = 0;
+    if (0 < item_sizeof && OCOMS_VALUE_ARRAY_INLINE_BYTES >= item_sizeof) {
+        if (array->array_inline.bytes != array->array_items) {
+            free(array->array_items);
+        }
+        array->array_items = array->array_inline.bytes;
+        array->array_alloc_size = OCOMS_VALUE_ARRAY_INLINE_BYTES / item_sizeof;
+        return OCOMS_SUCCESS;
+    }
+    if (array->array_inline.bytes == array->array_items) {
+        array->array_items = NULL;
+    }
+    array->array_alloc_size = 1; 
     array->array_items = (unsigned char*)realloc(array->array_items, item_sizeof * array->array_alloc_size);
     return (NULL != array->array_items) ? OCOMS_SUCCESS : OCOMS_ERR_OUT_OF_RESOURCE;
 }
 
 
+/**
+ *  \internal
+ *
+ *  Grow the storage to hold at least size items.  Unless exact is
+ *  set, the new allocation is at least twice the old one.
+ */
+
+OCOMS_DECLSPEC int ocoms_value_array_grow(ocoms_value_array_t* array, size_t size, bool exact);
+
+
 /**
  *  Reserve space in the array for new elements, but do not change the size.
  *
@@ -83,13 +120,7 @@ static inline int ocoms_value_array_init(ocoms_value_array_t *array, size_t item
 static inline int ocoms_value_array_reserve(ocoms_value_array_t* array, size_t size)
 {
      if(size > array->array_alloc_size) {
-         array->array_items = (unsigned char*)realloc(array->array_items, array->array_item_sizeof * size);
-         if(NULL == array->array_items) {
-             array->array_size = 0;
-             array->array_alloc_size = 0;
-             return OCOMS_ERR_OUT_OF_RESOURCE;
-         }
-         array->array_alloc_size = size;
+         return ocoms_value_array_grow(array, size, true);
      }
      return OCOMS_SUCCESS;
 }
@@ -227,6 +258,31 @@ static inline int ocoms_value_array_append_item(ocoms_value_array_t *array, cons
 }
 
 
+/**
+ *  Appends several items to the end of the array. 
+ *
+ *  @param   array    The input array (IN).
+ *  @param   items    A pointer to the first of the contiguous items to
+ *                    append, which are copied into the array.
+ *  @param   count    The number of items to append (IN).
+ *
+ *  @return  OPAL error code 
+ *
+ * The array grows at most once.
+ */
+
+static inline int ocoms_value_array_append_items(ocoms_value_array_t *array, const void *items, size_t count)
+{
+    size_t size = array->array_size;
+    int rc;
+
+    if((rc = ocoms_value_array_set_size(array, size + count)) != OCOMS_SUCCESS)
+        return rc;
+    memcpy(array->array_items + (size * array->array_item_sizeof), items, count * array->array_item_sizeof);
+    return OCOMS_SUCCESS;
+}
+
+
 /**
  *  Remove a specific item from the array. 
  *
@@ -254,6 +310,37 @@ static inline int ocoms_value_array_remove_item(ocoms_value_array_t *array, size
     return OCOMS_SUCCESS;
 }
 
+/**
+ *  Remove a specific item from the array, without preserving the
+ *  order of the remaining items.
+ *
+ *  @param   array       The input array (IN).
+ *  @param   item_index  The index to remove, which must be less than
+ *                       the current array size (IN).
+ *
+ *  @return  OPAL error code.
+ *
+ * The last element is moved into the hole, so this is O(1) regardless
+ * of the position of the removed item.
+ */
+
+static inline int ocoms_value_array_remove_item_unordered(ocoms_value_array_t *array, size_t item_index)
+{
+#if OCOMS_ENABLE_DEBUG
+    if (item_index >= array->array_size) {
+        ocoms_output(0, "ocoms_value_array_remove_item_unordered: invalid index %lu\n", (unsigned long)item_index);
+        return OCOMS_ERR_BAD_PARAM;
+    }
+#endif   
+    array->array_size--;
+    if (item_index != array->array_size) {
+        memcpy(array->array_items+(array->array_item_sizeof * item_index),
+               array->array_items+(array->array_item_sizeof * array->array_size),
+               array->array_item_sizeof);
+    }
+    return OCOMS_SUCCESS;
+}
+
 /**
  * Get the base pointer of the underlying array.
  * 